@@ -0,0 +1,656 @@
+/*
+ * message-bus-benchmark.c
+ * This file is part of gedit
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/* Sends and looks up messages on a GeditMessageBus many times over, and
+ * connects and disconnects many listeners, queues many messages, posts
+ * many messages from several threads at once, dispatches to the listeners
+ * of a subtree, and reports how long that takes per call. The lookup the bus used to do,
+ * building the identifier of the message as a string each time, is
+ * timed next to it for comparison, and so are building each message
+ * with g_object_new() and checking a message type through its class.
+ */
+
+#include <gedit/gedit-message-bus.h>
+
+#define OBJECT_PATH "/plugins/benchmark"
+#define SUBTREE_PATH "/plugins"
+#define METHOD "ping"
+#define POSTED_METHOD "post"
+
+/* Number of calls of each kind */
+#define N_CALLS 1000000
+
+/* Listeners connected to a single message at once */
+#define N_LISTENERS 20000
+
+/* Messages sent asynchronously at once */
+#define N_QUEUED 100000
+
+/* Threads posting messages at once, and messages posted by each */
+#define N_POSTING_THREADS 4
+#define N_POSTED 100000
+
+typedef GeditMessage      BenchmarkMessage;
+typedef GeditMessageClass BenchmarkMessageClass;
+
+GType benchmark_message_get_type (void);
+
+G_DEFINE_TYPE (BenchmarkMessage, benchmark_message, GEDIT_TYPE_MESSAGE)
+
+static void
+benchmark_message_class_init (BenchmarkMessageClass *klass)
+{
+}
+
+static void
+benchmark_message_init (BenchmarkMessage *message)
+{
+}
+
+/* Posted from a worker thread, to check the order of delivery */
+typedef struct
+{
+	GeditMessage parent;
+
+	guint thread;
+	guint sequence;
+} PostedMessage;
+
+typedef GeditMessageClass PostedMessageClass;
+
+GType posted_message_get_type (void);
+
+G_DEFINE_TYPE (PostedMessage, posted_message, GEDIT_TYPE_MESSAGE)
+
+static void
+posted_message_class_init (PostedMessageClass *klass)
+{
+}
+
+static void
+posted_message_init (PostedMessage *message)
+{
+}
+
+/* Like the messages sent for each row of the file browser */
+typedef struct
+{
+	GeditMessage parent;
+
+	gchar *id;
+	gboolean is_directory;
+	gboolean filter;
+} RowMessage;
+
+typedef GeditMessageClass RowMessageClass;
+
+GType row_message_get_type (void);
+
+G_DEFINE_TYPE (RowMessage, row_message, GEDIT_TYPE_MESSAGE)
+
+enum
+{
+	PROP_0,
+	PROP_ID,
+	PROP_IS_DIRECTORY,
+	PROP_FILTER
+};
+
+static void
+row_message_finalize (GObject *object)
+{
+	RowMessage *message = (RowMessage *)object;
+
+	g_free (message->id);
+
+	G_OBJECT_CLASS (row_message_parent_class)->finalize (object);
+}
+
+static void
+row_message_get_property (GObject    *object,
+			  guint       prop_id,
+			  GValue     *value,
+			  GParamSpec *pspec)
+{
+	RowMessage *message = (RowMessage *)object;
+
+	switch (prop_id)
+	{
+		case PROP_ID:
+			g_value_set_string (value, message->id);
+			break;
+		case PROP_IS_DIRECTORY:
+			g_value_set_boolean (value, message->is_directory);
+			break;
+		case PROP_FILTER:
+			g_value_set_boolean (value, message->filter);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+row_message_set_property (GObject      *object,
+			  guint         prop_id,
+			  const GValue *value,
+			  GParamSpec   *pspec)
+{
+	RowMessage *message = (RowMessage *)object;
+
+	switch (prop_id)
+	{
+		case PROP_ID:
+			g_free (message->id);
+			message->id = g_value_dup_string (value);
+			break;
+		case PROP_IS_DIRECTORY:
+			message->is_directory = g_value_get_boolean (value);
+			break;
+		case PROP_FILTER:
+			message->filter = g_value_get_boolean (value);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+row_message_class_init (RowMessageClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = row_message_finalize;
+	object_class->get_property = row_message_get_property;
+	object_class->set_property = row_message_set_property;
+
+	g_object_class_install_property (object_class, PROP_ID,
+					 g_param_spec_string ("id", "Id", "Id",
+							      NULL,
+							      G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property (object_class, PROP_IS_DIRECTORY,
+					 g_param_spec_boolean ("is-directory", "Is directory", "Is directory",
+							       FALSE,
+							       G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property (object_class, PROP_FILTER,
+					 g_param_spec_boolean ("filter", "Filter", "Filter",
+							       FALSE,
+							       G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+row_message_init (RowMessage *message)
+{
+}
+
+static void
+report_calls (const gchar *label,
+	      gint64       start,
+	      guint        n_calls)
+{
+	gint64 elapsed = g_get_monotonic_time () - start;
+
+	g_print ("  %-36s %10.2f ms %8.1f ns/call\n",
+		 label,
+		 elapsed / 1000.0,
+		 elapsed * 1000.0 / n_calls);
+}
+
+static void
+report (const gchar *label,
+	gint64       start)
+{
+	report_calls (label, start, N_CALLS);
+}
+
+static void
+on_message (GeditMessageBus *bus,
+	    GeditMessage    *message,
+	    guint           *count)
+{
+	++*count;
+}
+
+/* What looking up a message cost before the identifiers were interned */
+static void
+time_string_identifiers (void)
+{
+	GHashTable *types;
+	gint64 start;
+	guint found = 0;
+
+	types = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	g_hash_table_insert (types,
+			     gedit_message_type_identifier (OBJECT_PATH, METHOD),
+			     GSIZE_TO_POINTER (benchmark_message_get_type ()));
+
+	start = g_get_monotonic_time ();
+
+	for (guint i = 0; i < N_CALLS; ++i)
+	{
+		gchar *object_path = g_strdup (OBJECT_PATH);
+		gchar *method = g_strdup (METHOD);
+		gchar *identifier = gedit_message_type_identifier (object_path, method);
+
+		if (g_hash_table_lookup (types, identifier) != NULL)
+			++found;
+
+		g_free (identifier);
+		g_free (method);
+		g_free (object_path);
+	}
+
+	report ("string identifier lookup (previous)", start);
+
+	if (found != N_CALLS)
+		g_error ("Looked up %u of %u messages", found, N_CALLS);
+
+	g_hash_table_unref (types);
+}
+
+/* Many listeners on one message, disconnected every other one first so
+   that the ones left are spread out when dispatching */
+static void
+time_listeners (GeditMessageBus *bus,
+		GeditMessage    *message)
+{
+	guint *ids = g_new (guint, N_LISTENERS);
+	gint64 start;
+	guint count = 0;
+
+	start = g_get_monotonic_time ();
+
+	for (guint i = 0; i < N_LISTENERS; ++i)
+	{
+		ids[i] = gedit_message_bus_connect (bus, OBJECT_PATH, METHOD,
+						    (GeditMessageCallback)on_message, &count, NULL);
+	}
+
+	report_calls ("connect", start, N_LISTENERS);
+
+	start = g_get_monotonic_time ();
+
+	for (guint i = 0; i < N_LISTENERS; i += 2)
+		gedit_message_bus_disconnect (bus, ids[i]);
+
+	report_calls ("disconnect every other listener", start, N_LISTENERS / 2);
+
+	start = g_get_monotonic_time ();
+
+	for (guint i = 0; i < N_CALLS / N_LISTENERS; ++i)
+		gedit_message_bus_send_message_sync (bus, message);
+
+	report_calls ("dispatch, per listener called", start,
+		      (N_CALLS / N_LISTENERS) * (N_LISTENERS / 2));
+
+	start = g_get_monotonic_time ();
+
+	for (guint i = 1; i < N_LISTENERS; i += 2)
+		gedit_message_bus_disconnect (bus, ids[i]);
+
+	report_calls ("disconnect the others", start, N_LISTENERS / 2);
+
+	if (count != (N_CALLS / N_LISTENERS) * (N_LISTENERS / 2))
+		g_error ("Dispatched to %u listeners", count);
+
+	g_free (ids);
+}
+
+typedef struct
+{
+	GMainLoop *loop;
+	guint      count;
+	guint      expected;
+	guint      n_iterations;
+	guint      probe_id;
+} QueueRun;
+
+/* Stands for input handling, which has to run each time the bus yields
+   to the main loop */
+static gboolean
+on_main_loop_iteration (QueueRun *run)
+{
+	run->n_iterations++;
+	run->probe_id = 0;
+	return G_SOURCE_REMOVE;
+}
+
+static void
+on_queued_message (GeditMessageBus *bus,
+		   GeditMessage    *message,
+		   QueueRun        *run)
+{
+	if (++run->count == run->expected)
+		g_main_loop_quit (run->loop);
+
+	/* a default priority source that stayed ready would keep the bus
+	   from dispatching, so it is armed again only once it ran */
+	if (run->probe_id == 0)
+		run->probe_id = g_idle_add_full (G_PRIORITY_DEFAULT,
+						 (GSourceFunc)on_main_loop_iteration,
+						 run, NULL);
+}
+
+/* Sends n_messages asynchronously and waits for expected of them to be
+   dispatched */
+static void
+time_queue (GeditMessageBus *bus,
+	    const gchar     *label,
+	    guint            n_messages,
+	    gboolean         mergeable,
+	    guint            expected)
+{
+	QueueRun run = { g_main_loop_new (NULL, FALSE), 0, expected, 0, 0 };
+	gint64 start;
+	guint id;
+
+	id = gedit_message_bus_connect (bus, OBJECT_PATH, METHOD,
+					(GeditMessageCallback)on_queued_message, &run, NULL);
+
+	start = g_get_monotonic_time ();
+
+	for (guint i = 0; i < n_messages; ++i)
+	{
+		GeditMessage *message;
+
+		message = g_object_new (benchmark_message_get_type (),
+					"object-path", OBJECT_PATH,
+					"method", METHOD,
+					"mergeable", mergeable,
+					NULL);
+
+		gedit_message_bus_send_message (bus, message);
+		g_object_unref (message);
+	}
+
+	g_main_loop_run (run.loop);
+
+	report_calls (label, start, n_messages);
+	g_print ("  %-36s %10u\n", "  dispatched", run.count);
+	g_print ("  %-36s %10u\n", "  main loop iterations", run.n_iterations);
+
+	if (run.probe_id != 0)
+		g_source_remove (run.probe_id);
+
+	gedit_message_bus_disconnect (bus, id);
+	g_main_loop_unref (run.loop);
+}
+
+/* Checks the type of a message property the way it used to be checked,
+   and the way gedit_message_type_check() does it now */
+static void
+time_type_check (void)
+{
+	GObjectClass *klass;
+	gint64 start;
+	guint found = 0;
+
+	start = g_get_monotonic_time ();
+
+	for (guint i = 0; i < N_CALLS; ++i)
+	{
+		GParamSpec *spec;
+
+		klass = g_type_class_ref (row_message_get_type ());
+		spec = g_object_class_find_property (klass, "is-directory");
+
+		if (spec != NULL && spec->value_type == G_TYPE_BOOLEAN)
+			++found;
+
+		g_type_class_unref (klass);
+	}
+
+	report ("type check, class (previous)", start);
+
+	start = g_get_monotonic_time ();
+
+	for (guint i = 0; i < N_CALLS; ++i)
+	{
+		if (gedit_message_type_check (row_message_get_type (), "is-directory", G_TYPE_BOOLEAN))
+			++found;
+	}
+
+	report ("type_check", start);
+
+	if (found != 2 * N_CALLS)
+		g_error ("Type checked %u of %u times", found, 2 * N_CALLS);
+}
+
+/* Dispatches the message to a listener of the subtree it is in and one
+   of the root, next to the one connected to it */
+static void
+time_subtree (GeditMessageBus *bus,
+	      GeditMessage    *message)
+{
+	gint64 start;
+	guint count = 0;
+	guint root_count = 0;
+	guint id;
+
+	id = gedit_message_bus_connect_subtree (bus, SUBTREE_PATH,
+						(GeditMessageCallback)on_message, &count, NULL);
+	gedit_message_bus_connect_subtree (bus, "/",
+					   (GeditMessageCallback)on_message, &root_count, NULL);
+
+	start = g_get_monotonic_time ();
+
+	for (guint i = 0; i < N_CALLS; ++i)
+		gedit_message_bus_send_message_sync (bus, message);
+
+	report ("send_message_sync, with a subtree", start);
+
+	if (count != N_CALLS || root_count != N_CALLS)
+		g_error ("Dispatched %u and %u of %u messages to the subtrees",
+			 count, root_count, N_CALLS);
+
+	gedit_message_bus_disconnect (bus, id);
+	gedit_message_bus_disconnect_by_func (bus, "/", NULL,
+					      (GeditMessageCallback)on_message, &root_count);
+}
+
+static void
+print_route (const gchar *object_path,
+	     const gchar *method,
+	     guint64      n_dispatched,
+	     gpointer     user_data)
+{
+	gchar *route;
+
+	/* the listeners of a subtree have no method */
+	if (method == NULL)
+		route = g_strconcat (object_path, " (subtree)", NULL);
+	else
+		route = g_strconcat (object_path, ".", method, NULL);
+
+	g_print ("  %-36s %10" G_GUINT64_FORMAT "\n", route, n_dispatched);
+	g_free (route);
+}
+
+typedef struct
+{
+	GeditMessageBus *bus;
+	guint            thread;
+} PostingThread;
+
+typedef struct
+{
+	GMainLoop *loop;
+	guint      count;
+	guint      next_sequence[N_POSTING_THREADS];
+} PostRun;
+
+static gpointer
+post_messages (PostingThread *posting)
+{
+	for (guint i = 0; i < N_POSTED; ++i)
+	{
+		PostedMessage *message;
+
+		message = g_object_new (posted_message_get_type (),
+					"object-path", OBJECT_PATH,
+					"method", POSTED_METHOD,
+					NULL);
+
+		message->thread = posting->thread;
+		message->sequence = i;
+
+		gedit_message_bus_post_message (posting->bus, GEDIT_MESSAGE (message));
+		g_object_unref (message);
+	}
+
+	return NULL;
+}
+
+static void
+on_posted_message (GeditMessageBus *bus,
+		   PostedMessage   *message,
+		   PostRun         *run)
+{
+	if (message->sequence != run->next_sequence[message->thread])
+	{
+		g_error ("Message %u of thread %u delivered, expected %u",
+			 message->sequence,
+			 message->thread,
+			 run->next_sequence[message->thread]);
+	}
+
+	run->next_sequence[message->thread]++;
+
+	if (++run->count == N_POSTING_THREADS * N_POSTED)
+		g_main_loop_quit (run->loop);
+}
+
+/* Posts N_POSTED messages from each of N_POSTING_THREADS threads at once,
+   and checks that the messages of each thread arrive in order */
+static void
+time_post (GeditMessageBus *bus)
+{
+	PostRun run = { g_main_loop_new (NULL, FALSE), 0, { 0 } };
+	PostingThread posting[N_POSTING_THREADS];
+	GThread *threads[N_POSTING_THREADS];
+	gint64 start;
+	guint id;
+
+	gedit_message_bus_register (bus, posted_message_get_type (), OBJECT_PATH, POSTED_METHOD);
+	id = gedit_message_bus_connect (bus, OBJECT_PATH, POSTED_METHOD,
+					(GeditMessageCallback)on_posted_message, &run, NULL);
+
+	start = g_get_monotonic_time ();
+
+	for (guint i = 0; i < N_POSTING_THREADS; ++i)
+	{
+		posting[i].bus = bus;
+		posting[i].thread = i;
+
+		threads[i] = g_thread_new ("post", (GThreadFunc)post_messages, &posting[i]);
+	}
+
+	g_main_loop_run (run.loop);
+
+	for (guint i = 0; i < N_POSTING_THREADS; ++i)
+		g_thread_join (threads[i]);
+
+	report_calls ("post_message, 4 threads", start, N_POSTING_THREADS * N_POSTED);
+	g_print ("  %-36s %10.0f\n", "  messages per second",
+		 N_POSTING_THREADS * N_POSTED * 1000000.0 / (g_get_monotonic_time () - start));
+
+	gedit_message_bus_disconnect (bus, id);
+	gedit_message_bus_unregister (bus, OBJECT_PATH, POSTED_METHOD);
+	g_main_loop_unref (run.loop);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+	GeditMessageBus *bus = gedit_message_bus_new ();
+	GeditMessage *message;
+	gint64 start;
+	guint count = 0;
+	guint found = 0;
+
+	gedit_message_bus_register (bus, benchmark_message_get_type (), OBJECT_PATH, METHOD);
+	gedit_message_bus_connect (bus, OBJECT_PATH, METHOD,
+				   (GeditMessageCallback)on_message, &count, NULL);
+
+	message = g_object_new (benchmark_message_get_type (),
+				"object-path", OBJECT_PATH,
+				"method", METHOD,
+				NULL);
+
+	g_print ("message bus (%d calls each)\n", N_CALLS);
+
+	time_string_identifiers ();
+
+	start = g_get_monotonic_time ();
+
+	for (guint i = 0; i < N_CALLS; ++i)
+	{
+		if (gedit_message_bus_is_registered (bus, OBJECT_PATH, METHOD))
+			++found;
+	}
+
+	report ("is_registered", start);
+
+	start = g_get_monotonic_time ();
+
+	for (guint i = 0; i < N_CALLS; ++i)
+	{
+		if (gedit_message_bus_lookup (bus, OBJECT_PATH, METHOD) != G_TYPE_INVALID)
+			++found;
+	}
+
+	report ("lookup", start);
+
+	start = g_get_monotonic_time ();
+
+	for (guint i = 0; i < N_CALLS; ++i)
+		gedit_message_bus_send_message_sync (bus, message);
+
+	report ("send_message_sync", start);
+
+	if (found != 2 * N_CALLS || count != N_CALLS)
+		g_error ("Found %u and dispatched %u of %u messages", found, count, N_CALLS);
+
+	time_listeners (bus, message);
+	time_subtree (bus, message);
+	time_type_check ();
+
+	/* The bus yields between slices of the queue, and repeated
+	   mergeable messages are dispatched once */
+	time_queue (bus, "send_message", N_QUEUED, FALSE, N_QUEUED);
+	time_queue (bus, "send_message, mergeable", N_QUEUED, TRUE, 1);
+
+	time_post (bus);
+
+	g_print ("messages dispatched\n");
+	gedit_message_bus_foreach_route (bus, print_route, NULL);
+
+	g_object_unref (message);
+	g_object_unref (bus);
+
+	return 0;
+}
+
+/* ex:set ts=8 noet: */
@@ -37,6 +37,18 @@
  *
  */
 
+/**
+ * GeditMessageBusRouteForeach:
+ * @object_path: the object path of the messages, or of the subtree
+ * @method: (allow-none): the method of the messages, or %NULL for the
+ *          messages dispatched to the listeners of the subtree at @object_path
+ * @n_dispatched: how many of these messages were dispatched
+ * @user_data: the supplied user data
+ *
+ * Callback signature used by gedit_message_bus_foreach_route().
+ *
+ */
+
 /**
  * SECTION:gedit-message-bus
  * @short_description: internal message communication bus
@@ -60,6 +72,8 @@
  * and Method for which callbacks are connected is sent over the bus, the
  * callbacks are called. There is no distinction between Methods and Signals
  * (signals are simply messages where sender and receiver have switched places).
+ * Callbacks can also be connected for all the messages at an Object Path and
+ * below it (see gedit_message_bus_connect_subtree()).
  *
  * <example>
  * <title>Registering a message type</title>
@@ -110,21 +124,39 @@
  * </example>
  */
 
+/* Time spent dispatching queued messages before giving the main loop a
+   chance to handle input and drawing */
+#define DISPATCH_BUDGET_USEC 5000
+
+/* Both parts are interned, so that finding a message does not need to
+   build its identifier as a string */
 typedef struct
 {
-	gchar *object_path;
-	gchar *method;
-
-	gchar *identifier;
+	GQuark object_path;
+	GQuark method;
 } MessageIdentifier;
 
+/* The method in the identifier of the listeners of a subtree, which only
+   has the object path of the subtree. No method is ever interned as 0 */
+#define SUBTREE_METHOD 0
+
+/* The object path of a subtree, which may be a prefix of a longer object
+   path, so that looking up each subtree a message is in does not copy its
+   object path */
 typedef struct
 {
-	MessageIdentifier *identifier;
+	const gchar *path;
+	gsize length;
+} SubtreeKey;
 
-	GList *listeners;
-} Message;
+/* Messages dispatched to the listeners of a message, or of a subtree */
+typedef struct
+{
+	MessageIdentifier identifier;
+	guint64 n_dispatched;
+} Route;
 
+/* A removed listener is left in place with all its fields cleared */
 typedef struct
 {
 	guint id;
@@ -135,23 +167,75 @@ typedef struct
 	gpointer user_data;
 } Listener;
 
+typedef struct
+{
+	MessageIdentifier identifier;
+
+	/* Listeners in the order they were connected. Removed ones are only
+	   dropped from the array once enough of them add up, and never while
+	   the message is being dispatched */
+	GArray *listeners;
+	guint n_removed;
+	guint dispatching;
+} Message;
+
 typedef struct
 {
 	Message *message;
-	GList *listener;
+	guint index;
 } IdMap;
 
+/* A registered message type */
+typedef struct
+{
+	GType type;
+} MessageType;
+
+typedef struct
+{
+	gint priority;
+	GQueue messages;
+} PriorityQueue;
+
+typedef struct _PostedMessage PostedMessage;
+
+struct _PostedMessage
+{
+	GeditMessage *message;
+	PostedMessage *next;
+};
+
 struct _GeditMessageBusPrivate
 {
 	GHashTable *messages;
 	GHashTable *idmap;
 
-	GList *message_queue;
+	/* Messages sent asynchronously, in a PriorityQueue for each priority
+	   with messages waiting, the most urgent first. Mergeable messages
+	   waiting map to their link in there */
+	GArray *queues;
+	GHashTable *mergeable;
+	guint n_queued;
+
 	guint idle_id;
+	gint idle_priority;
+
+	/* Set once a round ran out of time, until the queue is empty */
+	gboolean draining;
+
+	/* Messages posted from any thread, the last one first. Threads push
+	   onto it without locking, the main context takes all of it at once */
+	PostedMessage *posted;
 
 	guint next_id;
 
-	GHashTable *types; /* mapping from identifier to GeditMessageType */
+	GHashTable *types; /* mapping from identifier to MessageType */
+
+	/* Listeners of each subtree which has any, by SubtreeKey */
+	GHashTable *subtrees;
+
+	/* Route of each message and subtree dispatched so far */
+	GHashTable *routes;
 };
 
 /* signals */
@@ -170,70 +254,220 @@ static void gedit_message_bus_dispatch_real (GeditMessageBus *bus,
 
 G_DEFINE_TYPE_WITH_PRIVATE (GeditMessageBus, gedit_message_bus, G_TYPE_OBJECT)
 
-static MessageIdentifier *
-message_identifier_new (const gchar *object_path,
-                        const gchar *method)
+static void
+message_identifier_intern (MessageIdentifier *identifier,
+                           const gchar       *object_path,
+                           const gchar       *method)
 {
-	MessageIdentifier *ret;
-
-	ret = g_slice_new (MessageIdentifier);
-
-	ret->object_path = g_strdup (object_path);
-	ret->method = g_strdup (method);
+	identifier->object_path = g_quark_from_string (object_path);
+	identifier->method = g_quark_from_string (method);
+}
 
-	ret->identifier = gedit_message_type_identifier (object_path, method);
+/* Looks up the identifier without interning anything. Returns FALSE
+   when either part was never interned, in which case nothing can be
+   registered or connected for it */
+static gboolean
+message_identifier_lookup (MessageIdentifier *identifier,
+                           const gchar       *object_path,
+                           const gchar       *method)
+{
+	identifier->object_path = g_quark_try_string (object_path);
+	identifier->method = g_quark_try_string (method);
 
-	return ret;
+	return identifier->object_path != 0 && identifier->method != 0;
 }
 
 static void
 message_identifier_free (MessageIdentifier *identifier)
 {
-	g_free (identifier->object_path);
-	g_free (identifier->method);
-	g_free (identifier->identifier);
-
 	g_slice_free (MessageIdentifier, identifier);
 }
 
 static guint
 message_identifier_hash (gconstpointer id)
 {
-	return g_str_hash (((MessageIdentifier *)id)->identifier);
+	const MessageIdentifier *identifier = id;
+
+	return identifier->object_path * 31 + identifier->method;
 }
 
 static gboolean
 message_identifier_equal (gconstpointer id1,
                           gconstpointer id2)
 {
-	return g_str_equal (((MessageIdentifier *)id1)->identifier,
-	                    ((MessageIdentifier *)id2)->identifier);
+	const MessageIdentifier *identifier1 = id1;
+	const MessageIdentifier *identifier2 = id2;
+
+	return identifier1->object_path == identifier2->object_path &&
+	       identifier1->method == identifier2->method;
+}
+
+static guint
+subtree_key_hash (gconstpointer key)
+{
+	const SubtreeKey *subtree = key;
+	guint hash = 5381;
+	gsize i;
+
+	for (i = 0; i < subtree->length; ++i)
+	{
+		hash = (hash << 5) + hash + (guchar) subtree->path[i];
+	}
+
+	return hash;
+}
+
+static gboolean
+subtree_key_equal (gconstpointer key1,
+                   gconstpointer key2)
+{
+	const SubtreeKey *subtree1 = key1;
+	const SubtreeKey *subtree2 = key2;
+
+	return subtree1->length == subtree2->length &&
+	       memcmp (subtree1->path, subtree2->path, subtree1->length) == 0;
+}
+
+static void
+subtree_key_free (SubtreeKey *key)
+{
+	g_slice_free (SubtreeKey, key);
+}
+
+static Message *
+subtree_lookup (GeditMessageBus *bus,
+                const gchar     *path,
+                gsize            length)
+{
+	SubtreeKey key = {path, length};
+
+	return g_hash_table_lookup (bus->priv->subtrees, &key);
+}
+
+static void
+route_free (Route *route)
+{
+	g_slice_free (Route, route);
+}
+
+static void
+count_route (GeditMessageBus         *bus,
+             const MessageIdentifier *identifier)
+{
+	Route *route;
+
+	route = g_hash_table_lookup (bus->priv->routes, identifier);
+
+	if (route == NULL)
+	{
+		route = g_slice_new (Route);
+		route->identifier = *identifier;
+		route->n_dispatched = 0;
+
+		g_hash_table_insert (bus->priv->routes, &route->identifier, route);
+	}
+
+	route->n_dispatched++;
 }
 
 static void
-listener_free (Listener *listener)
+listener_clear (Listener *listener)
 {
 	if (listener->destroy_data)
 	{
 		listener->destroy_data (listener->user_data);
 	}
-
-	g_slice_free (Listener, listener);
 }
 
 static void
 message_free (Message *message)
 {
-	message_identifier_free (message->identifier);
-
-	g_list_free_full (message->listeners, (GDestroyNotify) listener_free);
+	g_array_unref (message->listeners);
 	g_slice_free (Message, message);
 }
 
+static MessageType *
+message_type_new (GType gtype)
+{
+	MessageType *type = g_slice_new0 (MessageType);
+
+	type->type = gtype;
+
+	return type;
+}
+
+static void
+priority_queue_clear (PriorityQueue *queue)
+{
+	g_queue_foreach (&queue->messages, (GFunc) g_object_unref, NULL);
+	g_queue_clear (&queue->messages);
+}
+
+/* Messages queued for the same object path and method are merged */
+static guint
+pending_message_hash (gconstpointer message)
+{
+	return g_str_hash (gedit_message_get_object_path ((GeditMessage *)message)) * 31 +
+	       g_str_hash (gedit_message_get_method ((GeditMessage *)message));
+}
+
+/* The identifiers of messages of registered types are interned, so they
+   mostly compare equal by pointer */
+static gboolean
+identifier_part_equal (const gchar *part1,
+                       const gchar *part2)
+{
+	return part1 == part2 || g_str_equal (part1, part2);
+}
+
+static gboolean
+pending_message_equal (gconstpointer message1,
+                       gconstpointer message2)
+{
+	return identifier_part_equal (gedit_message_get_object_path ((GeditMessage *)message1),
+	                              gedit_message_get_object_path ((GeditMessage *)message2)) &&
+	       identifier_part_equal (gedit_message_get_method ((GeditMessage *)message1),
+	                              gedit_message_get_method ((GeditMessage *)message2));
+}
+
+/* Takes all the posted messages, in the order they were posted */
+static PostedMessage *
+take_posted_messages (GeditMessageBus *bus)
+{
+	PostedMessage *posted;
+	PostedMessage *ordered = NULL;
+
+	do
+	{
+		posted = g_atomic_pointer_get (&bus->priv->posted);
+	}
+	while (posted != NULL &&
+	       !g_atomic_pointer_compare_and_exchange (&bus->priv->posted, posted, NULL));
+
+	while (posted != NULL)
+	{
+		PostedMessage *next = posted->next;
+
+		posted->next = ordered;
+		ordered = posted;
+		posted = next;
+	}
+
+	return ordered;
+}
+
 static void
-message_queue_free (GList *queue)
+posted_messages_free (PostedMessage *posted)
 {
-	g_list_free_full (queue, g_object_unref);
+	while (posted != NULL)
+	{
+		PostedMessage *next = posted->next;
+
+		g_object_unref (posted->message);
+		g_slice_free (PostedMessage, posted);
+
+		posted = next;
+	}
 }
 
 static void
@@ -246,11 +480,16 @@ gedit_message_bus_finalize (GObject *object)
 		g_source_remove (bus->priv->idle_id);
 	}
 
-	message_queue_free (bus->priv->message_queue);
+	posted_messages_free (take_posted_messages (bus));
+
+	g_array_unref (bus->priv->queues);
+	g_hash_table_destroy (bus->priv->mergeable);
 
 	g_hash_table_destroy (bus->priv->messages);
 	g_hash_table_destroy (bus->priv->idmap);
 	g_hash_table_destroy (bus->priv->types);
+	g_hash_table_destroy (bus->priv->subtrees);
+	g_hash_table_destroy (bus->priv->routes);
 
 	G_OBJECT_CLASS (gedit_message_bus_parent_class)->finalize (object);
 }
@@ -329,18 +568,55 @@ gedit_message_bus_class_init (GeditMessageBusClass *klass)
 }
 
 static Message *
-message_new (GeditMessageBus *bus,
-             const gchar     *object_path,
-             const gchar     *method)
+message_new (GeditMessageBus         *bus,
+             const MessageIdentifier *identifier)
 {
 	Message *message = g_slice_new (Message);
 
-	message->identifier = message_identifier_new (object_path, method);
-	message->listeners = NULL;
+	message->identifier = *identifier;
+	message->listeners = g_array_new (FALSE, FALSE, sizeof (Listener));
+	message->n_removed = 0;
+	message->dispatching = 0;
+
+	g_array_set_clear_func (message->listeners, (GDestroyNotify) listener_clear);
+
+	if (identifier->method == SUBTREE_METHOD)
+	{
+		SubtreeKey *key = g_slice_new (SubtreeKey);
+
+		key->path = g_quark_to_string (identifier->object_path);
+		key->length = strlen (key->path);
+
+		g_hash_table_insert (bus->priv->subtrees, key, message);
+	}
+	else
+	{
+		g_hash_table_insert (bus->priv->messages,
+		                     &message->identifier,
+		                     message);
+	}
+
+	return message;
+}
+
+static Message *
+lookup_subtree (GeditMessageBus *bus,
+                const gchar     *object_path,
+                gboolean         create)
+{
+	Message *message;
+
+	message = subtree_lookup (bus, object_path, strlen (object_path));
+
+	if (!message && create)
+	{
+		MessageIdentifier identifier;
 
-	g_hash_table_insert (bus->priv->messages,
-	                     message->identifier,
-	                     message);
+		identifier.object_path = g_quark_from_string (object_path);
+		identifier.method = SUBTREE_METHOD;
+
+		message = message_new (bus, &identifier);
+	}
 
 	return message;
 }
@@ -351,21 +627,23 @@ lookup_message (GeditMessageBus *bus,
                 const gchar      *method,
                 gboolean          create)
 {
-	MessageIdentifier *identifier;
+	MessageIdentifier identifier;
 	Message *message;
 
-	identifier = message_identifier_new (object_path, method);
-	message = g_hash_table_lookup (bus->priv->messages, identifier);
-	message_identifier_free (identifier);
-
-	if (!message && !create)
+	if (create)
+	{
+		message_identifier_intern (&identifier, object_path, method);
+	}
+	else if (!message_identifier_lookup (&identifier, object_path, method))
 	{
 		return NULL;
 	}
 
-	if (!message)
+	message = g_hash_table_lookup (bus->priv->messages, &identifier);
+
+	if (!message && create)
 	{
-		message = message_new (bus, object_path, method);
+		message = message_new (bus, &identifier);
 	}
 
 	return message;
@@ -378,70 +656,133 @@ add_listener (GeditMessageBus      *bus,
               gpointer		    user_data,
               GDestroyNotify        destroy_data)
 {
-	Listener *listener;
+	Listener listener;
 	IdMap *idmap;
 
-	listener = g_slice_new (Listener);
-	listener->id = ++bus->priv->next_id;
-	listener->callback = callback;
-	listener->user_data = user_data;
-	listener->blocked = FALSE;
-	listener->destroy_data = destroy_data;
+	listener.id = ++bus->priv->next_id;
+	listener.callback = callback;
+	listener.user_data = user_data;
+	listener.blocked = FALSE;
+	listener.destroy_data = destroy_data;
 
-	message->listeners = g_list_append (message->listeners, listener);
+	g_array_append_val (message->listeners, listener);
 
 	idmap = g_new (IdMap, 1);
 	idmap->message = message;
-	idmap->listener = g_list_last (message->listeners);
+	idmap->index = message->listeners->len - 1;
+
+	g_hash_table_insert (bus->priv->idmap, GINT_TO_POINTER (listener.id), idmap);
+
+	return listener.id;
+}
+
+/* Drops the removed listeners of message, or the whole message when it
+   has no listeners left. Nothing moves while it is being dispatched */
+static void
+message_collect (GeditMessageBus *bus,
+                 Message         *message)
+{
+	guint len = message->listeners->len;
+	guint n = 0;
+	guint i;
+
+	if (message->dispatching > 0 || message->n_removed == 0)
+	{
+		return;
+	}
+
+	if (message->n_removed == len)
+	{
+		/* remove message because it does not have any listeners */
+		if (message->identifier.method == SUBTREE_METHOD)
+		{
+			const gchar *path = g_quark_to_string (message->identifier.object_path);
+			SubtreeKey key = {path, strlen (path)};
+
+			g_hash_table_remove (bus->priv->subtrees, &key);
+		}
+		else
+		{
+			g_hash_table_remove (bus->priv->messages, &message->identifier);
+		}
+
+		return;
+	}
+
+	/* Only compact once at least half of the listeners are gone, so
+	   that removing one is constant time on average */
+	if (message->n_removed * 2 < len)
+	{
+		return;
+	}
+
+	for (i = 0; i < len; ++i)
+	{
+		Listener *listener = &g_array_index (message->listeners, Listener, i);
+
+		if (listener->id == 0)
+		{
+			continue;
+		}
+
+		if (i != n)
+		{
+			IdMap *idmap;
+
+			idmap = g_hash_table_lookup (bus->priv->idmap, GINT_TO_POINTER (listener->id));
+			idmap->index = n;
+
+			g_array_index (message->listeners, Listener, n) = *listener;
+		}
+
+		++n;
+	}
 
-	g_hash_table_insert (bus->priv->idmap, GINT_TO_POINTER (listener->id), idmap);
+	/* The tail only holds copies now, which must not be destroyed */
+	memset (&g_array_index (message->listeners, Listener, n), 0, (len - n) * sizeof (Listener));
+	g_array_set_size (message->listeners, n);
 
-	return listener->id;
+	message->n_removed = 0;
 }
 
 static void
 remove_listener (GeditMessageBus *bus,
                  Message         *message,
-                 GList		 *listener)
+                 guint            index)
 {
-	Listener *lst;
+	Listener *slot;
+	Listener listener;
 
-	lst = (Listener *)listener->data;
+	slot = &g_array_index (message->listeners, Listener, index);
+	listener = *slot;
 
 	/* remove from idmap */
-	g_hash_table_remove (bus->priv->idmap, GINT_TO_POINTER (lst->id));
-	listener_free (lst);
+	g_hash_table_remove (bus->priv->idmap, GINT_TO_POINTER (listener.id));
 
-	/* remove from list of listeners */
-	message->listeners = g_list_delete_link (message->listeners, listener);
+	/* leave a tombstone, so that the other listeners keep their index */
+	memset (slot, 0, sizeof (Listener));
+	message->n_removed++;
 
-	if (!message->listeners)
-	{
-		/* remove message because it does not have any listeners */
-		g_hash_table_remove (bus->priv->messages, message->identifier);
-	}
+	message_collect (bus, message);
+
+	/* the bus is consistent again in case this connects or disconnects */
+	listener_clear (&listener);
 }
 
 static void
 block_listener (GeditMessageBus *bus,
                 Message         *message,
-                GList           *listener)
+                guint            index)
 {
-	Listener *lst;
-
-	lst = listener->data;
-	lst->blocked = TRUE;
+	g_array_index (message->listeners, Listener, index).blocked = TRUE;
 }
 
 static void
 unblock_listener (GeditMessageBus *bus,
                   Message         *message,
-                  GList           *listener)
+                  guint            index)
 {
-	Listener *lst;
-
-	lst = listener->data;
-	lst->blocked = FALSE;
+	g_array_index (message->listeners, Listener, index).blocked = FALSE;
 }
 
 static void
@@ -449,17 +790,81 @@ dispatch_message_real (GeditMessageBus *bus,
                        Message         *msg,
                        GeditMessage    *message)
 {
-	GList *item;
+	guint i;
+
+	/* keeps msg and the index of its listeners while dispatching */
+	msg->dispatching++;
 
-	for (item = msg->listeners; item; item = item->next)
+	/* callbacks can connect listeners, which may move the array, so
+	   each listener is looked up again */
+	for (i = 0; i < msg->listeners->len; ++i)
 	{
-		Listener *listener = (Listener *)item->data;
+		Listener *listener = &g_array_index (msg->listeners, Listener, i);
 
-		if (!listener->blocked)
+		if (listener->id != 0 && !listener->blocked)
 		{
 			listener->callback (bus, message, listener->user_data);
 		}
 	}
+
+	msg->dispatching--;
+	message_collect (bus, msg);
+}
+
+typedef gboolean (*SubtreeFunc) (GeditMessageBus *, Message *, gpointer);
+
+/* Calls func with the listeners of each subtree object_path is in, the
+   closest first, looking up each prefix of object_path up to the root,
+   until func returns TRUE */
+static gboolean
+foreach_subtree (GeditMessageBus *bus,
+                 const gchar     *object_path,
+                 SubtreeFunc      func,
+                 gpointer         user_data)
+{
+	gsize length = strlen (object_path);
+	gboolean found = FALSE;
+
+	while (!found)
+	{
+		Message *subtree;
+		gsize slash;
+
+		subtree = subtree_lookup (bus, object_path, length);
+
+		if (subtree != NULL)
+		{
+			found = func (bus, subtree, user_data);
+		}
+
+		/* just past the last slash */
+		slash = length;
+
+		while (slash > 0 && object_path[slash - 1] != '/')
+		{
+			--slash;
+		}
+
+		/* the root is the last one */
+		if (slash == 0 || slash == length)
+		{
+			break;
+		}
+
+		length = slash == 1 ? 1 : slash - 1;
+	}
+
+	return found;
+}
+
+static gboolean
+dispatch_subtree (GeditMessageBus *bus,
+                  Message         *subtree,
+                  GeditMessage    *message)
+{
+	count_route (bus, &subtree->identifier);
+	dispatch_message_real (bus, subtree, message);
+	return FALSE;
 }
 
 static void
@@ -468,7 +873,7 @@ gedit_message_bus_dispatch_real (GeditMessageBus *bus,
 {
 	const gchar *object_path;
 	const gchar *method;
-	Message *msg;
+	MessageIdentifier identifier;
 
 	object_path = gedit_message_get_object_path (message);
 	method = gedit_message_get_method (message);
@@ -476,11 +881,26 @@ gedit_message_bus_dispatch_real (GeditMessageBus *bus,
 	g_return_if_fail (object_path != NULL);
 	g_return_if_fail (method != NULL);
 
-	msg = lookup_message (bus, object_path, method, FALSE);
+	if (message_identifier_lookup (&identifier, object_path, method))
+	{
+		Message *msg;
 
-	if (msg)
+		count_route (bus, &identifier);
+
+		msg = g_hash_table_lookup (bus->priv->messages, &identifier);
+
+		if (msg)
+		{
+			dispatch_message_real (bus, msg, message);
+		}
+	}
+
+	if (g_hash_table_size (bus->priv->subtrees) > 0)
 	{
-		dispatch_message_real (bus, msg, message);
+		foreach_subtree (bus,
+		                 object_path,
+		                 (SubtreeFunc) dispatch_subtree,
+		                 message);
 	}
 }
 
@@ -491,32 +911,138 @@ dispatch_message (GeditMessageBus *bus,
 	g_signal_emit (bus, message_bus_signals[DISPATCH], 0, message);
 }
 
+static gboolean idle_dispatch (GeditMessageBus *bus);
+
+/* The queue is dispatched at the priority of the most urgent message.
+   Once a round ran out of time, the rest of the queue, and whatever is
+   sent before it is empty, waits for the input and drawing to be handled
+   like any other idle work */
+static void
+schedule_dispatch (GeditMessageBus *bus)
+{
+	gint priority;
+
+	if (bus->priv->queues->len == 0)
+	{
+		return;
+	}
+
+	priority = g_array_index (bus->priv->queues, PriorityQueue, 0).priority;
+
+	if (bus->priv->draining)
+	{
+		priority = MAX (priority, G_PRIORITY_DEFAULT_IDLE);
+	}
+
+	if (bus->priv->idle_id != 0)
+	{
+		if (bus->priv->idle_priority <= priority)
+		{
+			return;
+		}
+
+		g_source_remove (bus->priv->idle_id);
+	}
+
+	bus->priv->idle_priority = priority;
+	bus->priv->idle_id = g_idle_add_full (priority,
+	                                      (GSourceFunc)idle_dispatch,
+	                                      bus,
+	                                      NULL);
+}
+
+static PriorityQueue *
+get_priority_queue (GeditMessageBus *bus,
+                    gint             priority)
+{
+	PriorityQueue queue;
+	guint i;
+
+	for (i = 0; i < bus->priv->queues->len; ++i)
+	{
+		PriorityQueue *item = &g_array_index (bus->priv->queues, PriorityQueue, i);
+
+		if (item->priority == priority)
+		{
+			return item;
+		}
+
+		if (item->priority > priority)
+		{
+			break;
+		}
+	}
+
+	queue.priority = priority;
+	g_queue_init (&queue.messages);
+
+	g_array_insert_val (bus->priv->queues, i, queue);
+
+	return &g_array_index (bus->priv->queues, PriorityQueue, i);
+}
+
+/* Takes the next message to dispatch off the queue */
+static GeditMessage *
+pop_message (GeditMessageBus *bus)
+{
+	PriorityQueue *queue = &g_array_index (bus->priv->queues, PriorityQueue, 0);
+	GList *link = g_queue_pop_head_link (&queue->messages);
+	GeditMessage *message = link->data;
+
+	if (gedit_message_get_mergeable (message) &&
+	    g_hash_table_lookup (bus->priv->mergeable, message) == link)
+	{
+		g_hash_table_remove (bus->priv->mergeable, message);
+	}
+
+	if (g_queue_is_empty (&queue->messages))
+	{
+		g_array_remove_index (bus->priv->queues, 0);
+	}
+
+	bus->priv->n_queued--;
+
+	if (bus->priv->n_queued == 0)
+	{
+		bus->priv->draining = FALSE;
+	}
+	g_list_free_1 (link);
+
+	return message;
+}
+
+/* Dispatches the queued messages, the most urgent first, until the time
+   budget runs out. Messages sent in the meantime wait for the next round,
+   like the ones left over */
 static gboolean
 idle_dispatch (GeditMessageBus *bus)
 {
-	GList *list;
-	GList *item;
+	gint64 deadline = g_get_monotonic_time () + DISPATCH_BUDGET_USEC;
+	guint n_messages = bus->priv->n_queued;
 
 	/* make sure to set idle_id to 0 first so that any new async messages
-	   will be queued properly */
+	   will be scheduled properly */
 	bus->priv->idle_id = 0;
 
-	/* reverse queue to get correct delivery order */
-	list = g_list_reverse (bus->priv->message_queue);
-	bus->priv->message_queue = NULL;
-
-	for (item = list; item; item = item->next)
+	while (n_messages-- > 0 && bus->priv->n_queued > 0)
 	{
-		GeditMessage *msg = GEDIT_MESSAGE (item->data);
+		GeditMessage *message = pop_message (bus);
 
-		dispatch_message (bus, msg);
+		dispatch_message (bus, message);
+		g_object_unref (message);
+
+		if (g_get_monotonic_time () >= deadline)
+		{
+			bus->priv->draining = bus->priv->n_queued > 0;
+			break;
+		}
 	}
 
-	message_queue_free (list);
-	return FALSE;
+	schedule_dispatch (bus);
+	return G_SOURCE_REMOVE;
 }
 
-typedef void (*MatchCallback) (GeditMessageBus *, Message *, GList *);
+typedef void (*MatchCallback) (GeditMessageBus *, Message *, guint);
 
 static void
 process_by_id (GeditMessageBus *bus,
@@ -533,7 +1059,21 @@ process_by_id (GeditMessageBus *bus,
 		return;
 	}
 
-	processor (bus, idmap->message, idmap->listener);
+	processor (bus, idmap->message, idmap->index);
+}
+
+static void
+warn_no_handler (const gchar *object_path,
+                 const gchar *method)
+{
+	if (method == NULL)
+	{
+		g_warning ("No such subtree handler registered for %s", object_path);
+	}
+	else
+	{
+		g_warning ("No such handler registered for %s.%s", object_path, method);
+	}
 }
 
 static void
@@ -545,35 +1085,43 @@ process_by_match (GeditMessageBus      *bus,
                   MatchCallback         processor)
 {
 	Message *message;
-	GList *item;
+	guint i;
 
-	message = lookup_message (bus, object_path, method, FALSE);
+	if (method == NULL)
+	{
+		message = lookup_subtree (bus, object_path, FALSE);
+	}
+	else
+	{
+		message = lookup_message (bus, object_path, method, FALSE);
+	}
 
 	if (!message)
 	{
-		g_warning ("No such handler registered for %s.%s", object_path, method);
+		warn_no_handler (object_path, method);
 		return;
 	}
 
-	for (item = message->listeners; item; item = item->next)
+	for (i = 0; i < message->listeners->len; ++i)
 	{
-		Listener *listener = (Listener *)item->data;
+		Listener *listener = &g_array_index (message->listeners, Listener, i);
 
-		if (listener->callback == callback &&
+		if (listener->id != 0 &&
+		    listener->callback == callback &&
 		    listener->user_data == user_data)
 		{
-			processor (bus, message, item);
+			processor (bus, message, i);
 			return;
 		}
 	}
 
-	g_warning ("No such handler registered for %s.%s", object_path, method);
+	warn_no_handler (object_path, method);
 }
 
 static void
-free_type (gpointer data)
+free_type (MessageType *type)
 {
-	g_slice_free (GType, data);
+	g_slice_free (MessageType, type);
 }
 
 static void
@@ -595,6 +1143,22 @@ gedit_message_bus_init (GeditMessageBus *self)
 	                                           message_identifier_equal,
 	                                           (GDestroyNotify) message_identifier_free,
 	                                           (GDestroyNotify) free_type);
+
+	self->priv->subtrees = g_hash_table_new_full (subtree_key_hash,
+	                                              subtree_key_equal,
+	                                              (GDestroyNotify) subtree_key_free,
+	                                              (GDestroyNotify) message_free);
+
+	self->priv->routes = g_hash_table_new_full (message_identifier_hash,
+	                                            message_identifier_equal,
+	                                            NULL,
+	                                            (GDestroyNotify) route_free);
+
+	self->priv->queues = g_array_new (FALSE, FALSE, sizeof (PriorityQueue));
+	g_array_set_clear_func (self->priv->queues, (GDestroyNotify) priority_queue_clear);
+
+	self->priv->mergeable = g_hash_table_new (pending_message_hash,
+	                                          pending_message_equal);
 }
 
 /**
@@ -655,16 +1219,17 @@ gedit_message_bus_lookup (GeditMessageBus *bus,
                           const gchar	  *object_path,
                           const gchar	  *method)
 {
-	MessageIdentifier *identifier;
-	GType *message_type;
+	MessageIdentifier identifier;
+	MessageType *message_type = NULL;
 
 	g_return_val_if_fail (GEDIT_IS_MESSAGE_BUS (bus), G_TYPE_INVALID);
 	g_return_val_if_fail (object_path != NULL, G_TYPE_INVALID);
 	g_return_val_if_fail (method != NULL, G_TYPE_INVALID);
 
-	identifier = message_identifier_new (object_path, method);
-	message_type = g_hash_table_lookup (bus->priv->types, identifier);
-	message_identifier_free (identifier);
+	if (message_identifier_lookup (&identifier, object_path, method))
+	{
+		message_type = g_hash_table_lookup (bus->priv->types, &identifier);
+	}
 
 	if (!message_type)
 	{
@@ -672,7 +1237,7 @@ gedit_message_bus_lookup (GeditMessageBus *bus,
 	}
 	else
 	{
-		return *message_type;
+		return message_type->type;
 	}
 }
 
@@ -696,8 +1261,7 @@ gedit_message_bus_register (GeditMessageBus *bus,
                             const gchar     *object_path,
                             const gchar	    *method)
 {
-	MessageIdentifier *identifier;
-	GType *ntype;
+	MessageIdentifier identifier;
 
 	g_return_if_fail (GEDIT_IS_MESSAGE_BUS (bus));
 	g_return_if_fail (gedit_message_is_valid_object_path (object_path));
@@ -710,14 +1274,11 @@ gedit_message_bus_register (GeditMessageBus *bus,
 		           method);
 	}
 
-	identifier = message_identifier_new (object_path, method);
-	ntype = g_slice_new (GType);
-
-	*ntype = message_type;
+	message_identifier_intern (&identifier, object_path, method);
 
 	g_hash_table_insert (bus->priv->types,
-	                     identifier,
-	                     ntype);
+	                     g_slice_dup (MessageIdentifier, &identifier),
+	                     message_type_new (message_type));
 
 	g_signal_emit (bus,
 	               message_bus_signals[REGISTERED],
@@ -732,12 +1293,11 @@ gedit_message_bus_unregister_real (GeditMessageBus  *bus,
                                    const gchar      *method,
                                    gboolean          remove_from_store)
 {
-	MessageIdentifier *identifier;
+	MessageIdentifier identifier;
 
-	identifier = message_identifier_new (object_path, method);
-
-	if (!remove_from_store || g_hash_table_remove (bus->priv->types,
-	                                               identifier))
+	if (!remove_from_store ||
+	    (message_identifier_lookup (&identifier, object_path, method) &&
+	     g_hash_table_remove (bus->priv->types, &identifier)))
 	{
 		g_signal_emit (bus,
 		               message_bus_signals[UNREGISTERED],
@@ -745,8 +1305,6 @@ gedit_message_bus_unregister_real (GeditMessageBus  *bus,
 		               object_path,
 		               method);
 	}
-
-	message_identifier_free (identifier);
 }
 
 /**
@@ -779,19 +1337,19 @@ gedit_message_bus_unregister (GeditMessageBus  *bus,
 typedef struct
 {
 	GeditMessageBus *bus;
-	const gchar *object_path;
+	GQuark object_path;
 } UnregisterInfo;
 
 static gboolean
 unregister_each (MessageIdentifier *identifier,
-                 GType             *gtype,
+                 MessageType       *type,
                  UnregisterInfo    *info)
 {
-	if (g_strcmp0 (identifier->object_path, info->object_path) == 0)
+	if (identifier->object_path == info->object_path)
 	{
 		gedit_message_bus_unregister_real (info->bus,
-		                                   identifier->object_path,
-		                                   identifier->method,
+		                                   g_quark_to_string (identifier->object_path),
+		                                   g_quark_to_string (identifier->method),
 		                                   FALSE);
 
 		return TRUE;
@@ -816,11 +1374,20 @@ void
 gedit_message_bus_unregister_all (GeditMessageBus *bus,
                                   const gchar     *object_path)
 {
-	UnregisterInfo info = {bus, object_path};
+	UnregisterInfo info;
 
 	g_return_if_fail (GEDIT_IS_MESSAGE_BUS (bus));
 	g_return_if_fail (object_path != NULL);
 
+	info.bus = bus;
+	info.object_path = g_quark_try_string (object_path);
+
+	/* Nothing was ever registered at an object path never interned */
+	if (info.object_path == 0)
+	{
+		return;
+	}
+
 	g_hash_table_foreach_remove (bus->priv->types,
 	                             (GHRFunc)unregister_each,
 	                             &info);
@@ -844,18 +1411,74 @@ gedit_message_bus_is_registered (GeditMessageBus  *bus,
                                  const gchar	  *object_path,
                                  const gchar      *method)
 {
-	MessageIdentifier *identifier;
-	gboolean ret;
+	MessageIdentifier identifier;
+
+	g_return_val_if_fail (GEDIT_IS_MESSAGE_BUS (bus), FALSE);
+	g_return_val_if_fail (object_path != NULL, FALSE);
+	g_return_val_if_fail (method != NULL, FALSE);
+
+	return message_identifier_lookup (&identifier, object_path, method) &&
+	       g_hash_table_lookup (bus->priv->types, &identifier) != NULL;
+}
+
+static gboolean
+message_has_listeners (GeditMessageBus *bus,
+                       Message         *message,
+                       gpointer         user_data)
+{
+	guint i;
+
+	for (i = 0; i < message->listeners->len; ++i)
+	{
+		Listener *listener = &g_array_index (message->listeners, Listener, i);
+
+		if (listener->id != 0 && !listener->blocked)
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+ * gedit_message_bus_has_listeners:
+ * @bus: a #GeditMessageBus
+ * @object_path: the object path
+ * @method: the method
+ *
+ * Check whether sending a message @method at @object_path would evoke any
+ * callback, connected either to the message with gedit_message_bus_connect()
+ * or to a subtree it is in with gedit_message_bus_connect_subtree(). Blocked
+ * callbacks are not counted. This lets a sender skip building messages
+ * nobody listens to.
+ *
+ * Return value: %TRUE if a callback is connected to @method at @object_path
+ *
+ */
+gboolean
+gedit_message_bus_has_listeners (GeditMessageBus *bus,
+                                 const gchar     *object_path,
+                                 const gchar     *method)
+{
+	MessageIdentifier identifier;
 
 	g_return_val_if_fail (GEDIT_IS_MESSAGE_BUS (bus), FALSE);
 	g_return_val_if_fail (object_path != NULL, FALSE);
 	g_return_val_if_fail (method != NULL, FALSE);
 
-	identifier = message_identifier_new (object_path, method);
-	ret = g_hash_table_lookup (bus->priv->types, identifier) != NULL;
-	message_identifier_free (identifier);
+	if (message_identifier_lookup (&identifier, object_path, method))
+	{
+		Message *message = g_hash_table_lookup (bus->priv->messages, &identifier);
 
-	return ret;
+		if (message != NULL && message_has_listeners (bus, message, NULL))
+		{
+			return TRUE;
+		}
+	}
+
+	return g_hash_table_size (bus->priv->subtrees) > 0 &&
+	       foreach_subtree (bus, object_path, message_has_listeners, NULL);
 }
 
 typedef struct
@@ -866,11 +1489,11 @@ typedef struct
 
 static void
 foreach_type (MessageIdentifier *identifier,
-              GType              *message_type,
+              MessageType       *type,
               ForeachInfo       *info)
 {
-	info->func (identifier->object_path,
-	            identifier->method,
+	info->func (g_quark_to_string (identifier->object_path),
+	            g_quark_to_string (identifier->method),
 	            info->user_data);
 }
 
@@ -896,6 +1519,50 @@ gedit_message_bus_foreach (GeditMessageBus        *bus,
 	g_hash_table_foreach (bus->priv->types, (GHFunc)foreach_type, &info);
 }
 
+typedef struct
+{
+	GeditMessageBusRouteForeach func;
+	gpointer user_data;
+} RouteForeachInfo;
+
+static void
+foreach_route (MessageIdentifier *identifier,
+               Route             *route,
+               RouteForeachInfo  *info)
+{
+	info->func (g_quark_to_string (identifier->object_path),
+	            identifier->method == SUBTREE_METHOD ? NULL : g_quark_to_string (identifier->method),
+	            route->n_dispatched,
+	            info->user_data);
+}
+
+/**
+ * gedit_message_bus_foreach_route:
+ * @bus: the #GeditMessageBus
+ * @func: (scope call): the callback function
+ * @user_data: the user data to supply to the callback function
+ *
+ * Calls @func for each route messages were dispatched on, with the number
+ * of messages dispatched on it since the bus was created. A message sent
+ * at an object path and method is dispatched on the route of that object
+ * path and method, and on the route of each subtree with listeners it is
+ * in, which is reported with a %NULL method. This is meant to find out
+ * which messages are sent the most.
+ *
+ */
+void
+gedit_message_bus_foreach_route (GeditMessageBus             *bus,
+                                 GeditMessageBusRouteForeach  func,
+                                 gpointer                     user_data)
+{
+	RouteForeachInfo info = {func, user_data};
+
+	g_return_if_fail (GEDIT_IS_MESSAGE_BUS (bus));
+	g_return_if_fail (func != NULL);
+
+	g_hash_table_foreach (bus->priv->routes, (GHFunc)foreach_route, &info);
+}
+
 /**
  * gedit_message_bus_connect:
  * @bus: a #GeditMessageBus
@@ -933,6 +1600,50 @@ gedit_message_bus_connect (GeditMessageBus	*bus,
 	return add_listener (bus, message, callback, user_data, destroy_data);
 }
 
+/**
+ * gedit_message_bus_connect_subtree:
+ * @bus: a #GeditMessageBus
+ * @object_path: the object path
+ * @callback: function to be called when a message at or below @object_path
+ *            is sent
+ * @user_data: (allow-none): user_data to use for the callback
+ * @destroy_data: (allow-none): function to evoke with @user_data as argument when @user_data
+ *                needs to be freed
+ *
+ * Connect a callback handler to be evoked when any message at @object_path,
+ * or at an object path below it, is sent over the bus. For instance,
+ * connecting at /plugins/filebrowser also gets the messages sent at
+ * /plugins/filebrowser/events, and connecting at / gets all the messages.
+ * These callbacks are called after the ones connected with
+ * gedit_message_bus_connect() for the message, the ones for the longest
+ * object path first.
+ *
+ * The callback can be disconnected, blocked and unblocked with the returned
+ * identifier, or by passing %NULL as the method to
+ * gedit_message_bus_disconnect_by_func() and the like.
+ *
+ * Return value: the callback identifier
+ *
+ */
+guint
+gedit_message_bus_connect_subtree (GeditMessageBus      *bus,
+                                   const gchar          *object_path,
+                                   GeditMessageCallback  callback,
+                                   gpointer              user_data,
+                                   GDestroyNotify        destroy_data)
+{
+	Message *message;
+
+	g_return_val_if_fail (GEDIT_IS_MESSAGE_BUS (bus), 0);
+	g_return_val_if_fail (g_strcmp0 (object_path, "/") == 0 ||
+	                      gedit_message_is_valid_object_path (object_path), 0);
+	g_return_val_if_fail (callback != NULL, 0);
+
+	message = lookup_subtree (bus, object_path, TRUE);
+
+	return add_listener (bus, message, callback, user_data, destroy_data);
+}
+
 /**
  * gedit_message_bus_disconnect:
  * @bus: a #GeditMessageBus
@@ -954,7 +1665,8 @@ gedit_message_bus_disconnect (GeditMessageBus *bus,
  * gedit_message_bus_disconnect_by_func:
  * @bus: a #GeditMessageBus
  * @object_path: the object path
- * @method: the method
+ * @method: (allow-none): the method, or %NULL for a callback connected with
+ *          gedit_message_bus_connect_subtree()
  * @callback: (scope call): the connected callback
  * @user_data: the user_data with which the callback was connected
  *
@@ -1002,7 +1714,8 @@ gedit_message_bus_block (GeditMessageBus *bus,
  * gedit_message_bus_block_by_func:
  * @bus: a #GeditMessageBus
  * @object_path: the object path
- * @method: the method
+ * @method: (allow-none): the method, or %NULL for a callback connected with
+ *          gedit_message_bus_connect_subtree()
  * @callback: (scope call): the callback to block
  * @user_data: the user_data with which the callback was connected
  *
@@ -1048,7 +1761,8 @@ gedit_message_bus_unblock (GeditMessageBus *bus,
  * gedit_message_bus_unblock_by_func:
  * @bus: a #GeditMessageBus
  * @object_path: the object path
- * @method: the method
+ * @method: (allow-none): the method, or %NULL for a callback connected with
+ *          gedit_message_bus_connect_subtree()
  * @callback: (scope call): the callback to block
  * @user_data: the user_data with which the callback was connected
  *
@@ -1076,16 +1790,37 @@ static void
 send_message_real (GeditMessageBus *bus,
                    GeditMessage    *message)
 {
-	bus->priv->message_queue = g_list_prepend (bus->priv->message_queue,
-	                                           g_object_ref (message));
+	gint priority = gedit_message_get_priority (message);
+	gboolean mergeable = gedit_message_get_mergeable (message);
+	PriorityQueue *queue;
+
+	if (mergeable)
+	{
+		GList *pending = g_hash_table_lookup (bus->priv->mergeable, message);
+
+		/* take the place of the message still waiting */
+		if (pending != NULL && gedit_message_get_priority (pending->data) == priority)
+		{
+			GeditMessage *replaced = pending->data;
+
+			pending->data = g_object_ref (message);
+			g_hash_table_replace (bus->priv->mergeable, message, pending);
+			g_object_unref (replaced);
+
+			return;
+		}
+	}
+
+	queue = get_priority_queue (bus, priority);
+	g_queue_push_tail (&queue->messages, g_object_ref (message));
+	bus->priv->n_queued++;
 
-	if (bus->priv->idle_id == 0)
+	if (mergeable)
 	{
-		bus->priv->idle_id = g_idle_add_full (G_PRIORITY_HIGH,
-		                                      (GSourceFunc)idle_dispatch,
-		                                      bus,
-		                                      NULL);
+		g_hash_table_replace (bus->priv->mergeable, message, queue->messages.tail);
 	}
+
+	schedule_dispatch (bus);
 }
 
 /**
@@ -1098,6 +1833,12 @@ send_message_real (GeditMessageBus *bus,
  * convenience function gedit_message_bus_send() can be used to easily send
  * a message without constructing the message object explicitly first.
  *
+ * Messages are dispatched from the main loop according to their
+ * #GeditMessage:priority, in the order they were sent for the same
+ * priority. A #GeditMessage:mergeable message replaces a message for the
+ * same method at the same object path, sent with the same priority, which
+ * is still waiting to be dispatched.
+ *
  */
 void
 gedit_message_bus_send_message (GeditMessageBus *bus,
@@ -1109,6 +1850,67 @@ gedit_message_bus_send_message (GeditMessageBus *bus,
 	send_message_real (bus, message);
 }
 
+/* Queues the messages posted since the last time, all at once */
+static gboolean
+queue_posted_messages (GeditMessageBus *bus)
+{
+	PostedMessage *posted = take_posted_messages (bus);
+	PostedMessage *item;
+
+	for (item = posted; item != NULL; item = item->next)
+	{
+		send_message_real (bus, item->message);
+	}
+
+	posted_messages_free (posted);
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * gedit_message_bus_post_message:
+ * @bus: a #GeditMessageBus
+ * @message: the message to post
+ *
+ * This sends the provided @message asynchronously over the bus, like
+ * gedit_message_bus_send_message(), except that it can be called from any
+ * thread. This is meant for reporting the results of work done in other
+ * threads. The messages are dispatched in the main context, in the order
+ * in which each thread posted them. The caller must keep a reference to
+ * @bus while posting.
+ *
+ */
+void
+gedit_message_bus_post_message (GeditMessageBus *bus,
+                                GeditMessage    *message)
+{
+	PostedMessage *posted;
+	PostedMessage *head;
+
+	g_return_if_fail (GEDIT_IS_MESSAGE_BUS (bus));
+	g_return_if_fail (GEDIT_IS_MESSAGE (message));
+
+	posted = g_slice_new (PostedMessage);
+	posted->message = g_object_ref (message);
+
+	do
+	{
+		head = g_atomic_pointer_get (&bus->priv->posted);
+		posted->next = head;
+	}
+	while (!g_atomic_pointer_compare_and_exchange (&bus->priv->posted, head, posted));
+
+	/* the first message since the last time wakes up the main context,
+	   the ones posted until it runs come along */
+	if (head == NULL)
+	{
+		g_main_context_invoke_full (NULL,
+		                            G_PRIORITY_HIGH,
+		                            (GSourceFunc)queue_posted_messages,
+		                            g_object_ref (bus),
+		                            g_object_unref);
+	}
+}
+
 /**
  * gedit_message_bus_send_message_sync:
  * @bus: a #GeditMessageBus
@@ -69,6 +69,11 @@ typedef void (* GeditMessageBusForeach) (gchar const      *object_path,
                                          gchar const      *method,
                                          gpointer          user_data);
 
+typedef void (* GeditMessageBusRouteForeach) (gchar const *object_path,
+                                              gchar const *method,
+                                              guint64      n_dispatched,
+                                              gpointer     user_data);
+
 GType             gedit_message_bus_get_type           (void) G_GNUC_CONST;
 
 GeditMessageBus  *gedit_message_bus_get_default        (void);
@@ -93,11 +98,18 @@ void              gedit_message_bus_unregister_all     (GeditMessageBus        *
 gboolean          gedit_message_bus_is_registered      (GeditMessageBus        *bus,
                                                         const gchar            *object_path,
                                                         const gchar            *method);
+gboolean          gedit_message_bus_has_listeners      (GeditMessageBus        *bus,
+                                                        const gchar            *object_path,
+                                                        const gchar            *method);
 
 void              gedit_message_bus_foreach            (GeditMessageBus        *bus,
                                                         GeditMessageBusForeach  func,
                                                         gpointer                user_data);
 
+void              gedit_message_bus_foreach_route      (GeditMessageBus             *bus,
+                                                        GeditMessageBusRouteForeach  func,
+                                                        gpointer                     user_data);
+
 guint             gedit_message_bus_connect            (GeditMessageBus        *bus,
                                                         const gchar            *object_path,
                                                         const gchar            *method,
@@ -105,6 +117,12 @@ guint             gedit_message_bus_connect            (GeditMessageBus        *
                                                         gpointer                user_data,
                                                         GDestroyNotify          destroy_data);
 
+guint             gedit_message_bus_connect_subtree    (GeditMessageBus        *bus,
+                                                        const gchar            *object_path,
+                                                        GeditMessageCallback    callback,
+                                                        gpointer                user_data,
+                                                        GDestroyNotify          destroy_data);
+
 void              gedit_message_bus_disconnect         (GeditMessageBus        *bus,
                                                         guint                   id);
 
@@ -134,6 +152,8 @@ void              gedit_message_bus_send_message       (GeditMessageBus        *
                                                         GeditMessage           *message);
 void              gedit_message_bus_send_message_sync  (GeditMessageBus        *bus,
                                                         GeditMessage           *message);
+void              gedit_message_bus_post_message       (GeditMessageBus        *bus,
+                                                        GeditMessage           *message);
 
 void              gedit_message_bus_send               (GeditMessageBus        *bus,
                                                         const gchar            *object_path,
@@ -41,8 +41,15 @@
 
 struct _GeditMessagePrivate
 {
-	gchar *object_path;
-	gchar *method;
+	/* The interned strings when the bus interned them, registering or
+	   connecting to the message, the owned copies otherwise */
+	const gchar *object_path;
+	const gchar *method;
+	gchar *owned_object_path;
+	gchar *owned_method;
+
+	gint priority;
+	guint mergeable : 1;
 };
 
 enum
@@ -50,11 +57,19 @@ enum
 	PROP_0,
 	PROP_OBJECT_PATH,
 	PROP_METHOD,
+	PROP_PRIORITY,
+	PROP_MERGEABLE,
 	LAST_PROP
 };
 
 static GParamSpec *properties[LAST_PROP];
 
+/* The value types of the properties looked up by gedit_message_type_has()
+   and gedit_message_type_check(), by message type and then by property
+   name. G_TYPE_INVALID records a property the type does not have */
+G_LOCK_DEFINE_STATIC (property_types);
+static GHashTable *property_types = NULL;
+
 G_DEFINE_TYPE_WITH_PRIVATE (GeditMessage, gedit_message, G_TYPE_OBJECT)
 
 static void
@@ -62,12 +77,33 @@ gedit_message_finalize (GObject *object)
 {
 	GeditMessage *message = GEDIT_MESSAGE (object);
 
-	g_free (message->priv->object_path);
-	g_free (message->priv->method);
+	g_free (message->priv->owned_object_path);
+	g_free (message->priv->owned_method);
 
 	G_OBJECT_CLASS (gedit_message_parent_class)->finalize (object);
 }
 
+/* Shares the interned copy of str when there is one, so that messages
+   sent many times do not copy their identifier, and copies it otherwise,
+   so that arbitrary strings are not interned for good */
+static const gchar *
+set_identifier_part (gchar       **owned,
+                     const gchar  *str)
+{
+	GQuark quark = str != NULL ? g_quark_try_string (str) : 0;
+
+	g_free (*owned);
+	*owned = NULL;
+
+	if (quark != 0)
+	{
+		return g_quark_to_string (quark);
+	}
+
+	*owned = g_strdup (str);
+	return *owned;
+}
+
 static void
 gedit_message_get_property (GObject    *object,
                             guint       prop_id,
@@ -79,12 +115,22 @@ gedit_message_get_property (GObject    *object,
 	switch (prop_id)
 	{
 		case PROP_OBJECT_PATH:
-			g_value_set_string (value,
-			                    msg->priv->object_path);
+			if (msg->priv->owned_object_path != NULL)
+				g_value_set_string (value, msg->priv->object_path);
+			else
+				g_value_set_static_string (value, msg->priv->object_path);
 			break;
 		case PROP_METHOD:
-			g_value_set_string (value,
-			                    msg->priv->method);
+			if (msg->priv->owned_method != NULL)
+				g_value_set_string (value, msg->priv->method);
+			else
+				g_value_set_static_string (value, msg->priv->method);
+			break;
+		case PROP_PRIORITY:
+			g_value_set_int (value, msg->priv->priority);
+			break;
+		case PROP_MERGEABLE:
+			g_value_set_boolean (value, msg->priv->mergeable);
 			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -103,12 +149,18 @@ gedit_message_set_property (GObject      *object,
 	switch (prop_id)
 	{
 		case PROP_OBJECT_PATH:
-			g_free (msg->priv->object_path);
-			msg->priv->object_path = g_value_dup_string (value);
+			msg->priv->object_path = set_identifier_part (&msg->priv->owned_object_path,
+			                                              g_value_get_string (value));
 			break;
 		case PROP_METHOD:
-			g_free (msg->priv->method);
-			msg->priv->method = g_value_dup_string (value);
+			msg->priv->method = set_identifier_part (&msg->priv->owned_method,
+			                                         g_value_get_string (value));
+			break;
+		case PROP_PRIORITY:
+			msg->priv->priority = g_value_get_int (value);
+			break;
+		case PROP_MERGEABLE:
+			msg->priv->mergeable = g_value_get_boolean (value);
 			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -152,6 +204,39 @@ gedit_message_class_init (GeditMessageClass *klass)
 		                     NULL,
 		                     G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS);
 
+	/**
+	 * GeditMessage:priority:
+	 *
+	 * The priority at which the message is dispatched when it is sent
+	 * asynchronously, see gedit_message_bus_send_message(). Messages with
+	 * a lower value are dispatched first.
+	 *
+	 */
+	properties[PROP_PRIORITY] =
+		g_param_spec_int ("priority",
+		                  "PRIORITY",
+		                  "The message dispatch priority",
+		                  G_MININT,
+		                  G_MAXINT,
+		                  G_PRIORITY_HIGH,
+		                  G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS);
+
+	/**
+	 * GeditMessage:mergeable:
+	 *
+	 * Whether the message replaces a message for the same method at the
+	 * same object path which was sent asynchronously and is still waiting
+	 * to be dispatched. This is meant for messages which only carry the
+	 * latest state of something, like status updates.
+	 *
+	 */
+	properties[PROP_MERGEABLE] =
+		g_param_spec_boolean ("mergeable",
+		                      "MERGEABLE",
+		                      "Whether the message replaces a pending one",
+		                      FALSE,
+		                      G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS);
+
 	g_object_class_install_properties (object_class, LAST_PROP, properties);
 }
 
@@ -161,6 +246,49 @@ gedit_message_init (GeditMessage *self)
 	self->priv = gedit_message_get_instance_private (self);
 }
 
+static GType
+lookup_property_type (GType        gtype,
+                      const gchar *propname)
+{
+	GHashTable *names;
+	gpointer value_type;
+
+	G_LOCK (property_types);
+
+	if (property_types == NULL)
+	{
+		property_types = g_hash_table_new_full (g_direct_hash,
+		                                        g_direct_equal,
+		                                        NULL,
+		                                        (GDestroyNotify) g_hash_table_destroy);
+	}
+
+	names = g_hash_table_lookup (property_types, GSIZE_TO_POINTER (gtype));
+
+	if (names == NULL)
+	{
+		names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+		g_hash_table_insert (property_types, GSIZE_TO_POINTER (gtype), names);
+	}
+
+	if (!g_hash_table_lookup_extended (names, propname, NULL, &value_type))
+	{
+		GObjectClass *klass;
+		GParamSpec *spec;
+
+		klass = g_type_class_ref (gtype);
+		spec = g_object_class_find_property (klass, propname);
+		value_type = GSIZE_TO_POINTER (spec != NULL ? spec->value_type : G_TYPE_INVALID);
+		g_type_class_unref (klass);
+
+		g_hash_table_insert (names, g_strdup (propname), value_type);
+	}
+
+	G_UNLOCK (property_types);
+
+	return GPOINTER_TO_SIZE (value_type);
+}
+
 /**
  * gedit_message_get_method:
  * @message: the #GeditMessage
@@ -178,6 +306,42 @@ gedit_message_get_method (GeditMessage *message)
 	return message->priv->method;
 }
 
+/**
+ * gedit_message_get_priority:
+ * @message: the #GeditMessage
+ *
+ * Get the priority at which the message is dispatched when it is sent
+ * asynchronously.
+ *
+ * Return value: the message priority
+ *
+ */
+gint
+gedit_message_get_priority (GeditMessage *message)
+{
+	g_return_val_if_fail (GEDIT_IS_MESSAGE (message), G_PRIORITY_HIGH);
+
+	return message->priv->priority;
+}
+
+/**
+ * gedit_message_get_mergeable:
+ * @message: the #GeditMessage
+ *
+ * Get whether the message replaces a pending message for the same method
+ * at the same object path.
+ *
+ * Return value: %TRUE if the message is mergeable
+ *
+ */
+gboolean
+gedit_message_get_mergeable (GeditMessage *message)
+{
+	g_return_val_if_fail (GEDIT_IS_MESSAGE (message), FALSE);
+
+	return message->priv->mergeable;
+}
+
 /**
  * gedit_message_get_object_path:
  * @message: the #GeditMessage
@@ -271,31 +435,20 @@ gboolean
 gedit_message_has (GeditMessage *message,
                    const gchar  *propname)
 {
-	GObjectClass *klass;
-
 	g_return_val_if_fail (GEDIT_IS_MESSAGE (message), FALSE);
 	g_return_val_if_fail (propname != NULL, FALSE);
 
-	klass = G_OBJECT_GET_CLASS (G_OBJECT (message));
-
-	return g_object_class_find_property (klass, propname) != NULL;
+	return lookup_property_type (G_OBJECT_TYPE (message), propname) != G_TYPE_INVALID;
 }
 
 gboolean
 gedit_message_type_has (GType         gtype,
                         const gchar  *propname)
 {
-	GObjectClass *klass;
-	gboolean ret;
-
 	g_return_val_if_fail (g_type_is_a (gtype, GEDIT_TYPE_MESSAGE), FALSE);
 	g_return_val_if_fail (propname != NULL, FALSE);
 
-	klass = g_type_class_ref (gtype);
-	ret = g_object_class_find_property (klass, propname) != NULL;
-	g_type_class_unref (klass);
-
-	return ret;
+	return lookup_property_type (gtype, propname) != G_TYPE_INVALID;
 }
 
 gboolean
@@ -303,19 +456,14 @@ gedit_message_type_check (GType         gtype,
                           const gchar  *propname,
                           GType         value_type)
 {
-	GObjectClass *klass;
-	gboolean ret;
-	GParamSpec *spec;
+	GType property_type;
 
 	g_return_val_if_fail (g_type_is_a (gtype, GEDIT_TYPE_MESSAGE), FALSE);
 	g_return_val_if_fail (propname != NULL, FALSE);
 
-	klass = g_type_class_ref (gtype);
-	spec = g_object_class_find_property (klass, propname);
-	ret = spec != NULL && spec->value_type == value_type;
-	g_type_class_unref (klass);
+	property_type = lookup_property_type (gtype, propname);
 
-	return ret;
+	return property_type != G_TYPE_INVALID && property_type == value_type;
 }
 
 /* ex:set ts=8 noet: */
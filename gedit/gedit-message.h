@@ -55,6 +55,8 @@ GType        gedit_message_get_type             (void) G_GNUC_CONST;
 
 const gchar *gedit_message_get_object_path      (GeditMessage *message);
 const gchar *gedit_message_get_method           (GeditMessage *message);
+gint         gedit_message_get_priority         (GeditMessage *message);
+gboolean     gedit_message_get_mergeable        (GeditMessage *message);
 
 gboolean     gedit_message_type_has             (GType         gtype,
                                                  const gchar  *propname);
@@ -0,0 +1,1549 @@
+/*
+ * file-browser-store-benchmark.c
+ * This file is part of gedit
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/* Loads synthetic directory trees into a GeditFileBrowserStore without
+ * any view or display, and reports how long that takes. Each scenario
+ * runs in a process of its own, so that the peak RSS is its own.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <glib/gstdio.h>
+#include <gedit/gedit-message-bus.h>
+
+#include "gedit-file-browser-store.h"
+#include "gedit-file-browser-enum-types.h"
+#include "gedit-file-browser-git-status-provider.h"
+#include "messages/messages.h"
+
+#define MESSAGE_OBJECT_PATH "/plugins/filebrowser"
+
+/* Same as the number of rows the store announces at once */
+#define BATCH_SIZE 100
+
+#define DEEP_LEVELS 10
+#define DEEP_FILES_PER_LEVEL 1000
+#define MIXED_FILES 20000
+
+/* Files of the directory sorted by name */
+#define SORT_FILES 50000
+
+/* Nodes of the directories loaded to measure the memory they take */
+#define MEMORY_SMALL_FILES 100000
+#define MEMORY_LARGE_FILES 1000000
+
+/* Files of the git repository, every GIT_MODIFIED_EVERY one of them is
+   modified and GIT_UNTRACKED_FILES more are added */
+#define GIT_FILES 5000
+#define GIT_MODIFIED_EVERY 10
+#define GIT_UNTRACKED_FILES 100
+
+/* Gives up on a scenario which does not finish loading */
+#define LOAD_TIMEOUT_SEC 300
+
+/* What the store used to list directories with, and what it lists them
+   with now that the full content type is only looked up for shown rows */
+#define SNIFFED_ATTRIBUTE_TYPES G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+				G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+				G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+				G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+				G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
+				G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE "," \
+				G_FILE_ATTRIBUTE_STANDARD_ICON "," \
+				G_FILE_ATTRIBUTE_TIME_MODIFIED
+#define GUESSED_ATTRIBUTE_TYPES G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+				G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+				G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+				G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+				G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
+				G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE "," \
+				G_FILE_ATTRIBUTE_TIME_MODIFIED
+
+typedef struct
+{
+	GeditFileBrowserStore *model;
+	GMainLoop             *loop;
+
+	/* Directories to load, including the root, before it is done */
+	guint                  n_directories;
+	gboolean               expand;
+	GList                 *prefetch;
+
+	gint64                 start;
+	gint64                 first_row;
+	gint64                 loaded;
+	guint                  n_loaded;
+	gboolean               timed_out;
+
+	/* Rows to be changed by the status provider once loaded, and the
+	   ones changed so far */
+	guint                  n_statuses;
+	guint                  n_status_rows;
+	gint64                 statuses;
+
+	guint                  n_row_inserted;
+	guint                  n_rows_inserted;
+	guint                  n_row_deleted;
+	guint                  n_row_changed;
+	guint                  n_row_has_child_toggled;
+	guint                  n_rows_reordered;
+} Run;
+
+typedef GTypeModule      BenchmarkModule;
+typedef GTypeModuleClass BenchmarkModuleClass;
+
+GType benchmark_module_get_type (void);
+
+G_DEFINE_TYPE (BenchmarkModule, benchmark_module, G_TYPE_TYPE_MODULE)
+
+static gboolean
+benchmark_module_load (GTypeModule *module)
+{
+	return TRUE;
+}
+
+static void
+benchmark_module_unload (GTypeModule *module)
+{
+}
+
+static void
+benchmark_module_class_init (BenchmarkModuleClass *klass)
+{
+	klass->load = benchmark_module_load;
+	klass->unload = benchmark_module_unload;
+}
+
+static void
+benchmark_module_init (BenchmarkModule *module)
+{
+}
+
+/* What a plugin registers to filter the rows one by one, like the
+   messages of the add_filter method of the file browser expect */
+typedef struct
+{
+	GeditMessage parent;
+
+	gchar *id;
+	GFile *location;
+	gboolean is_directory;
+	gboolean filter;
+} FilterMessage;
+
+typedef GeditMessageClass FilterMessageClass;
+
+enum
+{
+	PROP_0,
+	PROP_ID,
+	PROP_LOCATION,
+	PROP_IS_DIRECTORY,
+	PROP_FILTER
+};
+
+GType filter_message_get_type (void);
+
+G_DEFINE_TYPE (FilterMessage, filter_message, GEDIT_TYPE_MESSAGE)
+
+static void
+filter_message_finalize (GObject *object)
+{
+	FilterMessage *message = (FilterMessage *)object;
+
+	g_free (message->id);
+	g_clear_object (&message->location);
+
+	G_OBJECT_CLASS (filter_message_parent_class)->finalize (object);
+}
+
+static void
+filter_message_get_property (GObject    *object,
+			     guint       prop_id,
+			     GValue     *value,
+			     GParamSpec *pspec)
+{
+	FilterMessage *message = (FilterMessage *)object;
+
+	switch (prop_id)
+	{
+		case PROP_ID:
+			g_value_set_string (value, message->id);
+			break;
+		case PROP_LOCATION:
+			g_value_set_object (value, message->location);
+			break;
+		case PROP_IS_DIRECTORY:
+			g_value_set_boolean (value, message->is_directory);
+			break;
+		case PROP_FILTER:
+			g_value_set_boolean (value, message->filter);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+filter_message_set_property (GObject      *object,
+			     guint         prop_id,
+			     const GValue *value,
+			     GParamSpec   *pspec)
+{
+	FilterMessage *message = (FilterMessage *)object;
+
+	switch (prop_id)
+	{
+		case PROP_ID:
+			g_free (message->id);
+			message->id = g_value_dup_string (value);
+			break;
+		case PROP_LOCATION:
+			g_clear_object (&message->location);
+			message->location = g_value_dup_object (value);
+			break;
+		case PROP_IS_DIRECTORY:
+			message->is_directory = g_value_get_boolean (value);
+			break;
+		case PROP_FILTER:
+			message->filter = g_value_get_boolean (value);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+filter_message_class_init (FilterMessageClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = filter_message_finalize;
+	object_class->get_property = filter_message_get_property;
+	object_class->set_property = filter_message_set_property;
+
+	g_object_class_install_property (object_class, PROP_ID,
+					 g_param_spec_string ("id", "Id", "Id",
+							      NULL,
+							      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property (object_class, PROP_LOCATION,
+					 g_param_spec_object ("location", "Location", "Location",
+							      G_TYPE_FILE,
+							      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property (object_class, PROP_IS_DIRECTORY,
+					 g_param_spec_boolean ("is-directory", "Is directory", "Is directory",
+							       FALSE,
+							       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property (object_class, PROP_FILTER,
+					 g_param_spec_boolean ("filter", "Filter", "Filter",
+							       FALSE,
+							       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+filter_message_init (FilterMessage *message)
+{
+}
+
+static gchar *scenario = NULL;
+static gint n_flat_files = 100000;
+
+static GOptionEntry options[] = {
+	{ "scenario", 's', 0, G_OPTION_ARG_STRING, &scenario,
+	  "Only run SCENARIO, in this process, memory-1m only runs this way", "SCENARIO" },
+	{ "files", 'n', 0, G_OPTION_ARG_INT, &n_flat_files,
+	  "Number of files of the flat tree", "N" },
+	{ NULL }
+};
+
+static gdouble
+msec (gint64 usec)
+{
+	return usec / 1000.0;
+}
+
+static glong
+peak_rss_kib (void)
+{
+	struct rusage usage;
+
+	getrusage (RUSAGE_SELF, &usage);
+
+	/* Linux reports kilobytes */
+	return usage.ru_maxrss;
+}
+
+static void
+create_file (const gchar *dir,
+	     const gchar *name,
+	     const gchar *contents,
+	     gsize        length)
+{
+	gchar *path = g_build_filename (dir, name, NULL);
+	gint fd = g_open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (fd == -1)
+		g_error ("Could not create %s", path);
+
+	if (length > 0 && write (fd, contents, length) != (gssize)length)
+		g_error ("Could not write %s", path);
+
+	close (fd);
+	g_free (path);
+}
+
+static void
+remove_tree (const gchar *path)
+{
+	GDir *dir = g_dir_open (path, 0, NULL);
+	const gchar *name;
+
+	while (dir != NULL && (name = g_dir_read_name (dir)) != NULL)
+	{
+		gchar *child = g_build_filename (path, name, NULL);
+
+		if (g_file_test (child, G_FILE_TEST_IS_DIR))
+			remove_tree (child);
+		else
+			g_remove (child);
+
+		g_free (child);
+	}
+
+	if (dir != NULL)
+		g_dir_close (dir);
+
+	g_rmdir (path);
+}
+
+/* Drops the contents of the files below path from the page cache, so
+   that the next read of them goes to the disk */
+static void
+evict_tree (const gchar *path)
+{
+	GDir *dir = g_dir_open (path, 0, NULL);
+	const gchar *name;
+
+	while (dir != NULL && (name = g_dir_read_name (dir)) != NULL)
+	{
+		gchar *child = g_build_filename (path, name, NULL);
+
+		if (g_file_test (child, G_FILE_TEST_IS_DIR))
+		{
+			evict_tree (child);
+		}
+		else
+		{
+			gint fd = g_open (child, O_RDONLY, 0);
+
+			if (fd != -1)
+			{
+				/* Dirty pages are not dropped */
+				fdatasync (fd);
+				posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED);
+				close (fd);
+			}
+		}
+
+		g_free (child);
+	}
+
+	if (dir != NULL)
+		g_dir_close (dir);
+}
+
+/* Lists path with a cold page cache, returns the time it took */
+static gint64
+time_cold_listing (const gchar *path,
+		   const gchar *attributes)
+{
+	GFile *file = g_file_new_for_path (path);
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+	gint64 start;
+
+	evict_tree (path);
+	start = g_get_monotonic_time ();
+
+	enumerator = g_file_enumerate_children (file, attributes, G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+	if (enumerator == NULL)
+		g_error ("Could not list %s", path);
+
+	while ((info = g_file_enumerator_next_file (enumerator, NULL, NULL)) != NULL)
+		g_object_unref (info);
+
+	g_object_unref (enumerator);
+	g_object_unref (file);
+
+	return g_get_monotonic_time () - start;
+}
+
+static void
+create_flat_tree (const gchar *root,
+		  guint        n_files)
+{
+	for (guint i = 0; i < n_files; ++i)
+	{
+		gchar name[32];
+
+		g_snprintf (name, sizeof (name), "file-%06u.txt", i);
+		create_file (root, name, NULL, 0);
+	}
+}
+
+/* Each level has files and the directory of the next level, returns
+   the locations of the directories below root */
+static GList *
+create_deep_tree (const gchar *root)
+{
+	gchar *dir = g_strdup (root);
+	GList *directories = NULL;
+
+	for (guint level = 0; level < DEEP_LEVELS; ++level)
+	{
+		gchar name[32];
+		gchar *next;
+
+		for (guint i = 0; i < DEEP_FILES_PER_LEVEL; ++i)
+		{
+			g_snprintf (name, sizeof (name), "file-%04u.c", i);
+			create_file (dir, name, NULL, 0);
+		}
+
+		g_snprintf (name, sizeof (name), "level-%02u", level);
+		next = g_build_filename (dir, name, NULL);
+		g_mkdir (next, 0755);
+
+		directories = g_list_prepend (directories, g_file_new_for_path (next));
+
+		g_free (dir);
+		dir = next;
+	}
+
+	g_free (dir);
+	return g_list_reverse (directories);
+}
+
+/* Text and binary files, with contents so that their type is the same
+   whether it is guessed from the name or from the data */
+static void
+create_mixed_tree (const gchar *root)
+{
+	static const gchar text[] = "int main (void) { return 0; }\n";
+	static const gchar binary[] = "\x7f" "ELF\0\0\0\0\0\0\0\0\0\0\0\0";
+	static const gchar *extensions[] = { "c", "o", "txt", "png", "h", "so" };
+
+	for (guint i = 0; i < MIXED_FILES; ++i)
+	{
+		guint kind = i % G_N_ELEMENTS (extensions);
+		gchar name[32];
+
+		g_snprintf (name, sizeof (name), "file-%05u.%s", i, extensions[kind]);
+
+		if (kind % 2 == 0)
+			create_file (root, name, text, sizeof (text) - 1);
+		else
+			create_file (root, name, binary, sizeof (binary) - 1);
+	}
+}
+
+/* Names which only sort right with a filename collation: mixed case,
+   numbers of different widths and accented letters */
+static GPtrArray *
+create_sort_tree (const gchar *root)
+{
+	static const gchar *formats[] = {
+		"File %u.txt", "file-%u.TXT", "r\xc3\xa9sum\xc3\xa9 %u.odt", "%u-notes.md"
+	};
+	GPtrArray *names = g_ptr_array_new_with_free_func (g_free);
+
+	for (guint i = 0; i < SORT_FILES; ++i)
+	{
+		gchar *name;
+
+		name = g_strdup_printf (formats[i % G_N_ELEMENTS (formats)], (i * 7919) % SORT_FILES);
+		create_file (root, name, NULL, 0);
+		g_ptr_array_add (names, name);
+	}
+
+	return names;
+}
+
+/* How collate_nodes used to compare names, building both keys each time */
+static gint
+compare_names_collating (gconstpointer a,
+			 gconstpointer b)
+{
+	gchar *key1 = g_utf8_collate_key_for_filename (*(const gchar **)a, -1);
+	gchar *key2 = g_utf8_collate_key_for_filename (*(const gchar **)b, -1);
+	gint result = strcmp (key1, key2);
+
+	g_free (key1);
+	g_free (key2);
+
+	return result;
+}
+
+static gint
+compare_keys (gconstpointer a,
+	      gconstpointer b)
+{
+	return strcmp (*(const gchar **)a, *(const gchar **)b);
+}
+
+static void
+on_row_inserted (GtkTreeModel *model,
+		 GtkTreePath  *path,
+		 GtkTreeIter  *iter,
+		 Run          *run)
+{
+	guint flags;
+
+	run->n_row_inserted++;
+
+	if (run->first_row != 0)
+		return;
+
+	gtk_tree_model_get (model, iter,
+			    GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS, &flags,
+			    -1);
+
+	if (!FILE_IS_DUMMY (flags))
+		run->first_row = g_get_monotonic_time ();
+}
+
+static void
+on_rows_inserted (GeditFileBrowserStore *model,
+		  GtkTreeIter           *parent,
+		  GtkTreeIter           *iters,
+		  guint                  n_iters,
+		  Run                   *run)
+{
+	run->n_rows_inserted++;
+
+	if (!run->expand)
+		return;
+
+	/* Like the view restoring its expanded rows */
+	for (guint i = 0; i < n_iters; ++i)
+	{
+		guint flags;
+
+		gtk_tree_model_get (GTK_TREE_MODEL (model), &iters[i],
+				    GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS, &flags,
+				    -1);
+
+		if (FILE_IS_DIR (flags))
+			_gedit_file_browser_store_iter_expanded (model, &iters[i]);
+	}
+}
+
+static void
+on_row_deleted (GtkTreeModel *model,
+		GtkTreePath  *path,
+		Run          *run)
+{
+	run->n_row_deleted++;
+}
+
+static void
+on_row_changed (GtkTreeModel *model,
+		GtkTreePath  *path,
+		GtkTreeIter  *iter,
+		Run          *run)
+{
+	run->n_row_changed++;
+
+	if (run->loaded != 0 && run->n_statuses != 0 &&
+	    ++run->n_status_rows == run->n_statuses)
+	{
+		run->statuses = g_get_monotonic_time ();
+		g_main_loop_quit (run->loop);
+	}
+}
+
+static void
+on_row_has_child_toggled (GtkTreeModel *model,
+			  GtkTreePath  *path,
+			  GtkTreeIter  *iter,
+			  Run          *run)
+{
+	run->n_row_has_child_toggled++;
+}
+
+static void
+on_rows_reordered (GtkTreeModel *model,
+		   GtkTreePath  *path,
+		   GtkTreeIter  *iter,
+		   gpointer      new_order,
+		   Run          *run)
+{
+	run->n_rows_reordered++;
+}
+
+static void
+on_virtual_root_changed (GeditFileBrowserStore *model,
+			 GParamSpec            *pspec,
+			 Run                   *run)
+{
+	if (run->prefetch != NULL)
+		gedit_file_browser_store_prefetch_directories (model, run->prefetch);
+}
+
+static void
+on_end_loading (GeditFileBrowserStore *model,
+		GtkTreeIter           *iter,
+		Run                   *run)
+{
+	if (++run->n_loaded == run->n_directories)
+	{
+		run->loaded = g_get_monotonic_time ();
+		g_main_loop_quit (run->loop);
+	}
+}
+
+static void
+on_error (GeditFileBrowserStore *model,
+	  guint                  code,
+	  gchar                 *message,
+	  Run                   *run)
+{
+	g_error ("Loading failed: %s", message);
+}
+
+static gboolean
+on_load_timeout (Run *run)
+{
+	run->timed_out = TRUE;
+	g_main_loop_quit (run->loop);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+run_init (Run                             *run,
+	  guint                            n_directories,
+	  GeditFileBrowserStoreFilterMode  filter_mode)
+{
+	memset (run, 0, sizeof (Run));
+
+	run->model = gedit_file_browser_store_new (NULL);
+	run->loop = g_main_loop_new (NULL, FALSE);
+	run->n_directories = n_directories;
+
+	gedit_file_browser_store_set_filter_mode (run->model, filter_mode);
+
+	g_signal_connect (run->model, "row-inserted", G_CALLBACK (on_row_inserted), run);
+	g_signal_connect (run->model, "rows-inserted", G_CALLBACK (on_rows_inserted), run);
+	g_signal_connect (run->model, "row-deleted", G_CALLBACK (on_row_deleted), run);
+	g_signal_connect (run->model, "row-changed", G_CALLBACK (on_row_changed), run);
+	g_signal_connect (run->model, "row-has-child-toggled", G_CALLBACK (on_row_has_child_toggled), run);
+	g_signal_connect (run->model, "rows-reordered", G_CALLBACK (on_rows_reordered), run);
+	g_signal_connect (run->model, "notify::virtual-root", G_CALLBACK (on_virtual_root_changed), run);
+	g_signal_connect (run->model, "end-loading", G_CALLBACK (on_end_loading), run);
+	g_signal_connect (run->model, "error", G_CALLBACK (on_error), run);
+}
+
+static void
+run_clear (Run *run)
+{
+	g_object_unref (run->model);
+	g_main_loop_unref (run->loop);
+	g_list_free_full (run->prefetch, g_object_unref);
+}
+
+static void
+run_load (Run         *run,
+	  const gchar *path)
+{
+	GFile *root = g_file_new_for_path (path);
+	guint timeout_id;
+
+	timeout_id = g_timeout_add_seconds (LOAD_TIMEOUT_SEC, (GSourceFunc)on_load_timeout, run);
+
+	run->start = g_get_monotonic_time ();
+	gedit_file_browser_store_set_root (run->model, root);
+
+	if (run->n_loaded < run->n_directories)
+		g_main_loop_run (run->loop);
+
+	if (run->timed_out)
+		g_error ("Loading did not finish in %d seconds", LOAD_TIMEOUT_SEC);
+
+	g_source_remove (timeout_id);
+	g_object_unref (root);
+}
+
+static void
+report_load (Run  *run,
+	     glong rss_before)
+{
+	glong rss = peak_rss_kib ();
+
+	g_print ("  %-28s %10.2f ms\n", "first row", msec (run->first_row - run->start));
+	g_print ("  %-28s %10.2f ms\n", "fully loaded", msec (run->loaded - run->start));
+	g_print ("  %-28s %10ld KiB\n", "peak RSS", rss);
+	g_print ("  %-28s %10ld KiB\n", "RSS growth while loading", rss - rss_before);
+	g_print ("  %-28s %10u\n", "row-inserted", run->n_row_inserted);
+	g_print ("  %-28s %10u\n", "rows-inserted", run->n_rows_inserted);
+	g_print ("  %-28s %10u\n", "row-deleted", run->n_row_deleted);
+	g_print ("  %-28s %10u\n", "row-changed", run->n_row_changed);
+	g_print ("  %-28s %10u\n", "row-has-child-toggled", run->n_row_has_child_toggled);
+	g_print ("  %-28s %10u\n", "rows-reordered", run->n_rows_reordered);
+}
+
+static void
+report_refilter (Run         *run,
+		 const gchar *label,
+		 const gchar *pattern)
+{
+	gint64 start = g_get_monotonic_time ();
+
+	gedit_file_browser_store_set_filter_pattern (run->model, pattern);
+	g_print ("  %-28s %10.2f ms\n", label, msec (g_get_monotonic_time () - start));
+}
+
+static void
+report_refilter_all (Run *run)
+{
+	gint64 start = g_get_monotonic_time ();
+
+	gedit_file_browser_store_refilter (run->model);
+	g_print ("  %-28s %10.2f ms\n", "refilter", msec (g_get_monotonic_time () - start));
+}
+
+static void
+run_flat (const gchar *path)
+{
+	glong rss_before;
+	Run run;
+
+	create_flat_tree (path, n_flat_files);
+	g_print ("flat (%d files)\n", n_flat_files);
+
+	run_init (&run, 1, GEDIT_FILE_BROWSER_STORE_FILTER_MODE_HIDE_HIDDEN);
+	rss_before = peak_rss_kib ();
+
+	run_load (&run, path);
+	report_load (&run, rss_before);
+
+	report_refilter (&run, "filter pattern", "file-0*");
+	report_refilter (&run, "narrowed filter pattern", "file-00*");
+	report_refilter (&run, "cleared filter pattern", NULL);
+	report_refilter_all (&run);
+
+	run_clear (&run);
+}
+
+/* Sorts the names of a large directory the way the store used to and
+   the way it does now, then loads the directory */
+static void
+run_sort (const gchar *path)
+{
+	GPtrArray *names = create_sort_tree (path);
+	GPtrArray *sorted;
+	GPtrArray *keys;
+	glong rss_before;
+	gint64 start;
+	Run run;
+
+	g_print ("sort (%d files)\n", SORT_FILES);
+
+	sorted = g_ptr_array_sized_new (names->len);
+
+	for (guint i = 0; i < names->len; ++i)
+		g_ptr_array_add (sorted, g_ptr_array_index (names, i));
+
+	start = g_get_monotonic_time ();
+	g_ptr_array_sort (sorted, compare_names_collating);
+	g_print ("  %-28s %10.2f ms\n", "collating each compare",
+		 msec (g_get_monotonic_time () - start));
+
+	keys = g_ptr_array_new_full (names->len, g_free);
+	start = g_get_monotonic_time ();
+
+	for (guint i = 0; i < names->len; ++i)
+		g_ptr_array_add (keys, g_utf8_collate_key_for_filename (g_ptr_array_index (names, i), -1));
+
+	g_ptr_array_sort (keys, compare_keys);
+	g_print ("  %-28s %10.2f ms\n", "precomputed keys",
+		 msec (g_get_monotonic_time () - start));
+
+	run_init (&run, 1, GEDIT_FILE_BROWSER_STORE_FILTER_MODE_NONE);
+	rss_before = peak_rss_kib ();
+
+	run_load (&run, path);
+	report_load (&run, rss_before);
+
+	run_clear (&run);
+	g_ptr_array_unref (keys);
+	g_ptr_array_unref (sorted);
+	g_ptr_array_unref (names);
+}
+
+/* Loads a directory of n_files files and reports what each node of the
+   store takes, from the growth of the peak RSS while loading */
+static void
+run_memory (const gchar *path,
+	    guint        n_files)
+{
+	glong rss_before;
+	glong rss_growth;
+	Run run;
+
+	create_flat_tree (path, n_files);
+	g_print ("memory (%u nodes)\n", n_files);
+
+	run_init (&run, 1, GEDIT_FILE_BROWSER_STORE_FILTER_MODE_NONE);
+	rss_before = peak_rss_kib ();
+
+	run_load (&run, path);
+	report_load (&run, rss_before);
+
+	rss_growth = peak_rss_kib () - rss_before;
+	g_print ("  %-28s %10.1f bytes\n", "RSS growth per node",
+		 rss_growth * 1024.0 / n_files);
+
+	run_clear (&run);
+}
+
+static void
+run_deep (const gchar *path,
+	  gboolean     prefetch)
+{
+	glong rss_before;
+	Run run;
+
+	g_print ("deep (%d levels of %d files%s)\n",
+		 DEEP_LEVELS, DEEP_FILES_PER_LEVEL,
+		 prefetch ? ", prefetched" : "");
+
+	run_init (&run, DEEP_LEVELS + 1, GEDIT_FILE_BROWSER_STORE_FILTER_MODE_HIDE_HIDDEN);
+
+	/* Either each level is expanded when its row comes in, or all of
+	   them are handed to the store up front */
+	if (prefetch)
+		run.prefetch = create_deep_tree (path);
+	else
+		g_list_free_full (create_deep_tree (path), g_object_unref);
+
+	run.expand = !prefetch;
+	rss_before = peak_rss_kib ();
+
+	run_load (&run, path);
+	report_load (&run, rss_before);
+
+	run_clear (&run);
+}
+
+static void
+run_mixed (const gchar *path)
+{
+	const gchar *binary_patterns[] = { "*.o", "*.so", NULL };
+	glong rss_before;
+	gint64 start;
+	Run run;
+
+	create_mixed_tree (path);
+	g_print ("mixed (%d text and binary files)\n", MIXED_FILES);
+
+	/* Listing the directory is where sniffing the files costs the most */
+	g_print ("  %-28s %10.2f ms\n", "cold listing, sniffed types",
+		 msec (time_cold_listing (path, SNIFFED_ATTRIBUTE_TYPES)));
+	g_print ("  %-28s %10.2f ms\n", "cold listing, guessed types",
+		 msec (time_cold_listing (path, GUESSED_ATTRIBUTE_TYPES)));
+
+	run_init (&run, 1, GEDIT_FILE_BROWSER_STORE_FILTER_MODE_HIDE_BINARY);
+	gedit_file_browser_store_set_binary_patterns (run.model, binary_patterns);
+	rss_before = peak_rss_kib ();
+
+	evict_tree (path);
+	run_load (&run, path);
+	report_load (&run, rss_before);
+
+	start = g_get_monotonic_time ();
+	gedit_file_browser_store_set_filter_mode (run.model, GEDIT_FILE_BROWSER_STORE_FILTER_MODE_NONE);
+	g_print ("  %-28s %10.2f ms\n", "show binary files", msec (g_get_monotonic_time () - start));
+
+	start = g_get_monotonic_time ();
+	gedit_file_browser_store_set_filter_mode (run.model, GEDIT_FILE_BROWSER_STORE_FILTER_MODE_HIDE_BINARY);
+	g_print ("  %-28s %10.2f ms\n", "hide binary files", msec (g_get_monotonic_time () - start));
+
+	report_refilter (&run, "filter pattern", "*.c");
+	report_refilter (&run, "cleared filter pattern", NULL);
+	report_refilter_all (&run);
+
+	run_clear (&run);
+}
+
+static void
+run_git (const gchar *path,
+	 const gchar *command,
+	 ...)
+{
+	GPtrArray *argv = g_ptr_array_new ();
+	GError *error = NULL;
+	const gchar *arg;
+	gint status;
+	va_list args;
+
+	/* Independent of the configuration of the user */
+	g_ptr_array_add (argv, (gchar *)"git");
+	g_ptr_array_add (argv, (gchar *)"-C");
+	g_ptr_array_add (argv, (gchar *)path);
+	g_ptr_array_add (argv, (gchar *)"-c");
+	g_ptr_array_add (argv, (gchar *)"user.name=Benchmark");
+	g_ptr_array_add (argv, (gchar *)"-c");
+	g_ptr_array_add (argv, (gchar *)"user.email=benchmark@example.com");
+	g_ptr_array_add (argv, (gchar *)"-c");
+	g_ptr_array_add (argv, (gchar *)"commit.gpgsign=false");
+	g_ptr_array_add (argv, (gchar *)command);
+
+	va_start (args, command);
+
+	while ((arg = va_arg (args, const gchar *)) != NULL)
+		g_ptr_array_add (argv, (gchar *)arg);
+
+	va_end (args);
+	g_ptr_array_add (argv, NULL);
+
+	if (!g_spawn_sync (NULL, (gchar **)argv->pdata, NULL,
+			   G_SPAWN_SEARCH_PATH | G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL,
+			   NULL, NULL, NULL, NULL, &status, &error) ||
+	    !g_spawn_check_exit_status (status, &error))
+	{
+		g_error ("git %s failed: %s", command, error->message);
+	}
+
+	g_ptr_array_free (argv, TRUE);
+}
+
+/* A throwaway repository with modified and untracked files, and a
+   directory with a modified file in it. Returns the number of rows
+   which get a status */
+static guint
+create_git_tree (const gchar *root)
+{
+	static const gchar original[] = "original\n";
+	static const gchar modified[] = "modified\n";
+	gchar *sub = g_build_filename (root, "src", NULL);
+	guint n_statuses = 0;
+
+	g_mkdir (sub, 0755);
+	create_file (sub, "main.c", original, sizeof (original) - 1);
+
+	for (guint i = 0; i < GIT_FILES; ++i)
+	{
+		gchar name[32];
+
+		g_snprintf (name, sizeof (name), "file-%05u.txt", i);
+		create_file (root, name, original, sizeof (original) - 1);
+	}
+
+	run_git (root, "init", "--quiet", NULL);
+	run_git (root, "add", "--all", NULL);
+	run_git (root, "commit", "--quiet", "--message", "Initial commit", NULL);
+
+	for (guint i = 0; i < GIT_FILES; i += GIT_MODIFIED_EVERY)
+	{
+		gchar name[32];
+
+		g_snprintf (name, sizeof (name), "file-%05u.txt", i);
+		create_file (root, name, modified, sizeof (modified) - 1);
+		++n_statuses;
+	}
+
+	for (guint i = 0; i < GIT_UNTRACKED_FILES; ++i)
+	{
+		gchar name[32];
+
+		g_snprintf (name, sizeof (name), "new-%05u.txt", i);
+		create_file (root, name, original, sizeof (original) - 1);
+		++n_statuses;
+	}
+
+	create_file (sub, "main.c", modified, sizeof (modified) - 1);
+	++n_statuses;
+
+	g_free (sub);
+	return n_statuses;
+}
+
+/* Statuses of a whole directory come in one query and one pass over
+   its rows, with a row changed for each file that has a status */
+static void
+run_git_statuses (const gchar *path)
+{
+	GeditFileBrowserStatusProvider *provider;
+	gchar *git = g_find_program_in_path ("git");
+	guint timeout_id;
+	glong rss_before;
+	Run run;
+
+	if (git == NULL)
+	{
+		g_print ("git (skipped, git is not installed)\n");
+		return;
+	}
+
+	g_print ("git (%d files, %d modified, %d untracked)\n",
+		 GIT_FILES, GIT_FILES / GIT_MODIFIED_EVERY, GIT_UNTRACKED_FILES);
+
+	run_init (&run, 1, GEDIT_FILE_BROWSER_STORE_FILTER_MODE_HIDE_HIDDEN);
+	run.n_statuses = create_git_tree (path);
+
+	provider = gedit_file_browser_git_status_provider_new ();
+	gedit_file_browser_store_set_status_provider (run.model, provider);
+	rss_before = peak_rss_kib ();
+
+	run_load (&run, path);
+
+	if (run.statuses == 0)
+	{
+		timeout_id = g_timeout_add_seconds (LOAD_TIMEOUT_SEC, (GSourceFunc)on_load_timeout, &run);
+		g_main_loop_run (run.loop);
+
+		if (run.timed_out)
+			g_error ("Only %u of %u statuses came in", run.n_status_rows, run.n_statuses);
+
+		g_source_remove (timeout_id);
+	}
+
+	report_load (&run, rss_before);
+	g_print ("  %-28s %10.2f ms\n", "statuses after loading", msec (run.statuses - run.loaded));
+
+	run_clear (&run);
+	g_object_unref (provider);
+	g_free (git);
+}
+
+static void
+on_bus_message (GeditMessageBus *bus,
+		GeditMessage    *message,
+		guint           *count)
+{
+	++*count;
+}
+
+/* What a listener of the file browser messages costs when the rows are
+   announced one by one, and when they come in batches */
+static void
+run_bus (void)
+{
+	GeditMessageBus *bus = gedit_message_bus_new ();
+	guint n_rows = n_flat_files;
+	GeditMessage *message;
+	GeditMessage *batch;
+	gchar **ids = g_new0 (gchar *, n_rows + 1);
+	gchar **uris = g_new0 (gchar *, n_rows + 1);
+	GFile **files = g_new0 (GFile *, n_rows);
+	guint8 directories[(BATCH_SIZE + 7) / 8] = { 0 };
+	guint n_rows_received = 0;
+	guint n_batches_received = 0;
+	gint64 start;
+
+	g_print ("bus (%u rows)\n", n_rows);
+
+	gedit_message_bus_register (bus, GEDIT_TYPE_FILE_BROWSER_MESSAGE_ID_LOCATION,
+				    MESSAGE_OBJECT_PATH, "inserted");
+	gedit_message_bus_register (bus, GEDIT_TYPE_FILE_BROWSER_MESSAGE_ROWS,
+				    MESSAGE_OBJECT_PATH, "inserted_batch");
+
+	gedit_message_bus_connect (bus, MESSAGE_OBJECT_PATH, "inserted",
+				   (GeditMessageCallback)on_bus_message, &n_rows_received, NULL);
+	gedit_message_bus_connect (bus, MESSAGE_OBJECT_PATH, "inserted_batch",
+				   (GeditMessageCallback)on_bus_message, &n_batches_received, NULL);
+
+	message = g_object_new (GEDIT_TYPE_FILE_BROWSER_MESSAGE_ID_LOCATION,
+				"object-path", MESSAGE_OBJECT_PATH,
+				"method", "inserted",
+				NULL);
+
+	batch = g_object_new (GEDIT_TYPE_FILE_BROWSER_MESSAGE_ROWS,
+			      "object-path", MESSAGE_OBJECT_PATH,
+			      "method", "inserted_batch",
+			      NULL);
+
+	for (guint i = 0; i < n_rows; ++i)
+	{
+		gchar *path = g_strdup_printf ("/tmp/file-%06u.txt", i);
+
+		ids[i] = g_strdup_printf ("%u", i);
+		files[i] = g_file_new_for_path (path);
+		uris[i] = g_file_get_uri (files[i]);
+
+		g_free (path);
+	}
+
+	start = g_get_monotonic_time ();
+
+	for (guint i = 0; i < n_rows; ++i)
+	{
+		g_object_set (message,
+			      "id", ids[i],
+			      "location", files[i],
+			      "is-directory", FALSE,
+			      NULL);
+
+		gedit_message_bus_send_message_sync (bus, message);
+	}
+
+	g_print ("  %-28s %10.2f ms\n", "one message per row", msec (g_get_monotonic_time () - start));
+
+	start = g_get_monotonic_time ();
+
+	for (guint i = 0; i < n_rows; i += BATCH_SIZE)
+	{
+		guint n = MIN (BATCH_SIZE, n_rows - i);
+		gchar *batch_ids[BATCH_SIZE + 1];
+		gchar *batch_uris[BATCH_SIZE + 1];
+		GBytes *bytes;
+
+		memcpy (batch_ids, ids + i, n * sizeof (gchar *));
+		memcpy (batch_uris, uris + i, n * sizeof (gchar *));
+		batch_ids[n] = NULL;
+		batch_uris[n] = NULL;
+
+		bytes = g_bytes_new (directories, (n + 7) / 8);
+
+		g_object_set (batch,
+			      "ids", batch_ids,
+			      "uris", batch_uris,
+			      "directories", bytes,
+			      NULL);
+
+		gedit_message_bus_send_message_sync (bus, batch);
+		g_bytes_unref (bytes);
+	}
+
+	g_print ("  %-28s %10.2f ms\n", "one message per batch", msec (g_get_monotonic_time () - start));
+	g_print ("  %-28s %10u\n", "row messages received", n_rows_received);
+	g_print ("  %-28s %10u\n", "batch messages received", n_batches_received);
+
+	for (guint i = 0; i < n_rows; ++i)
+		g_object_unref (files[i]);
+
+	g_free (files);
+	g_strfreev (ids);
+	g_strfreev (uris);
+	g_object_unref (message);
+	g_object_unref (batch);
+	g_object_unref (bus);
+}
+
+/* The bus and the messages the filters send on it, along with what
+   their listener got */
+typedef struct
+{
+	GeditMessageBus *bus;
+	GeditMessage    *message;
+	guint            n_messages;
+	guint            n_rows;
+} BusFilter;
+
+/* The listener hides the files whose number is odd */
+static gboolean
+is_filtered_name (const gchar *name)
+{
+	gsize length = strlen (name);
+
+	return length > 4 &&
+	       g_str_has_suffix (name, ".txt") &&
+	       (name[length - 5] - '0') % 2 == 1;
+}
+
+static void
+on_filter_message (GeditMessageBus *bus,
+		   FilterMessage   *message,
+		   BusFilter       *filter)
+{
+	gchar *name = g_file_get_basename (message->location);
+
+	filter->n_messages++;
+	filter->n_rows++;
+	message->filter = is_filtered_name (name);
+
+	g_free (name);
+}
+
+static void
+on_batch_filter_message (GeditMessageBus *bus,
+			 GeditMessage    *message,
+			 BusFilter       *filter)
+{
+	gchar **uris = NULL;
+	guint8 *filtered;
+	guint n_uris;
+	GBytes *bytes;
+
+	g_object_get (message, "uris", &uris, NULL);
+	n_uris = g_strv_length (uris);
+	filtered = g_new0 (guint8, (n_uris + 7) / 8);
+
+	for (guint i = 0; i < n_uris; ++i)
+	{
+		if (is_filtered_name (uris[i]))
+			filtered[i / 8] |= 1 << (i % 8);
+	}
+
+	bytes = g_bytes_new_take (filtered, (n_uris + 7) / 8);
+	g_object_set (message, "filtered", bytes, NULL);
+
+	filter->n_messages++;
+	filter->n_rows += n_uris;
+
+	g_bytes_unref (bytes);
+	g_strfreev (uris);
+}
+
+/* Sends a message for the row, as the add_filter method of the file
+   browser does */
+static gboolean
+bus_filter_func (GeditFileBrowserStore *model,
+		 GtkTreeIter           *iter,
+		 BusFilter             *filter)
+{
+	GFile *location;
+	GtkTreePath *path;
+	gchar *id;
+	guint flags = 0;
+	gboolean filtered = FALSE;
+
+	gtk_tree_model_get (GTK_TREE_MODEL (model), iter,
+			    GEDIT_FILE_BROWSER_STORE_COLUMN_LOCATION, &location,
+			    GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS, &flags,
+			    -1);
+
+	if (location == NULL || FILE_IS_DUMMY (flags))
+	{
+		g_clear_object (&location);
+		return TRUE;
+	}
+
+	path = gtk_tree_model_get_path (GTK_TREE_MODEL (model), iter);
+	id = gtk_tree_path_to_string (path);
+
+	g_object_set (filter->message,
+		      "id", id,
+		      "location", location,
+		      "is-directory", FILE_IS_DIR (flags),
+		      "filter", FALSE,
+		      NULL);
+
+	gedit_message_bus_send_message_sync (filter->bus, filter->message);
+	g_object_get (filter->message, "filter", &filtered, NULL);
+
+	g_free (id);
+	gtk_tree_path_free (path);
+	g_object_unref (location);
+
+	return !filtered;
+}
+
+/* Sends one message for all the rows, as the add_batch_filter method of
+   the file browser does */
+static void
+bus_batch_filter_func (GeditFileBrowserStore *model,
+		       GtkTreeIter           *iters,
+		       guint                  n_iters,
+		       guint8                *filtered,
+		       BusFilter             *filter)
+{
+	GPtrArray *uris = g_ptr_array_new_full (n_iters + 1, g_free);
+	guint *rows = g_new (guint, n_iters);
+	guint8 *directories = g_new0 (guint8, (n_iters + 7) / 8);
+	GBytes *result = NULL;
+	GBytes *bytes;
+
+	for (guint i = 0; i < n_iters; ++i)
+	{
+		GFile *location;
+		guint flags = 0;
+
+		gtk_tree_model_get (GTK_TREE_MODEL (model), &iters[i],
+				    GEDIT_FILE_BROWSER_STORE_COLUMN_LOCATION, &location,
+				    GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS, &flags,
+				    -1);
+
+		if (location != NULL && !FILE_IS_DUMMY (flags))
+		{
+			if (FILE_IS_DIR (flags))
+				directories[uris->len / 8] |= 1 << (uris->len % 8);
+
+			rows[uris->len] = i;
+			g_ptr_array_add (uris, g_file_get_uri (location));
+		}
+
+		g_clear_object (&location);
+	}
+
+	if (uris->len > 0)
+	{
+		guint n_rows = uris->len;
+		const guint8 *bits;
+		gsize size = 0;
+
+		g_ptr_array_add (uris, NULL);
+		bytes = g_bytes_new (directories, (n_rows + 7) / 8);
+
+		g_object_set (filter->message,
+			      "uris", uris->pdata,
+			      "directories", bytes,
+			      "filtered", NULL,
+			      NULL);
+
+		gedit_message_bus_send_message_sync (filter->bus, filter->message);
+		g_object_get (filter->message, "filtered", &result, NULL);
+
+		bits = result != NULL ? g_bytes_get_data (result, &size) : NULL;
+
+		for (guint row = 0; row < n_rows; ++row)
+		{
+			if (row / 8 < size && (bits[row / 8] & (1 << (row % 8))))
+				filtered[rows[row] / 8] |= 1 << (rows[row] % 8);
+		}
+
+		if (result != NULL)
+			g_bytes_unref (result);
+
+		g_bytes_unref (bytes);
+	}
+
+	g_ptr_array_unref (uris);
+	g_free (directories);
+	g_free (rows);
+}
+
+static void
+run_filter_one (const gchar *path,
+		gboolean     batch)
+{
+	const gchar *label = batch ? "batch filter" : "per-row filter";
+	BusFilter filter = { NULL };
+	gint64 start;
+	gchar *line;
+	Run run;
+
+	filter.bus = gedit_message_bus_new ();
+
+	if (batch)
+	{
+		gedit_message_bus_register (filter.bus, GEDIT_TYPE_FILE_BROWSER_MESSAGE_ROWS,
+					    MESSAGE_OBJECT_PATH, "filter_batch");
+		gedit_message_bus_connect (filter.bus, MESSAGE_OBJECT_PATH, "filter_batch",
+					   (GeditMessageCallback)on_batch_filter_message, &filter, NULL);
+
+		filter.message = g_object_new (GEDIT_TYPE_FILE_BROWSER_MESSAGE_ROWS,
+					       "object-path", MESSAGE_OBJECT_PATH,
+					       "method", "filter_batch",
+					       NULL);
+	}
+	else
+	{
+		gedit_message_bus_register (filter.bus, filter_message_get_type (),
+					    MESSAGE_OBJECT_PATH, "filter");
+		gedit_message_bus_connect (filter.bus, MESSAGE_OBJECT_PATH, "filter",
+					   (GeditMessageCallback)on_filter_message, &filter, NULL);
+
+		filter.message = g_object_new (filter_message_get_type (),
+					       "object-path", MESSAGE_OBJECT_PATH,
+					       "method", "filter",
+					       NULL);
+	}
+
+	run_init (&run, 1, GEDIT_FILE_BROWSER_STORE_FILTER_MODE_NONE);
+
+	if (batch)
+	{
+		gedit_file_browser_store_set_batch_filter_func (run.model,
+								(GeditFileBrowserStoreBatchFilterFunc)bus_batch_filter_func,
+								&filter);
+	}
+	else
+	{
+		gedit_file_browser_store_set_filter_func (run.model,
+							  (GeditFileBrowserStoreFilterFunc)bus_filter_func,
+							  &filter);
+	}
+
+	run_load (&run, path);
+
+	line = g_strdup_printf ("%s, loaded", label);
+	g_print ("  %-28s %10.2f ms\n", line, msec (run.loaded - run.start));
+	g_free (line);
+
+	start = g_get_monotonic_time ();
+	gedit_file_browser_store_refilter (run.model);
+
+	line = g_strdup_printf ("%s, refilter", label);
+	g_print ("  %-28s %10.2f ms\n", line, msec (g_get_monotonic_time () - start));
+	g_free (line);
+
+	line = g_strdup_printf ("%s, messages", label);
+	g_print ("  %-28s %10u\n", line, filter.n_messages);
+	g_free (line);
+
+	line = g_strdup_printf ("%s, rows shown", label);
+	g_print ("  %-28s %10d\n", line,
+		 gtk_tree_model_iter_n_children (GTK_TREE_MODEL (run.model), NULL));
+	g_free (line);
+
+	run_clear (&run);
+	g_object_unref (filter.message);
+	g_object_unref (filter.bus);
+}
+
+/* What a plugin filtering the rows over the bus costs when it gets a
+   message for each row, and when it gets them in batches */
+static void
+run_filter (const gchar *path)
+{
+	create_flat_tree (path, n_flat_files);
+	g_print ("filter (%d files)\n", n_flat_files);
+
+	run_filter_one (path, FALSE);
+	run_filter_one (path, TRUE);
+}
+
+static void
+run_scenario (const gchar *name)
+{
+	GTypeModule *module;
+	GError *error = NULL;
+	gchar *tmp;
+	gchar *cache;
+	gchar *root;
+
+	tmp = g_dir_make_tmp ("gedit-file-browser-benchmark-XXXXXX", &error);
+
+	if (tmp == NULL)
+		g_error ("Could not create the temporary directory: %s", error->message);
+
+	/* Start without any snapshot of the directories */
+	cache = g_build_filename (tmp, "cache", NULL);
+	g_setenv ("XDG_CACHE_HOME", cache, TRUE);
+
+	root = g_build_filename (tmp, "root", NULL);
+	g_mkdir (root, 0755);
+
+	module = g_object_new (benchmark_module_get_type (), NULL);
+	g_type_module_use (module);
+
+	gedit_file_browser_enum_and_flag_register_type (module);
+	_gedit_file_browser_store_register_type (module);
+	_gedit_file_browser_status_provider_register_type (module);
+	_gedit_file_browser_git_status_provider_register_type (module);
+
+	if (g_strcmp0 (name, "flat") == 0)
+		run_flat (root);
+	else if (g_strcmp0 (name, "sort") == 0)
+		run_sort (root);
+	else if (g_strcmp0 (name, "memory-100k") == 0)
+		run_memory (root, MEMORY_SMALL_FILES);
+	else if (g_strcmp0 (name, "memory-1m") == 0)
+		run_memory (root, MEMORY_LARGE_FILES);
+	else if (g_strcmp0 (name, "deep") == 0)
+		run_deep (root, FALSE);
+	else if (g_strcmp0 (name, "deep-prefetch") == 0)
+		run_deep (root, TRUE);
+	else if (g_strcmp0 (name, "mixed") == 0)
+		run_mixed (root);
+	else if (g_strcmp0 (name, "bus") == 0)
+		run_bus ();
+	else if (g_strcmp0 (name, "filter") == 0)
+		run_filter (root);
+	else if (g_strcmp0 (name, "git") == 0)
+		run_git_statuses (root);
+	else
+		g_error ("Unknown scenario %s", name);
+
+	remove_tree (tmp);
+
+	g_free (root);
+	g_free (cache);
+	g_free (tmp);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+	/* The ones taking minutes, such as memory-1m, only run when asked
+	   for with --scenario */
+	static const gchar *scenarios[] = {
+		"flat", "sort", "memory-100k", "deep", "deep-prefetch",
+		"mixed", "bus", "filter", "git"
+	};
+	GOptionContext *context;
+	GError *error = NULL;
+	gboolean failed = FALSE;
+
+	context = g_option_context_new ("- benchmark the file browser store");
+	g_option_context_add_main_entries (context, options, NULL);
+
+	if (!g_option_context_parse (context, &argc, &argv, &error))
+	{
+		g_printerr ("%s\n", error->message);
+		return 1;
+	}
+
+	g_option_context_free (context);
+
+	if (scenario != NULL)
+	{
+		run_scenario (scenario);
+		return 0;
+	}
+
+	for (guint i = 0; i < G_N_ELEMENTS (scenarios); ++i)
+	{
+		gchar *files = g_strdup_printf ("%d", n_flat_files);
+		gchar *child_argv[] = {
+			argv[0], (gchar *)"--scenario", (gchar *)scenarios[i],
+			(gchar *)"--files", files, NULL
+		};
+		gint status;
+
+		if (!g_spawn_sync (NULL, child_argv, NULL, G_SPAWN_DEFAULT,
+				   NULL, NULL, NULL, NULL, &status, &error) ||
+		    !g_spawn_check_exit_status (status, &error))
+		{
+			g_printerr ("Scenario %s failed: %s\n", scenarios[i], error->message);
+			g_clear_error (&error);
+			failed = TRUE;
+		}
+
+		g_free (files);
+	}
+
+	return failed ? 1 : 0;
+}
+
+/* ex:set ts=8 noet: */
@@ -26,12 +26,50 @@
 #include "gedit-file-bookmarks-store.h"
 #include "gedit-file-browser-utils.h"
 
+/* Files on a stale network mount or a slow device can block for a long
+   time. When checking them takes longer than this, the rows are shown
+   without waiting for the rest */
+#define FILE_PROBE_TIMEOUT_MSEC 2000
+
 struct _GeditFileBookmarksStorePrivate
 {
 	GVolumeMonitor *volume_monitor;
 	GFileMonitor   *bookmarks_monitor;
+
+	/* Loads of the special directories and of the bookmarks file */
+	GCancellable   *special_dirs_cancellable;
+	GCancellable   *bookmarks_cancellable;
+
+	/* Volume monitor events are applied together from an idle */
+	guint           update_fs_id;
 };
 
+/* A file to show, checked in a thread before it is added */
+typedef struct
+{
+	GFile    *file;
+	gchar    *name;
+	guint     flags;
+
+	/* Set by the probing thread, valid once probed is set */
+	gchar    *display_name;
+	gchar    *icon_name;
+	gboolean  exists;
+	gint      probed;
+} FileEntry;
+
+typedef struct
+{
+	GeditFileBookmarksStore *model;
+	gboolean                 is_bookmarks;
+	guint                    timeout_id;
+
+	/* FileEntry to check, read from the bookmarks file by the thread
+	   when is_bookmarks is set */
+	GPtrArray               *entries;
+	gchar                   *bookmarks;
+} FileProbe;
+
 static void remove_node               (GtkTreeModel            *model,
                                        GtkTreeIter             *iter);
 
@@ -49,6 +87,7 @@ static gboolean find_with_flags       (GtkTreeModel            *model,
                                        gpointer                 obj,
                                        guint                    flags,
                                        guint                    notflags);
+static void remove_bookmarks          (GeditFileBookmarksStore *model);
 
 G_DEFINE_DYNAMIC_TYPE_EXTENDED (GeditFileBookmarksStore,
 				gedit_file_bookmarks_store,
@@ -56,6 +95,16 @@ G_DEFINE_DYNAMIC_TYPE_EXTENDED (GeditFileBookmarksStore,
 				0,
 				G_ADD_PRIVATE_DYNAMIC (GeditFileBookmarksStore))
 
+static void
+cancel_load (GCancellable **cancellable)
+{
+	if (*cancellable != NULL)
+	{
+		g_cancellable_cancel (*cancellable);
+		g_clear_object (cancellable);
+	}
+}
+
 static void
 gedit_file_bookmarks_store_dispose (GObject *object)
 {
@@ -73,6 +122,15 @@ gedit_file_bookmarks_store_dispose (GObject *object)
 
 	g_clear_object (&obj->priv->bookmarks_monitor);
 
+	cancel_load (&obj->priv->special_dirs_cancellable);
+	cancel_load (&obj->priv->bookmarks_cancellable);
+
+	if (obj->priv->update_fs_id != 0)
+	{
+		g_source_remove (obj->priv->update_fs_id);
+		obj->priv->update_fs_id = 0;
+	}
+
 	G_OBJECT_CLASS (gedit_file_bookmarks_store_parent_class)->dispose (object);
 }
 
@@ -121,44 +179,88 @@ add_node (GeditFileBookmarksStore *model,
 		*iter = newiter;
 }
 
-static gboolean
-add_file (GeditFileBookmarksStore *model,
-	  GFile                   *file,
-	  const gchar             *name,
-	  guint                    flags,
-	  GtkTreeIter             *iter)
+static FileEntry *
+file_entry_new (GFile       *file,
+		const gchar *name,
+		guint        flags)
 {
-	gboolean native = g_file_is_native (file);
-	gchar *icon_name = NULL;
-	gchar *newname;
+	FileEntry *entry = g_slice_new0 (FileEntry);
 
-	if (native && !g_file_query_exists (file, NULL))
-		return FALSE;
+	entry->file = g_object_ref (file);
+	entry->name = g_strdup (name);
+	entry->flags = flags;
 
-	if (flags & GEDIT_FILE_BOOKMARKS_STORE_IS_HOME)
-		icon_name = g_strdup ("user-home-symbolic");
-	else if (flags & GEDIT_FILE_BOOKMARKS_STORE_IS_DESKTOP)
-		icon_name = g_strdup ("user-desktop-symbolic");
-	else if (flags & GEDIT_FILE_BOOKMARKS_STORE_IS_ROOT)
-		icon_name = g_strdup ("drive-harddisk-symbolic");
-	else
+	return entry;
+}
+
+static void
+file_entry_free (FileEntry *entry)
+{
+	g_object_unref (entry->file);
+	g_free (entry->name);
+	g_free (entry->display_name);
+	g_free (entry->icon_name);
+	g_slice_free (FileEntry, entry);
+}
+
+/* Runs in a thread, does the blocking calls add_file_entry needs */
+static void
+file_entry_probe (FileEntry    *entry,
+		  GCancellable *cancellable)
+{
+	gboolean native = g_file_is_native (entry->file);
+	guint special = GEDIT_FILE_BOOKMARKS_STORE_IS_HOME |
+			GEDIT_FILE_BOOKMARKS_STORE_IS_DESKTOP |
+			GEDIT_FILE_BOOKMARKS_STORE_IS_ROOT;
+
+	entry->exists = !native || g_file_query_exists (entry->file, cancellable);
+
+	if (entry->exists)
 	{
+		if (entry->name == NULL)
+			entry->display_name = gedit_file_browser_utils_file_basename (entry->file);
+
 		/* getting the icon is a sync get_info call, so we just do it for local files */
-		if (native)
-			icon_name = gedit_file_browser_utils_symbolic_icon_name_from_file (file);
-		else
-			icon_name = g_strdup ("folder-symbolic");
+		if (native && !(entry->flags & special))
+			entry->icon_name = gedit_file_browser_utils_symbolic_icon_name_from_file (entry->file);
 	}
 
-	if (name == NULL)
-		newname = gedit_file_browser_utils_file_basename (file);
+	g_atomic_int_set (&entry->probed, TRUE);
+}
+
+static gboolean
+add_file_entry (GeditFileBookmarksStore *model,
+		FileEntry               *entry)
+{
+	gboolean probed = g_atomic_int_get (&entry->probed);
+	const gchar *icon_name;
+	gchar *name;
+
+	/* Entries which were not checked in time are shown anyway */
+	if (probed && !entry->exists)
+		return FALSE;
+
+	if (entry->flags & GEDIT_FILE_BOOKMARKS_STORE_IS_HOME)
+		icon_name = "user-home-symbolic";
+	else if (entry->flags & GEDIT_FILE_BOOKMARKS_STORE_IS_DESKTOP)
+		icon_name = "user-desktop-symbolic";
+	else if (entry->flags & GEDIT_FILE_BOOKMARKS_STORE_IS_ROOT)
+		icon_name = "drive-harddisk-symbolic";
+	else if (probed && g_file_is_native (entry->file))
+		icon_name = entry->icon_name;
 	else
-		newname = g_strdup (name);
+		icon_name = "folder-symbolic";
 
-	add_node (model, NULL, icon_name, newname, G_OBJECT (file), flags, iter);
+	if (entry->name != NULL)
+		name = g_strdup (entry->name);
+	else if (probed)
+		name = g_strdup (entry->display_name);
+	else
+		name = g_file_get_basename (entry->file);
 
-	g_free (icon_name);
-	g_free (newname);
+	add_node (model, NULL, icon_name, name, G_OBJECT (entry->file), entry->flags, NULL);
+
+	g_free (name);
 
 	return TRUE;
 }
@@ -186,54 +288,319 @@ check_mount_separator (GeditFileBookmarksStore *model,
 	}
 }
 
+static gchar *
+get_bookmarks_file (void)
+{
+	return g_build_filename (g_get_user_config_dir (), "gtk-3.0", "bookmarks", NULL);
+}
+
+static gchar *
+get_legacy_bookmarks_file (void)
+{
+	return g_build_filename (g_get_home_dir (), ".gtk-bookmarks", NULL);
+}
+
+/* Runs in a thread. Returns the FileEntry of the bookmarks, or NULL
+   when the file could not be read */
+static GPtrArray *
+parse_bookmarks_file (const gchar *bookmarks)
+{
+	GError *error = NULL;
+	GPtrArray *entries;
+	gchar *contents;
+	gchar **lines;
+	gchar **line;
+
+	if (!g_file_get_contents (bookmarks, &contents, NULL, &error))
+	{
+		/* The bookmarks file doesn't exist (which is perfectly fine) */
+		g_error_free (error);
+
+		return NULL;
+	}
+
+	entries = g_ptr_array_new_with_free_func ((GDestroyNotify)file_entry_free);
+	lines = g_strsplit (contents, "\n", 0);
+
+	for (line = lines; *line; ++line)
+	{
+		if (**line)
+		{
+			GFile *location;
+
+			gchar *pos;
+			gchar *name;
+
+			/* CHECK: is this really utf8? */
+			pos = g_utf8_strchr (*line, -1, ' ');
+
+			if (pos != NULL)
+			{
+				*pos = '\0';
+				name = pos + 1;
+			}
+			else
+			{
+				name = NULL;
+			}
+
+			/* the bookmarks file should contain valid
+			 * URIs, but paranoia is good */
+			location = g_file_new_for_uri (*line);
+			if (gedit_utils_is_valid_location (location))
+			{
+				guint flags = GEDIT_FILE_BOOKMARKS_STORE_IS_BOOKMARK;
+
+				if (g_file_is_native (location))
+					flags |= GEDIT_FILE_BOOKMARKS_STORE_IS_LOCAL_BOOKMARK;
+				else
+					flags |= GEDIT_FILE_BOOKMARKS_STORE_IS_REMOTE_BOOKMARK;
+
+				g_ptr_array_add (entries, file_entry_new (location, name, flags));
+			}
+			g_object_unref (location);
+		}
+	}
+
+	g_strfreev (lines);
+	g_free (contents);
+
+	return entries;
+}
+
 static void
-init_special_directories (GeditFileBookmarksStore *model)
+file_probe_free (FileProbe *probe)
 {
-	gchar const *path = g_get_home_dir ();
-	GFile *file;
+	if (probe->entries != NULL)
+		g_ptr_array_unref (probe->entries);
+
+	g_free (probe->bookmarks);
+	g_slice_free (FileProbe, probe);
+}
+
+/* Runs in a thread */
+static void
+file_probe_thread (GTask        *task,
+		   gpointer      source_object,
+		   FileProbe    *probe,
+		   GCancellable *cancellable)
+{
+	GPtrArray *entries = probe->entries;
 
-	if (path != NULL)
+	if (probe->is_bookmarks)
 	{
-		file = g_file_new_for_path (path);
-		add_file (model,
-			  file,
-			  _("Home"),
-			  GEDIT_FILE_BOOKMARKS_STORE_IS_HOME | GEDIT_FILE_BOOKMARKS_STORE_IS_SPECIAL_DIR,
-			  NULL);
-		g_object_unref (file);
+		gchar *bookmarks = get_bookmarks_file ();
+
+		entries = parse_bookmarks_file (bookmarks);
+
+		if (entries == NULL)
+		{
+			g_free (bookmarks);
+
+			/* try the old location (gtk <= 3.4) */
+			bookmarks = get_legacy_bookmarks_file ();
+			entries = parse_bookmarks_file (bookmarks);
+		}
+
+		if (entries != NULL)
+			probe->bookmarks = bookmarks;
+		else
+			g_free (bookmarks);
+
+		g_atomic_pointer_set (&probe->entries, entries);
 	}
 
-#if defined(G_OS_WIN32) || defined(OS_OSX)
-	path = g_get_user_special_dir (G_USER_DIRECTORY_DESKTOP);
-	if (path != NULL)
-	{
-		file = g_file_new_for_path (path);
-		add_file (model,
-			  file,
-			  NULL,
-			  GEDIT_FILE_BOOKMARKS_STORE_IS_DESKTOP | GEDIT_FILE_BOOKMARKS_STORE_IS_SPECIAL_DIR,
-			  NULL);
-		g_object_unref (file);
+	for (guint i = 0; entries != NULL && i < entries->len; ++i)
+	{
+		if (g_cancellable_is_cancelled (cancellable))
+			break;
+
+		file_entry_probe (g_ptr_array_index (entries, i), cancellable);
 	}
 
-	path = g_get_user_special_dir (G_USER_DIRECTORY_DOCUMENTS);
-	if (path != NULL)
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+add_bookmarks (GeditFileBookmarksStore *model,
+	       FileProbe               *probe,
+	       GPtrArray               *entries)
+{
+	gboolean added = FALSE;
+
+	remove_bookmarks (model);
+
+	for (guint i = 0; entries != NULL && i < entries->len; ++i)
+		added |= add_file_entry (model, g_ptr_array_index (entries, i));
+
+	if (added)
 	{
-		file = g_file_new_for_path (path);
-		add_file (model,
-			  file,
-			  NULL,
-			  GEDIT_FILE_BOOKMARKS_STORE_IS_DOCUMENTS | GEDIT_FILE_BOOKMARKS_STORE_IS_SPECIAL_DIR,
+		/* Bookmarks separator */
+		add_node (model, NULL, NULL, NULL, NULL,
+			  GEDIT_FILE_BOOKMARKS_STORE_IS_BOOKMARK | GEDIT_FILE_BOOKMARKS_STORE_IS_SEPARATOR,
 			  NULL);
+	}
+
+	/* Add a watch */
+	if (probe->bookmarks != NULL && model->priv->bookmarks_monitor == NULL)
+	{
+		GFile *file = g_file_new_for_path (probe->bookmarks);
+
+		model->priv->bookmarks_monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, NULL);
 		g_object_unref (file);
+
+		g_signal_connect (model->priv->bookmarks_monitor,
+				  "changed",
+				  G_CALLBACK (on_bookmarks_file_changed),
+				  model);
+	}
+}
+
+/* Adds the rows of probe, when the thread is not done yet the entries
+   it did not get to are added unchecked */
+static void
+file_probe_add_rows (FileProbe *probe)
+{
+	GeditFileBookmarksStore *model = probe->model;
+	GPtrArray *entries = g_atomic_pointer_get (&probe->entries);
+
+	if (probe->is_bookmarks)
+	{
+		add_bookmarks (model, probe, entries);
+		return;
 	}
+
+	for (guint i = 0; i < entries->len; ++i)
+		add_file_entry (model, g_ptr_array_index (entries, i));
+
+	check_mount_separator (model, GEDIT_FILE_BOOKMARKS_STORE_IS_ROOT, TRUE);
+}
+
+static void
+file_probe_cb (GObject      *source_object,
+	       GAsyncResult *result,
+	       gpointer      user_data)
+{
+	GTask *task = G_TASK (result);
+	FileProbe *probe = g_task_get_task_data (task);
+
+	/* Either cancelled, or the rows were added when it timed out */
+	if (g_cancellable_is_cancelled (g_task_get_cancellable (task)))
+		return;
+
+	if (probe->timeout_id != 0)
+	{
+		g_source_remove (probe->timeout_id);
+		probe->timeout_id = 0;
+	}
+
+	file_probe_add_rows (probe);
+}
+
+static gboolean
+file_probe_timeout_cb (GTask *task)
+{
+	FileProbe *probe = g_task_get_task_data (task);
+	GCancellable *cancellable = g_task_get_cancellable (task);
+
+	if (g_cancellable_is_cancelled (cancellable))
+	{
+		probe->timeout_id = 0;
+		return G_SOURCE_REMOVE;
+	}
+
+	/* Only the checks of the entries are cut short, the bookmarks file
+	   is always read to the end, so wait for it once more */
+	if (probe->is_bookmarks && g_atomic_pointer_get (&probe->entries) == NULL)
+		return G_SOURCE_CONTINUE;
+
+	probe->timeout_id = 0;
+
+	file_probe_add_rows (probe);
+
+	/* Let the thread stop at the next entry */
+	g_cancellable_cancel (cancellable);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Checks entries in a thread and adds their rows when done, or after
+   FILE_PROBE_TIMEOUT_MSEC. When entries is NULL the bookmarks file is
+   read instead, and the timeout is extended until it is read. Any
+   previous load using cancellable is cancelled */
+static void
+file_probe_start (GeditFileBookmarksStore  *model,
+		  GPtrArray                *entries,
+		  GCancellable            **cancellable)
+{
+	FileProbe *probe = g_slice_new0 (FileProbe);
+	GTask *task;
+
+	cancel_load (cancellable);
+	*cancellable = g_cancellable_new ();
+
+	probe->model = model;
+	probe->entries = entries;
+	probe->is_bookmarks = entries == NULL;
+
+	task = g_task_new (NULL, *cancellable, file_probe_cb, NULL);
+	g_task_set_task_data (task, probe, (GDestroyNotify)file_probe_free);
+	g_task_run_in_thread (task, (GTaskThreadFunc)file_probe_thread);
+
+	/* The timeout keeps the task, and so probe, alive */
+	probe->timeout_id = g_timeout_add_full (G_PRIORITY_DEFAULT,
+						FILE_PROBE_TIMEOUT_MSEC,
+						(GSourceFunc)file_probe_timeout_cb,
+						g_object_ref (task),
+						g_object_unref);
+
+	g_object_unref (task);
+}
+
+static void
+add_special_directory (GPtrArray   *entries,
+		       gchar const *path,
+		       gchar const *name,
+		       guint        flags)
+{
+	GFile *file;
+
+	if (path == NULL)
+		return;
+
+	file = g_file_new_for_path (path);
+	g_ptr_array_add (entries, file_entry_new (file, name, flags));
+	g_object_unref (file);
+}
+
+static void
+init_special_directories (GeditFileBookmarksStore *model)
+{
+	GPtrArray *entries = g_ptr_array_new_with_free_func ((GDestroyNotify)file_entry_free);
+	GFile *file;
+
+	add_special_directory (entries,
+			       g_get_home_dir (),
+			       _("Home"),
+			       GEDIT_FILE_BOOKMARKS_STORE_IS_HOME | GEDIT_FILE_BOOKMARKS_STORE_IS_SPECIAL_DIR);
+
+#if defined(G_OS_WIN32) || defined(OS_OSX)
+	add_special_directory (entries,
+			       g_get_user_special_dir (G_USER_DIRECTORY_DESKTOP),
+			       NULL,
+			       GEDIT_FILE_BOOKMARKS_STORE_IS_DESKTOP | GEDIT_FILE_BOOKMARKS_STORE_IS_SPECIAL_DIR);
+
+	add_special_directory (entries,
+			       g_get_user_special_dir (G_USER_DIRECTORY_DOCUMENTS),
+			       NULL,
+			       GEDIT_FILE_BOOKMARKS_STORE_IS_DOCUMENTS | GEDIT_FILE_BOOKMARKS_STORE_IS_SPECIAL_DIR);
 #endif
 
 	file = g_file_new_for_uri ("file:///");
-	add_file (model, file, _("File System"), GEDIT_FILE_BOOKMARKS_STORE_IS_ROOT, NULL);
+	g_ptr_array_add (entries, file_entry_new (file, _("File System"), GEDIT_FILE_BOOKMARKS_STORE_IS_ROOT));
 	g_object_unref (file);
 
-	check_mount_separator (model, GEDIT_FILE_BOOKMARKS_STORE_IS_ROOT, TRUE);
+	file_probe_start (model, entries, &model->priv->special_dirs_cancellable);
 }
 
 static void
@@ -295,31 +662,62 @@ add_fs (GeditFileBookmarksStore *model,
 	check_mount_separator (model, GEDIT_FILE_BOOKMARKS_STORE_IS_FS, TRUE);
 }
 
+/* Only touches the row when the name or the icon changed */
+static void
+update_fs (GeditFileBookmarksStore *model,
+	   gpointer                 fs,
+	   GtkTreeIter             *iter)
+{
+	gchar *icon_name = NULL;
+	gchar *name = NULL;
+	gchar *old_icon_name = NULL;
+	gchar *old_name = NULL;
+	guint fsflags;
+
+	get_fs_properties (fs, &name, &icon_name, &fsflags);
+
+	gtk_tree_model_get (GTK_TREE_MODEL (model), iter,
+			    GEDIT_FILE_BOOKMARKS_STORE_COLUMN_ICON_NAME, &old_icon_name,
+			    GEDIT_FILE_BOOKMARKS_STORE_COLUMN_NAME, &old_name,
+			    -1);
+
+	if (g_strcmp0 (name, old_name) != 0 || g_strcmp0 (icon_name, old_icon_name) != 0)
+	{
+		gtk_tree_store_set (GTK_TREE_STORE (model), iter,
+				    GEDIT_FILE_BOOKMARKS_STORE_COLUMN_ICON_NAME, icon_name,
+				    GEDIT_FILE_BOOKMARKS_STORE_COLUMN_NAME, name,
+				    -1);
+	}
+
+	g_free (name);
+	g_free (icon_name);
+	g_free (old_name);
+	g_free (old_icon_name);
+}
+
 static void
-process_volume_cb (GVolume                 *volume,
-		   GeditFileBookmarksStore *model)
+process_volume_cb (GVolume   *volume,
+		   GPtrArray *fs)
 {
 	GMount *mount = g_volume_get_mount (volume);
-	guint flags = GEDIT_FILE_BOOKMARKS_STORE_NONE;
 
 	/* CHECK: should we use the LOCAL/REMOTE thing still? */
 	if (mount)
 	{
 		/* Show mounted volume */
-		add_fs (model, mount, flags, NULL);
-		g_object_unref (mount);
+		g_ptr_array_add (fs, mount);
 	}
 	else if (g_volume_can_mount (volume))
 	{
 		/* We also show the unmounted volume here so users can
 		   mount it if they want to access it */
-		add_fs (model, volume, flags, NULL);
+		g_ptr_array_add (fs, g_object_ref (volume));
 	}
 }
 
 static void
-process_drive_novolumes (GeditFileBookmarksStore *model,
-			 GDrive                  *drive)
+process_drive_novolumes (GDrive    *drive,
+			 GPtrArray *fs)
 {
 	if (g_drive_is_media_removable (drive) &&
 	   !g_drive_is_media_check_automatic (drive) &&
@@ -329,40 +727,41 @@ process_drive_novolumes (GeditFileBookmarksStore *model,
 		   drives where media detection fails. We show the
 		   drive and poll for media when the user activates
 		   it */
-		add_fs (model, drive, GEDIT_FILE_BOOKMARKS_STORE_NONE, NULL);
+		g_ptr_array_add (fs, g_object_ref (drive));
 	}
 }
 
 static void
-process_drive_cb (GDrive                  *drive,
-	          GeditFileBookmarksStore *model)
+process_drive_cb (GDrive    *drive,
+	          GPtrArray *fs)
 {
 	GList *volumes = g_drive_get_volumes (drive);
 
 	if (volumes)
 	{
 		/* Add all volumes for the drive */
-		g_list_foreach (volumes, (GFunc)process_volume_cb, model);
-		g_list_free (volumes);
+		g_list_foreach (volumes, (GFunc)process_volume_cb, fs);
+		g_list_free_full (volumes, g_object_unref);
 	}
 	else
 	{
-		process_drive_novolumes (model, drive);
+		process_drive_novolumes (drive, fs);
 	}
 }
 
 static void
-init_drives (GeditFileBookmarksStore *model)
+init_drives (GeditFileBookmarksStore *model,
+	     GPtrArray               *fs)
 {
 	GList *drives = g_volume_monitor_get_connected_drives (model->priv->volume_monitor);
 
-	g_list_foreach (drives, (GFunc)process_drive_cb, model);
+	g_list_foreach (drives, (GFunc)process_drive_cb, fs);
 	g_list_free_full (drives, g_object_unref);
 }
 
 static void
-process_volume_nodrive_cb (GVolume                 *volume,
-			   GeditFileBookmarksStore *model)
+process_volume_nodrive_cb (GVolume   *volume,
+			   GPtrArray *fs)
 {
 	GDrive *drive = g_volume_get_drive (volume);
 
@@ -372,21 +771,22 @@ process_volume_nodrive_cb (GVolume                 *volume,
 		return;
 	}
 
-	process_volume_cb (volume, model);
+	process_volume_cb (volume, fs);
 }
 
 static void
-init_volumes (GeditFileBookmarksStore *model)
+init_volumes (GeditFileBookmarksStore *model,
+	      GPtrArray               *fs)
 {
 	GList *volumes = g_volume_monitor_get_volumes (model->priv->volume_monitor);
 
-	g_list_foreach (volumes, (GFunc)process_volume_nodrive_cb, model);
+	g_list_foreach (volumes, (GFunc)process_volume_nodrive_cb, fs);
 	g_list_free_full (volumes, g_object_unref);
 }
 
 static void
-process_mount_novolume_cb (GMount                  *mount,
-			   GeditFileBookmarksStore *model)
+process_mount_novolume_cb (GMount    *mount,
+			   GPtrArray *fs)
 {
 	GVolume *volume = g_mount_get_volume (mount);
 
@@ -397,22 +797,32 @@ process_mount_novolume_cb (GMount                  *mount,
 	else if (!g_mount_is_shadowed (mount))
 	{
 		/* Add the mount */
-		add_fs (model, mount, GEDIT_FILE_BOOKMARKS_STORE_NONE, NULL);
+		g_ptr_array_add (fs, g_object_ref (mount));
 	}
 }
 
 static void
-init_mounts (GeditFileBookmarksStore *model)
+init_mounts (GeditFileBookmarksStore *model,
+	     GPtrArray               *fs)
 {
 	GList *mounts = g_volume_monitor_get_mounts (model->priv->volume_monitor);
 
-	g_list_foreach (mounts, (GFunc)process_mount_novolume_cb, model);
+	g_list_foreach (mounts, (GFunc)process_mount_novolume_cb, fs);
 	g_list_free_full (mounts, g_object_unref);
 }
 
+/* Brings the rows of the drives, volumes and mounts in line with the
+   volume monitor. Rows which are still there are left in place and only
+   updated when they changed */
 static void
 init_fs (GeditFileBookmarksStore *model)
 {
+	GtkTreeModel *tree_model = GTK_TREE_MODEL (model);
+	GHashTable *missing;
+	GPtrArray *fs;
+	GArray *rows;
+	GtkTreeIter iter;
+
 	if (model->priv->volume_monitor == NULL)
 	{
 		const gchar **ptr;
@@ -434,146 +844,94 @@ init_fs (GeditFileBookmarksStore *model)
 		}
 	}
 
+	fs = g_ptr_array_new_with_free_func (g_object_unref);
+
 	/* First go through all the connected drives */
-	init_drives (model);
+	init_drives (model, fs);
 
 	/* Then add all volumes, not associated with a drive */
-	init_volumes (model);
+	init_volumes (model, fs);
 
 	/* Then finally add all mounts that have no volume */
-	init_mounts (model);
-}
-
-static gboolean
-add_bookmark (GeditFileBookmarksStore *model,
-	      gchar const             *name,
-	      gchar const             *uri)
-{
-	GFile *file = g_file_new_for_uri (uri);
-	guint flags = GEDIT_FILE_BOOKMARKS_STORE_IS_BOOKMARK;
-	GtkTreeIter iter;
-	gboolean ret;
-
-	if (g_file_is_native (file))
-		flags |= GEDIT_FILE_BOOKMARKS_STORE_IS_LOCAL_BOOKMARK;
-	else
-		flags |= GEDIT_FILE_BOOKMARKS_STORE_IS_REMOTE_BOOKMARK;
-
-	ret = add_file (model, file, name, flags, &iter);
+	init_mounts (model, fs);
 
-	g_object_unref (file);
-	return ret;
-}
+	missing = g_hash_table_new (NULL, NULL);
 
-static gchar *
-get_bookmarks_file (void)
-{
-	return g_build_filename (g_get_user_config_dir (), "gtk-3.0", "bookmarks", NULL);
-}
-
-static gchar *
-get_legacy_bookmarks_file (void)
-{
-	return g_build_filename (g_get_home_dir (), ".gtk-bookmarks", NULL);
-}
+	for (guint i = 0; i < fs->len; ++i)
+		g_hash_table_add (missing, g_ptr_array_index (fs, i));
 
-static gboolean
-parse_bookmarks_file (GeditFileBookmarksStore *model,
-		      const gchar             *bookmarks,
-		      gboolean                *added)
-{
-	GError *error = NULL;
-	gchar *contents;
-	gchar **lines;
-	gchar **line;
+	/* The iters of a tree store persist, so they stay valid while
+	   other rows are removed or move because they changed */
+	rows = g_array_new (FALSE, FALSE, sizeof (GtkTreeIter));
 
-	if (!g_file_get_contents (bookmarks, &contents, NULL, &error))
+	if (gtk_tree_model_get_iter_first (tree_model, &iter))
 	{
-		/* The bookmarks file doesn't exist (which is perfectly fine) */
-		g_error_free (error);
-
-		return FALSE;
+		do
+		{
+			g_array_append_val (rows, iter);
+		}
+		while (gtk_tree_model_iter_next (tree_model, &iter));
 	}
 
-	lines = g_strsplit (contents, "\n", 0);
-
-	for (line = lines; *line; ++line)
+	for (guint i = 0; i < rows->len; ++i)
 	{
-		if (**line)
-		{
-			GFile *location;
+		GtkTreeIter *row = &g_array_index (rows, GtkTreeIter, i);
+		GObject *obj;
+		guint flags;
 
-			gchar *pos;
-			gchar *name;
-
-			/* CHECK: is this really utf8? */
-			pos = g_utf8_strchr (*line, -1, ' ');
+		gtk_tree_model_get (tree_model, row,
+				    GEDIT_FILE_BOOKMARKS_STORE_COLUMN_OBJECT, &obj,
+				    GEDIT_FILE_BOOKMARKS_STORE_COLUMN_FLAGS, &flags,
+				    -1);
 
-			if (pos != NULL)
-			{
-				*pos = '\0';
-				name = pos + 1;
-			}
+		if ((flags & GEDIT_FILE_BOOKMARKS_STORE_IS_FS) &&
+		    !(flags & GEDIT_FILE_BOOKMARKS_STORE_IS_SEPARATOR))
+		{
+			if (g_hash_table_remove (missing, obj))
+				update_fs (model, obj, row);
 			else
-			{
-				name = NULL;
-			}
-
-			/* the bookmarks file should contain valid
-			 * URIs, but paranoia is good */
-			location = g_file_new_for_uri (*line);
-			if (gedit_utils_is_valid_location (location))
-			{
-				*added |= add_bookmark (model, name, *line);
-			}
-			g_object_unref (location);
+				gtk_tree_store_remove (GTK_TREE_STORE (model), row);
 		}
-	}
 
-	g_strfreev (lines);
-	g_free (contents);
+		if (obj)
+			g_object_unref (obj);
+	}
 
-	/* Add a watch */
-	if (model->priv->bookmarks_monitor == NULL)
+	for (guint i = 0; i < fs->len; ++i)
 	{
-		GFile *file = g_file_new_for_path (bookmarks);
+		gpointer obj = g_ptr_array_index (fs, i);
 
-		model->priv->bookmarks_monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, NULL);
-		g_object_unref (file);
-
-		g_signal_connect (model->priv->bookmarks_monitor,
-				  "changed",
-				  G_CALLBACK (on_bookmarks_file_changed),
-				  model);
+		if (g_hash_table_remove (missing, obj))
+			add_fs (model, obj, GEDIT_FILE_BOOKMARKS_STORE_NONE, NULL);
 	}
 
-	return TRUE;
+	check_mount_separator (model, GEDIT_FILE_BOOKMARKS_STORE_IS_FS, fs->len > 0);
+
+	g_array_unref (rows);
+	g_hash_table_unref (missing);
+	g_ptr_array_unref (fs);
 }
 
-static void
-init_bookmarks (GeditFileBookmarksStore *model)
+static gboolean
+init_fs_idle (GeditFileBookmarksStore *model)
 {
-	gchar *bookmarks = get_bookmarks_file ();
-	gboolean added = FALSE;
-
-	if (!parse_bookmarks_file (model, bookmarks, &added))
-	{
-		g_free (bookmarks);
+	model->priv->update_fs_id = 0;
+	init_fs (model);
 
-		/* try the old location (gtk <= 3.4) */
-		bookmarks = get_legacy_bookmarks_file ();
-		parse_bookmarks_file (model, bookmarks, &added);
-	}
+	return G_SOURCE_REMOVE;
+}
 
-	if (added)
-	{
-		/* Bookmarks separator */
-		add_node (model, NULL, NULL, NULL, NULL,
-			  GEDIT_FILE_BOOKMARKS_STORE_IS_BOOKMARK | GEDIT_FILE_BOOKMARKS_STORE_IS_SEPARATOR,
-			  NULL);
-	}
+static void
+schedule_init_fs (GeditFileBookmarksStore *model)
+{
+	if (model->priv->update_fs_id == 0)
+		model->priv->update_fs_id = g_idle_add ((GSourceFunc)init_fs_idle, model);
+}
 
-	g_free (bookmarks);
+static void
+init_bookmarks (GeditFileBookmarksStore *model)
+{
+	file_probe_start (model, NULL, &model->priv->bookmarks_cancellable);
 }
 
 static gint flags_order[] = {
@@ -781,11 +1139,13 @@ remove_bookmarks (GeditFileBookmarksStore *model)
 	}
 }
 
+/* Everything which can block is done in a thread or from an idle, so
+   the store is empty when created and filled in shortly after */
 static void
 initialize_fill (GeditFileBookmarksStore *model)
 {
 	init_special_directories (model);
-	init_fs (model);
+	schedule_init_fs (model);
 	init_bookmarks (model);
 }
 
@@ -871,17 +1231,8 @@ on_fs_changed (GVolumeMonitor          *monitor,
 	       GObject                 *object,
 	       GeditFileBookmarksStore *model)
 {
-	GtkTreeModel *tree_model = GTK_TREE_MODEL (model);
-	guint flags = GEDIT_FILE_BOOKMARKS_STORE_IS_FS;
-	guint noflags = GEDIT_FILE_BOOKMARKS_STORE_IS_SEPARATOR;
-	GtkTreeIter iter;
-
-	/* clear all fs items */
-	while (find_with_flags (tree_model, &iter, NULL, flags, noflags))
-		remove_node (tree_model, &iter);
-
-	/* then reinitialize */
-	init_fs (model);
+	/* A device often emits several of these at once */
+	schedule_init_fs (model);
 }
 
 static void
@@ -895,13 +1246,14 @@ on_bookmarks_file_changed (GFileMonitor            *monitor,
 	{
 		case G_FILE_MONITOR_EVENT_CHANGED:
 		case G_FILE_MONITOR_EVENT_CREATED:
-			/* Re-initialize bookmarks */
-			remove_bookmarks (model);
+			/* Re-initialize bookmarks, they are replaced
+			   once the file was read */
 			init_bookmarks (model);
 			break;
 		/*  FIXME: shouldn't we also monitor the directory? */
 		case G_FILE_MONITOR_EVENT_DELETED:
 			/* Remove bookmarks */
+			cancel_load (&model->priv->bookmarks_cancellable);
 			remove_bookmarks (model);
 			g_object_unref (monitor);
 			model->priv->bookmarks_monitor = NULL;
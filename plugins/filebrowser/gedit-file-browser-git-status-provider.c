@@ -0,0 +1,588 @@
+/*
+ * gedit-file-browser-git-status-provider.c
+ * This file is part of gedit
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include <string.h>
+
+#include "gedit-file-browser-git-status-provider.h"
+
+/* The status of a whole repository is taken at once and shared by its
+   directories, until the repository or a monitored directory in it
+   changes */
+typedef struct
+{
+	GeditFileBrowserGitStatusProvider *provider;
+
+	GFile        *toplevel;
+	GFileMonitor *index_monitor;
+	GFileMonitor *head_monitor;
+
+	/* Bumped by each change, the status is current when it was taken
+	   at the same generation */
+	guint         generation;
+	guint         status_generation;
+	GBytes       *status;
+	gboolean      refreshing;
+} Repository;
+
+struct _GeditFileBrowserGitStatusProvider
+{
+	GObject parent_instance;
+
+	/* Protects what follows, the statuses are queried in threads */
+	GMutex lock;
+	GCond refreshed;
+
+	GPtrArray *repositories;
+
+	/* Paths of the directories known to be outside any repository */
+	GHashTable *outside;
+};
+
+static void gedit_file_browser_git_status_provider_iface_init (GeditFileBrowserStatusProviderInterface *iface);
+
+G_DEFINE_DYNAMIC_TYPE_EXTENDED (GeditFileBrowserGitStatusProvider,
+				gedit_file_browser_git_status_provider,
+				G_TYPE_OBJECT,
+				0,
+				G_IMPLEMENT_INTERFACE_DYNAMIC (GEDIT_TYPE_FILE_BROWSER_STATUS_PROVIDER,
+							       gedit_file_browser_git_status_provider_iface_init))
+
+/* Runs git in path and returns its output. Outside of a repository git
+   fails, which gives NULL without an error */
+static GBytes *
+run_git (const gchar         *path,
+	 const gchar * const *argv,
+	 GCancellable        *cancellable,
+	 GError             **error)
+{
+	GSubprocessLauncher *launcher;
+	GSubprocess *subprocess;
+	GBytes *output = NULL;
+
+	launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE |
+					      G_SUBPROCESS_FLAGS_STDERR_SILENCE);
+	g_subprocess_launcher_set_cwd (launcher, path);
+
+	/* Do not take the index lock only to refresh it, the user may be
+	   running git at the same time */
+	g_subprocess_launcher_setenv (launcher, "GIT_OPTIONAL_LOCKS", "0", TRUE);
+
+	subprocess = g_subprocess_launcher_spawnv (launcher, argv, error);
+	g_object_unref (launcher);
+
+	if (subprocess == NULL)
+		return NULL;
+
+	if (g_subprocess_communicate (subprocess, NULL, cancellable, &output, NULL, error) &&
+	    !g_subprocess_get_successful (subprocess))
+	{
+		g_clear_pointer (&output, g_bytes_unref);
+	}
+
+	g_object_unref (subprocess);
+	return output;
+}
+
+static void
+repository_free (Repository *repo)
+{
+	if (repo->index_monitor != NULL)
+	{
+		g_signal_handlers_disconnect_by_data (repo->index_monitor, repo);
+		g_file_monitor_cancel (repo->index_monitor);
+		g_object_unref (repo->index_monitor);
+	}
+
+	if (repo->head_monitor != NULL)
+	{
+		g_signal_handlers_disconnect_by_data (repo->head_monitor, repo);
+		g_file_monitor_cancel (repo->head_monitor);
+		g_object_unref (repo->head_monitor);
+	}
+
+	if (repo->status != NULL)
+		g_bytes_unref (repo->status);
+
+	g_object_unref (repo->toplevel);
+	g_slice_free (Repository, repo);
+}
+
+/* Staging, committing or switching branches only touches the files in
+   the git directory, which the store does not monitor */
+static void
+on_git_file_changed (GFileMonitor      *monitor,
+		     GFile             *file,
+		     GFile             *other_file,
+		     GFileMonitorEvent  event_type,
+		     Repository        *repo)
+{
+	GeditFileBrowserGitStatusProvider *provider = repo->provider;
+
+	if (event_type == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT ||
+	    event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED)
+	{
+		return;
+	}
+
+	g_mutex_lock (&provider->lock);
+	repo->generation++;
+	g_mutex_unlock (&provider->lock);
+
+	gedit_file_browser_status_provider_changed (GEDIT_FILE_BROWSER_STATUS_PROVIDER (provider));
+}
+
+static GFileMonitor *
+monitor_git_file (Repository  *repo,
+		  const gchar *git_dir,
+		  const gchar *name)
+{
+	GFile *file;
+	GFileMonitor *monitor;
+	gchar *path;
+
+	path = g_build_filename (git_dir, name, NULL);
+	file = g_file_new_for_path (path);
+	g_free (path);
+
+	monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, NULL);
+	g_object_unref (file);
+
+	if (monitor != NULL)
+	{
+		g_signal_connect (monitor,
+				  "changed",
+				  G_CALLBACK (on_git_file_changed),
+				  repo);
+	}
+
+	return monitor;
+}
+
+/* The top of the repository is the directory, the prefix components up,
+   which keeps it in the same form as the paths of the store even when
+   they go through symbolic links */
+static GFile *
+toplevel_from_prefix (GFile       *directory,
+		      const gchar *prefix)
+{
+	GFile *toplevel = g_object_ref (directory);
+
+	for (const gchar *c = prefix; *c != '\0'; ++c)
+	{
+		if (*c == '/')
+		{
+			GFile *parent = g_file_get_parent (toplevel);
+
+			if (parent == NULL)
+				break;
+
+			g_object_unref (toplevel);
+			toplevel = parent;
+		}
+	}
+
+	return toplevel;
+}
+
+/* Whether directory is below toplevel in the same repository, rather
+   than in a nested one such as a submodule */
+static gboolean
+repository_contains (Repository *repo,
+		     GFile      *directory)
+{
+	GFile *dir;
+	gboolean contains;
+
+	if (!g_file_equal (directory, repo->toplevel) &&
+	    !g_file_has_prefix (directory, repo->toplevel))
+	{
+		return FALSE;
+	}
+
+	dir = g_object_ref (directory);
+	contains = TRUE;
+
+	while (contains && !g_file_equal (dir, repo->toplevel))
+	{
+		GFile *git = g_file_get_child (dir, ".git");
+		GFile *parent;
+
+		contains = !g_file_query_exists (git, NULL);
+		g_object_unref (git);
+
+		parent = g_file_get_parent (dir);
+		g_object_unref (dir);
+		dir = parent;
+	}
+
+	g_object_unref (dir);
+	return contains;
+}
+
+/* Finds the repository of directory, asking git only about directories
+   which are in no repository seen so far. Called with the lock held,
+   which is released while git runs */
+static Repository *
+lookup_repository (GeditFileBrowserGitStatusProvider  *provider,
+		   GFile                              *directory,
+		   const gchar                        *path,
+		   GCancellable                       *cancellable,
+		   GError                            **error)
+{
+	static const gchar * const argv[] = {
+		"git", "rev-parse", "--show-prefix", "--git-dir", NULL
+	};
+	Repository *repo;
+	GBytes *output;
+	gchar *text;
+	gchar **lines;
+
+	for (guint i = 0; i < provider->repositories->len; ++i)
+	{
+		repo = g_ptr_array_index (provider->repositories, i);
+
+		if (repository_contains (repo, directory))
+			return repo;
+	}
+
+	if (g_hash_table_contains (provider->outside, path))
+		return NULL;
+
+	g_mutex_unlock (&provider->lock);
+	output = run_git (path, argv, cancellable, error);
+	g_mutex_lock (&provider->lock);
+
+	if (output == NULL)
+	{
+		if (error == NULL || *error == NULL)
+			g_hash_table_add (provider->outside, g_strdup (path));
+
+		return NULL;
+	}
+
+	text = g_strndup (g_bytes_get_data (output, NULL), g_bytes_get_size (output));
+	lines = g_strsplit (text, "\n", 3);
+	g_bytes_unref (output);
+	g_free (text);
+
+	/* The prefix line is empty at the top of the repository */
+	if (g_strv_length (lines) < 2)
+	{
+		g_strfreev (lines);
+		return NULL;
+	}
+
+	repo = g_slice_new0 (Repository);
+	repo->provider = provider;
+	repo->toplevel = toplevel_from_prefix (directory, lines[0]);
+
+	/* Another thread may have found it in the meantime */
+	for (guint i = 0; i < provider->repositories->len; ++i)
+	{
+		Repository *other = g_ptr_array_index (provider->repositories, i);
+
+		if (g_file_equal (other->toplevel, repo->toplevel))
+		{
+			repository_free (repo);
+			g_strfreev (lines);
+			return other;
+		}
+	}
+
+	{
+		gchar *git_dir = g_path_is_absolute (lines[1]) ?
+				 g_strdup (lines[1]) :
+				 g_build_filename (path, lines[1], NULL);
+
+		repo->index_monitor = monitor_git_file (repo, git_dir, "index");
+		repo->head_monitor = monitor_git_file (repo, git_dir, "HEAD");
+
+		g_free (git_dir);
+	}
+
+	g_ptr_array_add (provider->repositories, repo);
+	g_strfreev (lines);
+
+	return repo;
+}
+
+/* Returns the status of the whole repository, running git only when
+   something changed since it was last taken. Called with the lock held,
+   which is released while git runs */
+static GBytes *
+repository_get_status (GeditFileBrowserGitStatusProvider  *provider,
+		       Repository                         *repo,
+		       GCancellable                       *cancellable,
+		       GError                            **error)
+{
+	static const gchar * const argv[] = {
+		"git", "status", "--porcelain=v1", "-z", "--untracked-files=normal", NULL
+	};
+
+	/* Directories of the same repository share one run */
+	while (repo->refreshing)
+		g_cond_wait (&provider->refreshed, &provider->lock);
+
+	if (repo->status == NULL || repo->status_generation != repo->generation)
+	{
+		guint generation = repo->generation;
+		gchar *toplevel = g_file_get_path (repo->toplevel);
+		GBytes *output;
+
+		repo->refreshing = TRUE;
+		g_mutex_unlock (&provider->lock);
+
+		output = run_git (toplevel, argv, cancellable, error);
+		g_free (toplevel);
+
+		g_mutex_lock (&provider->lock);
+		repo->refreshing = FALSE;
+		g_cond_broadcast (&provider->refreshed);
+
+		if (output == NULL)
+			return NULL;
+
+		if (repo->status != NULL)
+			g_bytes_unref (repo->status);
+
+		repo->status = output;
+		repo->status_generation = generation;
+	}
+
+	return g_bytes_ref (repo->status);
+}
+
+static GeditFileBrowserStatus
+status_from_porcelain (gchar x,
+		       gchar y)
+{
+	if (x == '?' && y == '?')
+		return GEDIT_FILE_BROWSER_STATUS_UNTRACKED;
+
+	if (x == '!')
+		return GEDIT_FILE_BROWSER_STATUS_NONE;
+
+	if (x == 'U' || y == 'U' || (x == 'A' && y == 'A') || (x == 'D' && y == 'D'))
+		return GEDIT_FILE_BROWSER_STATUS_CONFLICTED;
+
+	if (x == 'A')
+		return GEDIT_FILE_BROWSER_STATUS_ADDED;
+
+	return GEDIT_FILE_BROWSER_STATUS_MODIFIED;
+}
+
+/* Adds the entries of git status output for the children of the
+   directory at prefix, relative to the top of the repository */
+static void
+parse_porcelain (GHashTable  *statuses,
+		 GBytes      *output,
+		 const gchar *prefix)
+{
+	gsize size;
+	const gchar *data = g_bytes_get_data (output, &size);
+	const gchar *end = data + size;
+	gsize prefix_len = strlen (prefix);
+
+	while (data < end)
+	{
+		const gchar *entry = data;
+		const gchar *entry_end = memchr (entry, '\0', end - entry);
+		GeditFileBrowserStatus status;
+		const gchar *name;
+		gchar *child;
+
+		if (entry_end == NULL)
+			break;
+
+		data = entry_end + 1;
+
+		/* "XY path", renames and copies are followed by the original
+		   path, which is not of interest */
+		if (entry_end - entry < 4)
+			continue;
+
+		if (entry[0] == 'R' || entry[0] == 'C' || entry[1] == 'R' || entry[1] == 'C')
+		{
+			const gchar *origin_end = memchr (data, '\0', end - data);
+
+			data = origin_end != NULL ? origin_end + 1 : end;
+		}
+
+		name = entry + 3;
+
+		if (strncmp (name, prefix, prefix_len) != 0)
+			continue;
+
+		name += prefix_len;
+
+		/* Files further down count for the directory containing them */
+		child = g_strndup (name, strcspn (name, "/"));
+		status = status_from_porcelain (entry[0], entry[1]);
+
+		if (*child != '\0' &&
+		    status > GPOINTER_TO_UINT (g_hash_table_lookup (statuses, child)))
+		{
+			g_hash_table_replace (statuses, child, GUINT_TO_POINTER (status));
+		}
+		else
+		{
+			g_free (child);
+		}
+	}
+}
+
+static GHashTable *
+gedit_file_browser_git_status_provider_get_statuses (GeditFileBrowserStatusProvider  *provider,
+						     GFile                           *directory,
+						     GCancellable                    *cancellable,
+						     GError                         **error)
+{
+	GeditFileBrowserGitStatusProvider *git = GEDIT_FILE_BROWSER_GIT_STATUS_PROVIDER (provider);
+	GHashTable *statuses;
+	Repository *repo;
+	GBytes *output = NULL;
+	gchar *prefix = NULL;
+	gchar *path;
+
+	statuses = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	/* Only local repositories */
+	path = g_file_get_path (directory);
+
+	if (path == NULL)
+		return statuses;
+
+	g_mutex_lock (&git->lock);
+
+	repo = lookup_repository (git, directory, path, cancellable, error);
+
+	if (repo != NULL)
+	{
+		gchar *relative = g_file_get_relative_path (repo->toplevel, directory);
+
+		/* Paths in the status are relative to the top of the repository */
+		prefix = relative != NULL ? g_strconcat (relative, "/", NULL) : g_strdup ("");
+		g_free (relative);
+
+		output = repository_get_status (git, repo, cancellable, error);
+	}
+
+	g_mutex_unlock (&git->lock);
+
+	if (output != NULL)
+	{
+		parse_porcelain (statuses, output, prefix);
+		g_bytes_unref (output);
+	}
+
+	g_free (prefix);
+	g_free (path);
+
+	if (error != NULL && *error != NULL)
+	{
+		g_hash_table_unref (statuses);
+		return NULL;
+	}
+
+	return statuses;
+}
+
+/* Saving a file changes the status of its repository. A new repository
+   may also make directories known to be outside one part of it */
+static void
+gedit_file_browser_git_status_provider_file_changed (GeditFileBrowserStatusProvider *provider,
+						     GFile                          *file)
+{
+	GeditFileBrowserGitStatusProvider *git = GEDIT_FILE_BROWSER_GIT_STATUS_PROVIDER (provider);
+	gchar *basename = g_file_get_basename (file);
+
+	g_mutex_lock (&git->lock);
+
+	if (g_strcmp0 (basename, ".git") == 0)
+		g_hash_table_remove_all (git->outside);
+
+	for (guint i = 0; i < git->repositories->len; ++i)
+	{
+		Repository *repo = g_ptr_array_index (git->repositories, i);
+
+		if (g_file_has_prefix (file, repo->toplevel))
+			repo->generation++;
+	}
+
+	g_mutex_unlock (&git->lock);
+	g_free (basename);
+}
+
+static void
+gedit_file_browser_git_status_provider_iface_init (GeditFileBrowserStatusProviderInterface *iface)
+{
+	iface->get_statuses = gedit_file_browser_git_status_provider_get_statuses;
+	iface->file_changed = gedit_file_browser_git_status_provider_file_changed;
+}
+
+static void
+gedit_file_browser_git_status_provider_finalize (GObject *object)
+{
+	GeditFileBrowserGitStatusProvider *provider = GEDIT_FILE_BROWSER_GIT_STATUS_PROVIDER (object);
+
+	g_ptr_array_unref (provider->repositories);
+	g_hash_table_unref (provider->outside);
+	g_cond_clear (&provider->refreshed);
+	g_mutex_clear (&provider->lock);
+
+	G_OBJECT_CLASS (gedit_file_browser_git_status_provider_parent_class)->finalize (object);
+}
+
+static void
+gedit_file_browser_git_status_provider_class_init (GeditFileBrowserGitStatusProviderClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = gedit_file_browser_git_status_provider_finalize;
+}
+
+static void
+gedit_file_browser_git_status_provider_class_finalize (GeditFileBrowserGitStatusProviderClass *klass)
+{
+}
+
+static void
+gedit_file_browser_git_status_provider_init (GeditFileBrowserGitStatusProvider *provider)
+{
+	g_mutex_init (&provider->lock);
+	g_cond_init (&provider->refreshed);
+
+	provider->repositories = g_ptr_array_new_with_free_func ((GDestroyNotify)repository_free);
+	provider->outside = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+GeditFileBrowserStatusProvider *
+gedit_file_browser_git_status_provider_new (void)
+{
+	return g_object_new (GEDIT_TYPE_FILE_BROWSER_GIT_STATUS_PROVIDER, NULL);
+}
+
+void
+_gedit_file_browser_git_status_provider_register_type (GTypeModule *type_module)
+{
+	gedit_file_browser_git_status_provider_register_type (type_module);
+}
+
+/* ex:set ts=8 noet: */
@@ -0,0 +1,41 @@
+/*
+ * gedit-file-browser-git-status-provider.h
+ * This file is part of gedit
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifndef GEDIT_FILE_BROWSER_GIT_STATUS_PROVIDER_H
+#define GEDIT_FILE_BROWSER_GIT_STATUS_PROVIDER_H
+
+#include "gedit-file-browser-status-provider.h"
+
+G_BEGIN_DECLS
+
+#define GEDIT_TYPE_FILE_BROWSER_GIT_STATUS_PROVIDER	(gedit_file_browser_git_status_provider_get_type ())
+
+G_DECLARE_FINAL_TYPE (GeditFileBrowserGitStatusProvider, gedit_file_browser_git_status_provider,
+		      GEDIT, FILE_BROWSER_GIT_STATUS_PROVIDER, GObject)
+
+GeditFileBrowserStatusProvider	*gedit_file_browser_git_status_provider_new	(void);
+
+void	 _gedit_file_browser_git_status_provider_register_type	(GTypeModule *type_module);
+
+G_END_DECLS
+
+#endif /* GEDIT_FILE_BROWSER_GIT_STATUS_PROVIDER_H */
+
+/* ex:set ts=8 noet: */
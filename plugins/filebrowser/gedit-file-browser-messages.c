@@ -33,11 +33,14 @@ typedef struct
 {
 	GeditWindow  *window;
 	GeditMessage *message;
+
+	/* Announces all the rows of a signal at once, or NULL */
+	GeditMessage *batch_message;
 } MessageCacheData;
 
 typedef struct
 {
-	guint row_inserted_id;
+	guint rows_inserted_id;
 	guint before_row_deleted_id;
 	guint root_changed_id;
 	guint begin_loading_id;
@@ -155,6 +158,10 @@ static void
 message_cache_data_free (MessageCacheData *data)
 {
 	g_object_unref (data->message);
+
+	if (data->batch_message)
+		g_object_unref (data->batch_message);
+
 	g_slice_free (MessageCacheData, data);
 }
 
@@ -166,6 +173,7 @@ message_cache_data_new (GeditWindow  *window,
 
 	data->window = window;
 	data->message = message;
+	data->batch_message = NULL;
 
 	return data;
 }
@@ -465,6 +473,110 @@ custom_message_filter_func (GeditFileBrowserWidget *widget,
 	return !filter;
 }
 
+static inline void
+bitmap_set (guint8 *bitmap,
+	    guint   i)
+{
+	bitmap[i / 8] |= 1 << (i % 8);
+}
+
+static inline gboolean
+bitmap_get (const guint8 *bitmap,
+	    gsize         size,
+	    guint         i)
+{
+	return i / 8 < size && (bitmap[i / 8] & (1 << (i % 8))) != 0;
+}
+
+static void
+custom_message_batch_filter_func (GeditFileBrowserWidget *widget,
+				  GeditFileBrowserStore  *store,
+				  GtkTreeIter            *iters,
+				  guint                   n_iters,
+				  guint8                 *filtered,
+				  FilterData             *data)
+{
+	WindowData *wdata = get_window_data (data->window);
+	GPtrArray *uris = g_ptr_array_new_full (n_iters + 1, g_free);
+	guint *rows = g_new (guint, n_iters);
+	guint8 *directories = g_new0 (guint8, (n_iters + 7) / 8);
+	GBytes *bytes;
+	GBytes *result = NULL;
+	guint n_rows;
+
+	for (guint i = 0; i < n_iters; ++i)
+	{
+		GFile *location;
+		guint flags = 0;
+
+		gtk_tree_model_get (GTK_TREE_MODEL (store), &iters[i],
+				    GEDIT_FILE_BROWSER_STORE_COLUMN_LOCATION, &location,
+				    GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS, &flags,
+				    -1);
+
+		/* Same as for the single row filter */
+		if (!location || FILE_IS_DUMMY (flags))
+		{
+			bitmap_set (filtered, i);
+		}
+		else
+		{
+			if (FILE_IS_DIR (flags))
+				bitmap_set (directories, uris->len);
+
+			rows[uris->len] = i;
+			g_ptr_array_add (uris, g_file_get_uri (location));
+		}
+
+		if (location)
+			g_object_unref (location);
+	}
+
+	n_rows = uris->len;
+
+	if (n_rows > 0)
+	{
+		g_ptr_array_add (uris, NULL);
+		bytes = g_bytes_new (directories, (n_rows + 7) / 8);
+
+		g_object_set (data->message,
+		              "uris", uris->pdata,
+		              "directories", bytes,
+		              "filtered", NULL,
+		              NULL);
+
+		gedit_message_bus_send_message_sync (wdata->bus, data->message);
+		g_object_get (data->message, "filtered", &result, NULL);
+
+		if (result)
+		{
+			gsize size;
+			const guint8 *bits = g_bytes_get_data (result, &size);
+
+			for (guint row = 0; row < n_rows; ++row)
+			{
+				if (bitmap_get (bits, size, row))
+					bitmap_set (filtered, rows[row]);
+			}
+
+			g_bytes_unref (result);
+		}
+
+		/* Do not keep the rows around in the cached message */
+		g_object_set (data->message,
+		              "uris", NULL,
+		              "directories", NULL,
+		              "filtered", NULL,
+		              NULL);
+
+		g_bytes_unref (bytes);
+	}
+
+	g_ptr_array_unref (uris);
+	g_free (directories);
+	g_free (rows);
+}
+
 static void
 message_add_filter_cb (GeditMessageBus *bus,
                        GeditMessage    *message,
@@ -519,6 +631,56 @@ message_add_filter_cb (GeditMessageBus *bus,
 	filter_data->id = id;
 }
 
+static void
+message_add_batch_filter_cb (GeditMessageBus *bus,
+                             GeditMessage    *message,
+                             GeditWindow     *window)
+{
+	const gchar *object_path = NULL;
+	const gchar *method = NULL;
+	gulong id;
+	GeditMessage *cbmessage;
+	FilterData *filter_data;
+	WindowData *data;
+	GType message_type;
+
+	data = get_window_data (window);
+
+	object_path = gedit_message_get_object_path (message);
+	method = gedit_message_get_method (message);
+
+	message_type = gedit_message_bus_lookup (bus, object_path, method);
+
+	if (message_type == G_TYPE_INVALID)
+	{
+		return;
+	}
+
+	/* The filter gets the rows in uris and directories, and sets the
+	   bits of the rows it rejects in filtered */
+	if (!gedit_message_type_check (message_type, "uris", G_TYPE_STRV) ||
+	    !gedit_message_type_check (message_type, "directories", G_TYPE_BYTES) ||
+	    !gedit_message_type_check (message_type, "filtered", G_TYPE_BYTES))
+	{
+		return;
+	}
+
+	cbmessage = g_object_new (message_type,
+	                          "object-path", object_path,
+	                          "method", method,
+	                          NULL);
+
+	/* Register the custom filter on the widget */
+	filter_data = filter_data_new (window, cbmessage);
+
+	id = gedit_file_browser_widget_add_batch_filter (data->widget,
+	                                                 (GeditFileBrowserWidgetBatchFilterFunc)custom_message_batch_filter_func,
+	                                                 filter_data,
+	                                                 (GDestroyNotify)filter_data_free);
+
+	filter_data->id = id;
+}
+
 static void
 message_remove_filter_cb (GeditMessageBus *bus,
 		          GeditMessage    *message,
@@ -688,6 +850,11 @@ register_methods (GeditWindow            *window,
 	                            MESSAGE_OBJECT_PATH,
 	                            "add_filter");
 
+	gedit_message_bus_register (bus,
+	                            GEDIT_TYPE_FILE_BROWSER_MESSAGE_ADD_FILTER,
+	                            MESSAGE_OBJECT_PATH,
+	                            "add_batch_filter");
+
 	gedit_message_bus_register (bus,
 	                            GEDIT_TYPE_FILE_BROWSER_MESSAGE_ID,
 	                            MESSAGE_OBJECT_PATH,
@@ -748,6 +915,7 @@ register_methods (GeditWindow            *window,
 	BUS_CONNECT (bus, set_emblem, data);
 	BUS_CONNECT (bus, set_markup, data);
 	BUS_CONNECT (bus, add_filter, window);
+	BUS_CONNECT (bus, add_batch_filter, window);
 	BUS_CONNECT (bus, remove_filter, data);
 	BUS_CONNECT (bus, extend_context_menu, window);
 
@@ -767,24 +935,127 @@ register_methods (GeditWindow            *window,
 }
 
 static void
-store_row_inserted (GeditFileBrowserStore *store,
-		    GtkTreePath		  *path,
-		    GtkTreeIter           *iter,
-		    MessageCacheData      *data)
+store_rows_inserted (GeditFileBrowserStore *store,
+		     GtkTreeIter           *parent,
+		     GtkTreeIter           *iters,
+		     guint                  n_iters,
+		     MessageCacheData      *data)
 {
-	guint flags = 0;
+	WindowData *wdata = get_window_data (data->window);
+	gboolean send_rows;
+	gboolean send_batch;
+	GPtrArray *ids;
+	GPtrArray *uris;
+	guint8 *directories;
+	GBytes *bytes;
+
+	send_rows = gedit_message_bus_has_listeners (wdata->bus,
+	                                             MESSAGE_OBJECT_PATH,
+	                                             "inserted");
+
+	send_batch = gedit_message_bus_has_listeners (wdata->bus,
+	                                              MESSAGE_OBJECT_PATH,
+	                                              "inserted_batch");
+
+	/* Nobody to tell, so the rows do not need to be tracked either */
+	if (!send_rows && !send_batch)
+		return;
 
-	gtk_tree_model_get (GTK_TREE_MODEL (store), iter,
-			    GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS, &flags,
-			    -1);
+	ids = g_ptr_array_new_full (n_iters + 1, g_free);
+	uris = g_ptr_array_new_full (n_iters + 1, g_free);
+	directories = g_new0 (guint8, (n_iters + 7) / 8);
 
-	if (!FILE_IS_DUMMY (flags) && !FILE_IS_FILTERED (flags))
+	/* Only real rows are announced in bulk, so there is no need to
+	   check the flags of each of them */
+	for (guint i = 0; i < n_iters; ++i)
 	{
-		WindowData *wdata = get_window_data (data->window);
+		GtkTreePath *path;
+		GFile *location = NULL;
+		gchar *id = NULL;
+		gboolean is_directory = FALSE;
 
-		set_item_message (wdata, iter, path, data->message);
-		gedit_message_bus_send_message_sync (wdata->bus, data->message);
+		path = gtk_tree_model_get_path (GTK_TREE_MODEL (store), &iters[i]);
+
+		/* The row went away while the rows were being announced */
+		if (path == NULL)
+			continue;
+
+		if (send_rows)
+		{
+			set_item_message (wdata, &iters[i], path, data->message);
+
+			/* Must get these before the plugin can modify them */
+			g_object_get (data->message,
+			              "id", &id,
+			              "location", &location,
+			              "is-directory", &is_directory,
+			              NULL);
+
+			gedit_message_bus_send_message_sync (wdata->bus, data->message);
+		}
+		else
+		{
+			guint flags = 0;
+
+			gtk_tree_model_get (GTK_TREE_MODEL (store), &iters[i],
+			                    GEDIT_FILE_BROWSER_STORE_COLUMN_LOCATION, &location,
+			                    GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS, &flags,
+			                    -1);
+
+			if (location != NULL)
+			{
+				id = track_row (wdata, store, path, location);
+				is_directory = FILE_IS_DIR (flags);
+			}
+		}
+
+		if (location != NULL && send_batch)
+		{
+			if (is_directory)
+				bitmap_set (directories, uris->len);
+
+			g_ptr_array_add (ids, id);
+			g_ptr_array_add (uris, g_file_get_uri (location));
+		}
+		else
+		{
+			g_free (id);
+		}
+
+		g_clear_object (&location);
+
+		gtk_tree_path_free (path);
 	}
+
+	/* One more message with all the rows, the ids are the same as the
+	   ones of the single row messages */
+	if (uris->len > 0)
+	{
+		bytes = g_bytes_new (directories, (uris->len + 7) / 8);
+
+		g_ptr_array_add (ids, NULL);
+		g_ptr_array_add (uris, NULL);
+
+		g_object_set (data->batch_message,
+		              "ids", ids->pdata,
+		              "uris", uris->pdata,
+		              "directories", bytes,
+		              NULL);
+
+		gedit_message_bus_send_message_sync (wdata->bus, data->batch_message);
+
+		g_object_set (data->batch_message,
+		              "ids", NULL,
+		              "uris", NULL,
+		              "directories", NULL,
+		              NULL);
+
+		g_bytes_unref (bytes);
+	}
+
+	g_ptr_array_unref (ids);
+	g_ptr_array_unref (uris);
+	g_free (directories);
 }
 
 static void
@@ -883,6 +1154,7 @@ register_signals (GeditWindow            *window,
 	GeditFileBrowserStore *store;
 
 	GeditMessage *message;
+	MessageCacheData *cache;
 	WindowData *data;
 
 	/* Register signals */
@@ -906,6 +1178,11 @@ register_signals (GeditWindow            *window,
 	                            MESSAGE_OBJECT_PATH,
 	                            "inserted");
 
+	gedit_message_bus_register (bus,
+	                            GEDIT_TYPE_FILE_BROWSER_MESSAGE_ROWS,
+	                            MESSAGE_OBJECT_PATH,
+	                            "inserted_batch");
+
 	gedit_message_bus_register (bus,
 	                            GEDIT_TYPE_FILE_BROWSER_MESSAGE_ID_LOCATION,
 	                            MESSAGE_OBJECT_PATH,
@@ -919,12 +1196,18 @@ register_signals (GeditWindow            *window,
 	                        NULL);
 
 	data = get_window_data (window);
+	cache = message_cache_data_new (window, message);
 
-	data->row_inserted_id =
+	cache->batch_message = g_object_new (GEDIT_TYPE_FILE_BROWSER_MESSAGE_ROWS,
+	                                     "object-path", MESSAGE_OBJECT_PATH,
+	                                     "method", "inserted_batch",
+	                                     NULL);
+
+	data->rows_inserted_id =
 		g_signal_connect_data (store,
-		                       "row-inserted",
-		                       G_CALLBACK (store_row_inserted),
-		                       message_cache_data_new (window, message),
+		                       "rows-inserted",
+		                       G_CALLBACK (store_rows_inserted),
+		                       cache,
 		                       (GClosureNotify)message_cache_data_free,
 		                       0);
 
@@ -1029,7 +1312,7 @@ cleanup_signals (GeditWindow *window)
 
 	store = gedit_file_browser_widget_get_browser_store (data->widget);
 
-	g_signal_handler_disconnect (store, data->row_inserted_id);
+	g_signal_handler_disconnect (store, data->rows_inserted_id);
 	g_signal_handler_disconnect (store, data->before_row_deleted_id);
 	g_signal_handler_disconnect (store, data->root_changed_id);
 	g_signal_handler_disconnect (store, data->begin_loading_id);
@@ -1051,6 +1334,7 @@ gedit_file_browser_messages_unregister (GeditWindow *window)
 	BUS_DISCONNECT (bus, set_emblem, data);
 	BUS_DISCONNECT (bus, set_markup, data);
 	BUS_DISCONNECT (bus, add_filter, window);
+	BUS_DISCONNECT (bus, add_batch_filter, window);
 	BUS_DISCONNECT (bus, remove_filter, data);
 
 	BUS_DISCONNECT (bus, up, data);
@@ -34,6 +34,7 @@
 #include "gedit-file-browser-plugin.h"
 #include "gedit-file-browser-utils.h"
 #include "gedit-file-browser-error.h"
+#include "gedit-file-browser-git-status-provider.h"
 #include "gedit-file-browser-widget.h"
 #include "gedit-file-browser-messages.h"
 
@@ -46,6 +47,8 @@
 #define FILEBROWSER_FILTER_MODE		"filter-mode"
 #define FILEBROWSER_FILTER_PATTERN	"filter-pattern"
 #define FILEBROWSER_BINARY_PATTERNS	"binary-patterns"
+#define FILEBROWSER_CACHE_SIZE		"cache-size"
+#define FILEBROWSER_SHOW_STATUS		"show-status"
 
 #define NAUTILUS_BASE_SETTINGS		"org.gnome.nautilus.preferences"
 #define NAUTILUS_FALLBACK_SETTINGS	"org.gnome.gedit.plugins.filebrowser.nautilus"
@@ -119,6 +122,8 @@ G_DEFINE_DYNAMIC_TYPE_EXTENDED (GeditFileBrowserPlugin,
 				gedit_file_browser_enum_and_flag_register_type	(type_module);		\
 				_gedit_file_bookmarks_store_register_type	(type_module);		\
 				_gedit_file_browser_store_register_type		(type_module);		\
+				_gedit_file_browser_status_provider_register_type (type_module);	\
+				_gedit_file_browser_git_status_provider_register_type (type_module);	\
 				_gedit_file_browser_view_register_type		(type_module);		\
 				_gedit_file_browser_widget_register_type	(type_module);		\
 )
@@ -475,6 +480,7 @@ gedit_file_browser_plugin_activate (GeditWindowActivatable *activatable)
 	GeditFileBrowserPluginPrivate *priv;
 	GtkWidget *panel;
 	GeditFileBrowserStore *store;
+	gchar *git;
 
 	priv = plugin->priv;
 
@@ -545,6 +551,33 @@ gedit_file_browser_plugin_activate (GeditWindowActivatable *activatable)
 	                 FILEBROWSER_BINARY_PATTERNS,
 	                 G_SETTINGS_BIND_GET | G_SETTINGS_BIND_SET);
 
+	g_settings_bind (priv->settings,
+	                 FILEBROWSER_CACHE_SIZE,
+	                 store,
+	                 FILEBROWSER_CACHE_SIZE,
+	                 G_SETTINGS_BIND_GET);
+
+	g_settings_bind (priv->settings,
+	                 FILEBROWSER_SHOW_STATUS,
+	                 store,
+	                 FILEBROWSER_SHOW_STATUS,
+	                 G_SETTINGS_BIND_GET);
+
+	/* The status of the files in git repositories, shown when the
+	   show-status setting is on */
+	git = g_find_program_in_path ("git");
+
+	if (git != NULL)
+	{
+		GeditFileBrowserStatusProvider *provider;
+
+		provider = gedit_file_browser_git_status_provider_new ();
+		gedit_file_browser_store_set_status_provider (store, provider);
+
+		g_object_unref (provider);
+		g_free (git);
+	}
+
 	g_signal_connect (store,
 	                  "notify::virtual-root",
 	                  G_CALLBACK (on_virtual_root_changed_cb),
@@ -0,0 +1,120 @@
+/*
+ * gedit-file-browser-status-provider.c
+ * This file is part of gedit
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "gedit-file-browser-status-provider.h"
+
+static GType gedit_file_browser_status_provider_type_id = 0;
+
+enum
+{
+	CHANGED,
+	NUM_SIGNALS
+};
+
+static guint signals[NUM_SIGNALS] = { 0 };
+
+GType
+gedit_file_browser_status_provider_get_type (void)
+{
+	return gedit_file_browser_status_provider_type_id;
+}
+
+GHashTable *
+gedit_file_browser_status_provider_get_statuses (GeditFileBrowserStatusProvider  *provider,
+						 GFile                           *directory,
+						 GCancellable                    *cancellable,
+						 GError                         **error)
+{
+	GeditFileBrowserStatusProviderInterface *iface;
+
+	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STATUS_PROVIDER (provider), NULL);
+	g_return_val_if_fail (G_IS_FILE (directory), NULL);
+
+	iface = GEDIT_FILE_BROWSER_STATUS_PROVIDER_GET_IFACE (provider);
+	g_return_val_if_fail (iface->get_statuses != NULL, NULL);
+
+	return iface->get_statuses (provider, directory, cancellable, error);
+}
+
+/* Tells the provider about a change the store saw in a directory it
+   monitors, so that it can forget what it knows of it */
+void
+gedit_file_browser_status_provider_file_changed (GeditFileBrowserStatusProvider *provider,
+						 GFile                          *file)
+{
+	GeditFileBrowserStatusProviderInterface *iface;
+
+	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STATUS_PROVIDER (provider));
+	g_return_if_fail (G_IS_FILE (file));
+
+	iface = GEDIT_FILE_BROWSER_STATUS_PROVIDER_GET_IFACE (provider);
+
+	if (iface->file_changed != NULL)
+		iface->file_changed (provider, file);
+}
+
+/* Emitted by the provider, in the main thread, when statuses may have
+   changed without any change to the directories the store monitors.
+   The loaded directories are queried again */
+void
+gedit_file_browser_status_provider_changed (GeditFileBrowserStatusProvider *provider)
+{
+	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STATUS_PROVIDER (provider));
+
+	g_signal_emit (provider, signals[CHANGED], 0);
+}
+
+static void
+gedit_file_browser_status_provider_default_init (GeditFileBrowserStatusProviderInterface *iface)
+{
+	signals[CHANGED] =
+	    g_signal_new ("changed",
+			  G_TYPE_FROM_INTERFACE (iface),
+			  G_SIGNAL_RUN_LAST,
+			  G_STRUCT_OFFSET (GeditFileBrowserStatusProviderInterface, changed),
+			  NULL, NULL, NULL,
+			  G_TYPE_NONE, 0);
+}
+
+void
+_gedit_file_browser_status_provider_register_type (GTypeModule *type_module)
+{
+	const GTypeInfo info = {
+		sizeof (GeditFileBrowserStatusProviderInterface),
+		NULL, NULL,
+		(GClassInitFunc)gedit_file_browser_status_provider_default_init,
+		NULL, NULL, 0, 0, NULL, NULL
+	};
+	gboolean registered = gedit_file_browser_status_provider_type_id != 0;
+
+	/* The interface lives in the plugin like the other types, it is
+	   registered again each time the plugin is loaded */
+	gedit_file_browser_status_provider_type_id =
+		g_type_module_register_type (type_module,
+					     G_TYPE_INTERFACE,
+					     "GeditFileBrowserStatusProvider",
+					     &info,
+					     0);
+
+	if (!registered)
+		g_type_interface_add_prerequisite (gedit_file_browser_status_provider_type_id, G_TYPE_OBJECT);
+}
+
+/* ex:set ts=8 noet: */
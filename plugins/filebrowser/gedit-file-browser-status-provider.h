@@ -0,0 +1,85 @@
+/*
+ * gedit-file-browser-status-provider.h
+ * This file is part of gedit
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifndef GEDIT_FILE_BROWSER_STATUS_PROVIDER_H
+#define GEDIT_FILE_BROWSER_STATUS_PROVIDER_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define GEDIT_TYPE_FILE_BROWSER_STATUS_PROVIDER			(gedit_file_browser_status_provider_get_type ())
+#define GEDIT_FILE_BROWSER_STATUS_PROVIDER(obj)			(G_TYPE_CHECK_INSTANCE_CAST ((obj), GEDIT_TYPE_FILE_BROWSER_STATUS_PROVIDER, GeditFileBrowserStatusProvider))
+#define GEDIT_IS_FILE_BROWSER_STATUS_PROVIDER(obj)		(G_TYPE_CHECK_INSTANCE_TYPE ((obj), GEDIT_TYPE_FILE_BROWSER_STATUS_PROVIDER))
+#define GEDIT_FILE_BROWSER_STATUS_PROVIDER_GET_IFACE(obj)	(G_TYPE_INSTANCE_GET_INTERFACE ((obj), GEDIT_TYPE_FILE_BROWSER_STATUS_PROVIDER, GeditFileBrowserStatusProviderInterface))
+
+/* Ordered by importance, a directory gets the most important status of
+   the files below it */
+typedef enum
+{
+	GEDIT_FILE_BROWSER_STATUS_NONE = 0,
+	GEDIT_FILE_BROWSER_STATUS_UNTRACKED,
+	GEDIT_FILE_BROWSER_STATUS_ADDED,
+	GEDIT_FILE_BROWSER_STATUS_MODIFIED,
+	GEDIT_FILE_BROWSER_STATUS_CONFLICTED,
+	GEDIT_FILE_BROWSER_STATUS_NUM
+} GeditFileBrowserStatus;
+
+typedef struct _GeditFileBrowserStatusProvider		GeditFileBrowserStatusProvider;
+typedef struct _GeditFileBrowserStatusProviderInterface	GeditFileBrowserStatusProviderInterface;
+
+struct _GeditFileBrowserStatusProviderInterface
+{
+	GTypeInterface g_iface;
+
+	/* Called in a thread, once for the whole directory. Returns a
+	   table from the basenames of the children of directory to their
+	   GeditFileBrowserStatus, children without one can be left out */
+	GHashTable *(*get_statuses) (GeditFileBrowserStatusProvider  *provider,
+				     GFile                           *directory,
+				     GCancellable                    *cancellable,
+				     GError                         **error);
+
+	/* Optional, told about the changes to the monitored directories,
+	   in the main thread */
+	void        (*file_changed) (GeditFileBrowserStatusProvider  *provider,
+				     GFile                           *file);
+
+	/* Signals */
+	void        (*changed)      (GeditFileBrowserStatusProvider  *provider);
+};
+
+GType		 gedit_file_browser_status_provider_get_type		(void) G_GNUC_CONST;
+
+GHashTable	*gedit_file_browser_status_provider_get_statuses	(GeditFileBrowserStatusProvider  *provider,
+									 GFile                           *directory,
+									 GCancellable                    *cancellable,
+									 GError                         **error);
+void		 gedit_file_browser_status_provider_file_changed	(GeditFileBrowserStatusProvider  *provider,
+									 GFile                           *file);
+void		 gedit_file_browser_status_provider_changed		(GeditFileBrowserStatusProvider  *provider);
+
+void		_gedit_file_browser_status_provider_register_type	(GTypeModule                     *type_module);
+
+G_END_DECLS
+
+#endif /* GEDIT_FILE_BROWSER_STATUS_PROVIDER_H */
+
+/* ex:set ts=8 noet: */
@@ -40,12 +40,52 @@
 #define FILE_BROWSER_NODE_DIR(node)	((FileBrowserNodeDir *)(node))
 
 #define DIRECTORY_LOAD_ITEMS_PER_CALLBACK 100
+
+/* Time spent merging loaded nodes into the model per main loop
+   iteration, about half a frame at 60 fps */
+#define DIRECTORY_LOAD_MERGE_BUDGET_USEC 8000
+
+/* Monitor events are gathered for this long before being applied */
+#define MONITOR_EVENTS_COALESCE_MSEC 50
+
+/* Directories are listed with the content type guessed from the file
+   names only. Asking for the full content type, or for the icon which
+   is derived from it, means reading every file on some backends */
 #define STANDARD_ATTRIBUTE_TYPES G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
 				 G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
 			 	 G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
 				 G_FILE_ATTRIBUTE_STANDARD_NAME "," \
-				 G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE "," \
-				 G_FILE_ATTRIBUTE_STANDARD_ICON
+				 G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
+				 G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE "," \
+				 G_FILE_ATTRIBUTE_TIME_MODIFIED
+
+/* Looked up later, for the rows which are shown */
+#define CONTENT_ATTRIBUTE_TYPES G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+				G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE "," \
+				G_FILE_ATTRIBUTE_STANDARD_ICON
+
+/* Listings of recently loaded directories are kept in the user cache
+   dir, so that they can be shown while the directory is read again */
+#define SNAPSHOT_VARIANT_TYPE "(sa(ssubbsst))"
+#define SNAPSHOT_MAX_FILES 256
+
+/* Bulk deletes keep this many operations in flight, and take the rows
+   of the deleted files out of the model at most this often */
+#define DELETE_MAX_PARALLEL 8
+#define DELETE_FLUSH_INTERVAL_MSEC 100
+
+/* Directories which are going to be expanded again are enumerated this
+   many at a time, and their listings are dropped when they are not
+   loaded after this long */
+#define PREFETCH_MAX_PARALLEL 4
+#define PREFETCH_EXPIRE_SEC 10
+
+/* Number of files kept in loaded directories which are not shown */
+#define DETACHED_CACHE_SIZE 20000
+
+/* Rendered icons shared between the nodes, the cache starts over once
+   it has this many */
+#define ICON_CACHE_SIZE 256
 
 typedef struct _FileBrowserNode    FileBrowserNode;
 typedef struct _FileBrowserNodeDir FileBrowserNodeDir;
@@ -55,6 +95,8 @@ typedef struct _AsyncNode	   AsyncNode;
 typedef gint (*SortFunc) (FileBrowserNode *node1,
 			  FileBrowserNode *node2);
 
+/* A bulk delete or trash job, running up to DELETE_MAX_PARALLEL
+   operations at a time */
 struct _AsyncData
 {
 	GeditFileBrowserStore *model;
@@ -62,16 +104,104 @@ struct _AsyncData
 	gboolean               trash;
 	GList                 *files;
 	GList                 *iter;
+	guint                  n_files;
+	guint                  n_done;
+	guint                  n_running;
+
+	/* Files which could not be trashed, to be deleted instead */
+	GList                 *untrashable;
+
+	/* Files which could not be deleted, and why the first one could not */
+	guint                  n_failed;
+	GError                *error;
+
+	/* Files that are gone but still have a row, removed together */
+	GPtrArray             *deleted;
+	guint                  flush_id;
+
 	gboolean               removed;
 };
 
 struct _AsyncNode
 {
-	FileBrowserNodeDir *dir;
-	GCancellable       *cancellable;
-	GSList             *original_children;
+	GeditFileBrowserStore *model;
+	FileBrowserNodeDir    *dir;
+	GFile                 *file;
+	GCancellable          *cancellable;
+	GMainContext          *context;
+	gint                   ref_count;
+
+	/* LoadBatch prepared by the loading thread, waiting to be merged
+	   into the model */
+	GMutex                 lock;
+	GQueue                 batches;
+	gboolean               merging;
+	gboolean               enumerated;
+
+	/* GFileInfo of the directory when it was enumerated in advance */
+	gboolean               prefetched;
+	GList                 *infos;
 };
 
+/* A directory enumerated ahead of being loaded */
+typedef struct
+{
+	GeditFileBrowserStore *model;
+	GFile                 *location;
+	GCancellable          *cancellable;
+	guint                  depth;
+	gint                   ref_count;
+
+	GList                 *infos;
+	gboolean               done;
+
+	/* The directory which is loading, waiting for the listing */
+	FileBrowserNode       *waiting;
+	GCancellable          *waiting_cancellable;
+} Prefetch;
+
+typedef struct
+{
+	FileBrowserNode *node;
+	GFileInfo       *info;
+} LoadedNode;
+
+typedef struct
+{
+	/* Names of children to remove, and LoadedNode to add after that */
+	GPtrArray *removed;
+	GArray    *nodes;
+} LoadBatch;
+
+typedef struct
+{
+	GIcon     *gicon;
+	GdkPixbuf *emblem;
+	gint       size;
+} IconCacheKey;
+
+typedef enum
+{
+	MONITOR_EVENT_CREATED = 1,
+	MONITOR_EVENT_DELETED,
+	MONITOR_EVENT_REPLACED
+} MonitorEvent;
+
+typedef struct
+{
+	GeditFileBrowserStore *model;
+	FileBrowserNodeDir    *dir;
+	GCancellable          *cancellable;
+
+	/* Files to query and add, and the ones among them which replace
+	   an existing node */
+	GPtrArray             *files;
+	GPtrArray             *replaced;
+
+	/* LoadedNode for the files, filled in by the querying thread */
+	GArray                *batch;
+} MonitorQuery;
+
 typedef struct {
 	GeditFileBrowserStore *model;
 	GFile                 *virtual_root;
@@ -79,30 +209,110 @@ typedef struct {
 	GCancellable          *cancellable;
 } MountInfo;
 
+/* The filters whose verdict is cached on each node */
+typedef enum
+{
+	FILTER_VERDICT_BINARY  = 1 << 0,	/* Name matches a binary pattern */
+	FILTER_VERDICT_PATTERN = 1 << 1,	/* Name does not match the filter pattern */
+	FILTER_VERDICT_FUNC    = 1 << 2,	/* Rejected by the filter function */
+	FILTER_VERDICT_BATCH   = 1 << 3,	/* Rejected by the batch filter function */
+	FILTER_VERDICT_ALL     = FILTER_VERDICT_BINARY | FILTER_VERDICT_PATTERN |
+	                         FILTER_VERDICT_FUNC | FILTER_VERDICT_BATCH
+} FilterVerdict;
+
+/* Kinds of glob, cheapest first. Most patterns are a plain prefix or
+   suffix which do not need the full GPatternSpec machinery */
+typedef enum
+{
+	NAME_PATTERN_ANY,
+	NAME_PATTERN_LITERAL,
+	NAME_PATTERN_PREFIX,
+	NAME_PATTERN_SUFFIX,
+	NAME_PATTERN_CONTAINS,
+	NAME_PATTERN_GLOB
+} NamePatternKind;
+
+typedef struct {
+	NamePatternKind  kind;
+	FilterVerdict    verdict;
+	gchar           *text;
+	gsize            length;
+	GPatternSpec    *spec;
+} NamePattern;
+
 struct _FileBrowserNode
 {
+	/* Only directories keep their location, the location of other
+	   nodes is derived from their parent and basename when needed */
 	GFile           *file;
+	gchar           *basename;
+
 	guint            flags;
-	gchar           *icon_name;
+	const gchar     *icon_name;
 	gchar           *name;
+
+	/* Markup set through the model, the escaped name otherwise */
 	gchar           *markup;
 
+	/* Filename collation key of name, computed once for sorting */
+	gchar           *collate_key;
+
+	/* The icon is only looked up when first asked for, from gicon */
+	GIcon           *gicon;
 	GdkPixbuf       *icon;
 	GdkPixbuf       *emblem;
 
 	FileBrowserNode *parent;
-	gint             pos;
-	gboolean         inserted;
+	guint            index;
+	guint            inserted : 1;
+	guint            exposed : 1;
+
+	/* Set once the full content type is known or being looked up,
+	   until then flags and icon come from the guessed one */
+	guint            content_type_known : 1;
+
+	/* FilterVerdict bits that apply to this node */
+	guint            filtered_by : 4;
+
+	/* GeditFileBrowserStatus from the status provider */
+	guint            status : 3;
 };
 
 struct _FileBrowserNodeDir
 {
 	FileBrowserNode        node;
-	GSList                *children;
+	GPtrArray             *children;
+
+	/* Maps the basename of each child to its node, only created once
+	   there are children */
+	GHashTable            *children_by_name;
+
+	/* Binary indexed tree over children counting the exposed nodes */
+	guint                 *visible_index;
+	guint                  visible_index_size;
+	gboolean               visible_index_stale;
 
 	GCancellable          *cancellable;
 	GFileMonitor          *monitor;
 	GeditFileBrowserStore *model;
+
+	/* Link in the detached directories of the model, and the number
+	   of children it counts for there */
+	GList                 *detached_link;
+	guint                  detached_size;
+
+	/* Monitor events waiting to be applied, GFile -> MonitorEvent */
+	GHashTable            *monitor_events;
+	guint                  monitor_events_id;
+	GCancellable          *monitor_cancellable;
+
+	/* Statuses of the children from the last query of the status
+	   provider, basename -> GeditFileBrowserStatus, and the query which
+	   is scheduled or running */
+	GHashTable            *statuses;
+	guint                  statuses_id;
+	GCancellable          *statuses_cancellable;
+	gboolean               statuses_stale;
 };
 
 struct _GeditFileBrowserStorePrivate
@@ -115,18 +325,63 @@ struct _GeditFileBrowserStorePrivate
 	GeditFileBrowserStoreFilterFunc   filter_func;
 	gpointer                          filter_user_data;
 
+	GeditFileBrowserStoreBatchFilterFunc batch_filter_func;
+	gpointer                          batch_filter_user_data;
+
 	gchar                           **binary_patterns;
-	GPtrArray                        *binary_pattern_specs;
+	gchar                            *filter_pattern;
+
+	/* The binary patterns and the filter pattern compiled together,
+	   as NamePattern sorted by kind */
+	GArray                           *name_patterns;
 
 	SortFunc                          sort_func;
 
+	/* Shared instances of the icons of the nodes, and the pixbufs
+	   rendered from them, keyed by IconCacheKey */
+	GHashTable                       *gicons;
+	GHashTable                       *icon_cache;
+	GtkIconTheme                     *icon_theme;
+
+	/* Icons of the content types, for files listed without one */
+	GHashTable                       *content_type_icons;
+
+	/* Files to look up the full content type of, and the lookup in
+	   progress */
+	GPtrArray                        *content_type_queue;
+	guint                             content_type_queue_id;
+	GCancellable                     *content_type_cancellable;
+
+	/* Every directory in the model by location. Other nodes are found
+	   through the name index of their directory */
+	GHashTable                       *locations;
+
+	/* Loaded directories which are not shown, the ones shown most
+	   recently first, and the number of children they hold together */
+	GQueue                            detached;
+	guint                             detached_size;
+	guint                             cache_size;
+
 	GSList                           *async_handles;
 	MountInfo                        *mount_info;
+
+	/* Prefetch of the directories to expand, keyed by location, and
+	   the ones not enumerated yet */
+	GHashTable                       *prefetches;
+	GQueue                            prefetch_queue;
+	guint                             prefetch_running;
+	GCancellable                     *prefetch_cancellable;
+	guint                             prefetch_expire_id;
+
+	/* Computes the statuses of the files in a directory, and the
+	   emblems shown for them */
+	GeditFileBrowserStatusProvider   *status_provider;
+	gboolean                          show_status;
+	GdkPixbuf                        *status_emblems[GEDIT_FILE_BROWSER_STATUS_NUM];
 };
 
 static FileBrowserNode *model_find_node 		    (GeditFileBrowserStore  *model,
-							     FileBrowserNode        *node,
-							     GFile                  *uri);
+							     GFile                  *file);
 static void model_remove_node                               (GeditFileBrowserStore  *model,
 							     FileBrowserNode        *node,
 							     GtkTreePath            *path,
@@ -189,10 +444,30 @@ static gint model_sort_default                              (FileBrowserNode
 							     FileBrowserNode        *node2);
 static void model_check_dummy                               (GeditFileBrowserStore  *model,
 							     FileBrowserNode        *node);
-static void next_files_async 				    (GFileEnumerator        *enumerator,
-							     AsyncNode              *async);
+static void file_browser_node_dir_clear_monitor_events      (FileBrowserNodeDir     *dir);
+static void schedule_monitor_events                         (FileBrowserNodeDir     *dir);
+static void file_browser_node_dir_clear_statuses            (FileBrowserNodeDir     *dir);
+static void schedule_statuses                               (GeditFileBrowserStore  *model,
+							     FileBrowserNode        *node);
+static void on_status_provider_changed                      (GeditFileBrowserStatusProvider *provider,
+							     GeditFileBrowserStore  *model);
+static void on_icon_theme_changed                           (GtkIconTheme           *icon_theme,
+							     GeditFileBrowserStore  *model);
+static GdkPixbuf *model_node_get_icon                        (GeditFileBrowserStore  *model,
+							     FileBrowserNode        *node);
+static GFile *file_browser_node_get_file                    (FileBrowserNode        *node);
+static void name_pattern_clear                              (NamePattern            *pattern);
+static void model_nodes_update_batch_verdicts               (GeditFileBrowserStore  *model,
+							     FileBrowserNode       **nodes,
+							     guint                   n_nodes);
 
 static void delete_files                                    (AsyncData              *data);
+static void model_load_directory                            (GeditFileBrowserStore  *model,
+							     FileBrowserNode        *node);
+static void model_cancel_prefetch                           (GeditFileBrowserStore  *model);
+static void model_resolve_content_type                      (GeditFileBrowserStore  *model,
+							     FileBrowserNode        *node);
+static void model_cancel_content_types                      (GeditFileBrowserStore  *model);
 
 G_DEFINE_DYNAMIC_TYPE_EXTENDED (GeditFileBrowserStore, gedit_file_browser_store,
 				G_TYPE_OBJECT,
@@ -210,7 +485,9 @@ enum {
 	PROP_ROOT,
 	PROP_VIRTUAL_ROOT,
 	PROP_FILTER_MODE,
-	PROP_BINARY_PATTERNS
+	PROP_BINARY_PATTERNS,
+	PROP_CACHE_SIZE,
+	PROP_SHOW_STATUS
 };
 
 /* Signals */
@@ -225,6 +502,8 @@ enum
 	END_REFRESH,
 	UNLOAD,
 	BEFORE_ROW_DELETED,
+	ROWS_INSERTED,
+	DELETE_PROGRESS,
 	NUM_SIGNALS
 };
 
@@ -241,6 +520,26 @@ cancel_mount_operation (GeditFileBrowserStore *obj)
 	}
 }
 
+static void
+gedit_file_browser_store_dispose (GObject *object)
+{
+	GeditFileBrowserStore *obj = GEDIT_FILE_BROWSER_STORE (object);
+
+	/* Stop reading ahead while the directories waiting for it are
+	   still around */
+	model_cancel_prefetch (obj);
+
+	if (obj->priv->icon_theme != NULL)
+	{
+		g_signal_handlers_disconnect_by_func (obj->priv->icon_theme,
+						      on_icon_theme_changed,
+						      obj);
+		g_clear_object (&obj->priv->icon_theme);
+	}
+
+	G_OBJECT_CLASS (gedit_file_browser_store_parent_class)->dispose (object);
+}
+
 static void
 gedit_file_browser_store_finalize (GObject *object)
 {
@@ -249,11 +548,9 @@ gedit_file_browser_store_finalize (GObject *object)
 	/* Free all the nodes */
 	file_browser_node_free (obj, obj->priv->root);
 
-	if (obj->priv->binary_patterns != NULL)
-	{
-		g_strfreev (obj->priv->binary_patterns);
-		g_ptr_array_unref (obj->priv->binary_pattern_specs);
-	}
+	g_strfreev (obj->priv->binary_patterns);
+	g_free (obj->priv->filter_pattern);
+	g_array_unref (obj->priv->name_patterns);
 
 	/* Cancel any asynchronous operations */
 	for (GSList *item = obj->priv->async_handles; item; item = item->next)
@@ -261,10 +558,34 @@ gedit_file_browser_store_finalize (GObject *object)
 		AsyncData *data = (AsyncData *)(item->data);
 		g_cancellable_cancel (data->cancellable);
 
+		if (data->flush_id != 0)
+		{
+			g_source_remove (data->flush_id);
+			data->flush_id = 0;
+		}
+
 		data->removed = TRUE;
 	}
 
 	cancel_mount_operation (obj);
+	model_cancel_content_types (obj);
+
+	if (obj->priv->status_provider != NULL)
+	{
+		g_signal_handlers_disconnect_by_func (obj->priv->status_provider,
+						      on_status_provider_changed,
+						      obj);
+		g_clear_object (&obj->priv->status_provider);
+	}
+
+	for (guint i = 0; i < GEDIT_FILE_BROWSER_STATUS_NUM; ++i)
+		g_clear_object (&obj->priv->status_emblems[i]);
+
+	g_ptr_array_unref (obj->priv->content_type_queue);
+	g_hash_table_unref (obj->priv->content_type_icons);
+	g_hash_table_unref (obj->priv->locations);
+	g_hash_table_unref (obj->priv->icon_cache);
+	g_hash_table_unref (obj->priv->gicons);
 
 	g_slist_free (obj->priv->async_handles);
 	G_OBJECT_CLASS (gedit_file_browser_store_parent_class)->finalize (object);
@@ -277,7 +598,7 @@ set_gvalue_from_node (GValue          *value,
 	if (node == NULL)
 		g_value_set_object (value, NULL);
 	else
-		g_value_set_object (value, node->file);
+		g_value_take_object (value, file_browser_node_get_file (node));
 }
 
 static void
@@ -302,6 +623,12 @@ gedit_file_browser_store_get_property (GObject    *object,
 		case PROP_BINARY_PATTERNS:
 			g_value_set_boxed (value, obj->priv->binary_patterns);
 			break;
+		case PROP_CACHE_SIZE:
+			g_value_set_uint (value, obj->priv->cache_size);
+			break;
+		case PROP_SHOW_STATUS:
+			g_value_set_boolean (value, obj->priv->show_status);
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 			break;
@@ -327,6 +654,12 @@ gedit_file_browser_store_set_property (GObject      *object,
 		case PROP_BINARY_PATTERNS:
 			gedit_file_browser_store_set_binary_patterns (obj, g_value_get_boxed (value));
 			break;
+		case PROP_CACHE_SIZE:
+			gedit_file_browser_store_set_cache_size (obj, g_value_get_uint (value));
+			break;
+		case PROP_SHOW_STATUS:
+			gedit_file_browser_store_set_show_status (obj, g_value_get_boolean (value));
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 			break;
@@ -338,6 +671,7 @@ gedit_file_browser_store_class_init (GeditFileBrowserStoreClass *klass)
 {
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
+	object_class->dispose = gedit_file_browser_store_dispose;
 	object_class->finalize = gedit_file_browser_store_finalize;
 	object_class->get_property = gedit_file_browser_store_get_property;
 	object_class->set_property = gedit_file_browser_store_set_property;
@@ -371,6 +705,22 @@ gedit_file_browser_store_class_init (GeditFileBrowserStoreClass *klass)
 					 		     G_TYPE_STRV,
 					 		     G_PARAM_READWRITE));
 
+	g_object_class_install_property (object_class, PROP_CACHE_SIZE,
+					 g_param_spec_uint ("cache-size",
+					 		    "Cache Size",
+					 		    "The number of files kept loaded in directories which are not shown",
+					 		    0,
+					 		    G_MAXUINT,
+					 		    DETACHED_CACHE_SIZE,
+					 		    G_PARAM_READWRITE));
+
+	g_object_class_install_property (object_class, PROP_SHOW_STATUS,
+					 g_param_spec_boolean ("show-status",
+					 		       "Show Status",
+					 		       "Whether the statuses of the files are shown as emblems",
+					 		       FALSE,
+					 		       G_PARAM_READWRITE));
+
 	model_signals[BEGIN_LOADING] =
 	    g_signal_new ("begin-loading",
 			  G_OBJECT_CLASS_TYPE (object_class),
@@ -433,6 +783,25 @@ gedit_file_browser_store_class_init (GeditFileBrowserStoreClass *klass)
 			  NULL, NULL, NULL,
 			  G_TYPE_NONE, 1,
 			  GTK_TYPE_TREE_PATH | G_SIGNAL_TYPE_STATIC_SCOPE);
+	model_signals[ROWS_INSERTED] =
+	    g_signal_new ("rows-inserted",
+			  G_OBJECT_CLASS_TYPE (object_class),
+			  G_SIGNAL_RUN_LAST,
+			  G_STRUCT_OFFSET (GeditFileBrowserStoreClass, rows_inserted),
+			  NULL, NULL, NULL,
+			  G_TYPE_NONE, 3,
+			  GTK_TYPE_TREE_ITER | G_SIGNAL_TYPE_STATIC_SCOPE,
+			  G_TYPE_POINTER,
+			  G_TYPE_UINT);
+	model_signals[DELETE_PROGRESS] =
+	    g_signal_new ("delete-progress",
+			  G_OBJECT_CLASS_TYPE (object_class),
+			  G_SIGNAL_RUN_LAST,
+			  G_STRUCT_OFFSET (GeditFileBrowserStoreClass, delete_progress),
+			  NULL, NULL, NULL,
+			  G_TYPE_NONE, 2,
+			  G_TYPE_UINT,
+			  G_TYPE_UINT);
 }
 
 static void
@@ -466,9 +835,69 @@ gedit_file_browser_store_drag_source_init (GtkTreeDragSourceIface *iface)
 	iface->drag_data_get = gedit_file_browser_store_drag_data_get;
 }
 
+static guint
+icon_cache_key_hash (gconstpointer v)
+{
+	const IconCacheKey *key = v;
+
+	return (key->gicon != NULL ? g_icon_hash (key->gicon) : 0) ^
+	       g_direct_hash (key->emblem) ^
+	       key->size;
+}
+
+static gboolean
+icon_cache_key_equal (gconstpointer a,
+		      gconstpointer b)
+{
+	const IconCacheKey *key1 = a;
+	const IconCacheKey *key2 = b;
+
+	/* The icons are interned, so comparing them is enough */
+	return key1->gicon == key2->gicon &&
+	       key1->emblem == key2->emblem &&
+	       key1->size == key2->size;
+}
+
+static void
+icon_cache_key_free (IconCacheKey *key)
+{
+	g_clear_object (&key->gicon);
+	g_clear_object (&key->emblem);
+	g_slice_free (IconCacheKey, key);
+}
+
+/* The icons are rendered again from the new theme when the rows are
+   drawn next, which the theme change itself causes */
+static void
+on_icon_theme_changed (GtkIconTheme          *icon_theme,
+		       GeditFileBrowserStore *model)
+{
+	GHashTableIter iter;
+	FileBrowserNode *node;
+
+	g_hash_table_remove_all (model->priv->icon_cache);
+
+	for (guint i = 0; i < GEDIT_FILE_BROWSER_STATUS_NUM; ++i)
+		g_clear_object (&model->priv->status_emblems[i]);
+
+	g_hash_table_iter_init (&iter, model->priv->locations);
+
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&node))
+	{
+		FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
+
+		g_clear_object (&node->icon);
+
+		for (guint i = 0; i < dir->children->len; ++i)
+			g_clear_object (&((FileBrowserNode *)g_ptr_array_index (dir->children, i))->icon);
+	}
+}
+
 static void
 gedit_file_browser_store_init (GeditFileBrowserStore *obj)
 {
+	GdkScreen *screen;
+
 	obj->priv = gedit_file_browser_store_get_instance_private (obj);
 
 	obj->priv->column_types[GEDIT_FILE_BROWSER_STORE_COLUMN_LOCATION] = G_TYPE_FILE;
@@ -482,6 +911,37 @@ gedit_file_browser_store_init (GeditFileBrowserStore *obj)
 	/* Default filter mode is hiding the hidden files */
 	obj->priv->filter_mode = gedit_file_browser_store_filter_mode_get_default ();
 	obj->priv->sort_func = model_sort_default;
+
+	obj->priv->name_patterns = g_array_new (FALSE, FALSE, sizeof (NamePattern));
+	g_array_set_clear_func (obj->priv->name_patterns, (GDestroyNotify)name_pattern_clear);
+
+	obj->priv->gicons = g_hash_table_new_full (g_icon_hash,
+						   (GEqualFunc)g_icon_equal,
+						   g_object_unref,
+						   NULL);
+	obj->priv->icon_cache = g_hash_table_new_full (icon_cache_key_hash,
+						       icon_cache_key_equal,
+						       (GDestroyNotify)icon_cache_key_free,
+						       g_object_unref);
+	obj->priv->content_type_icons = g_hash_table_new_full (g_str_hash,
+							       g_str_equal,
+							       g_free,
+							       g_object_unref);
+	obj->priv->content_type_queue = g_ptr_array_new_with_free_func (g_object_unref);
+	obj->priv->locations = g_hash_table_new (g_file_hash, (GEqualFunc)g_file_equal);
+	obj->priv->cache_size = DETACHED_CACHE_SIZE;
+
+	/* There is no screen when the store is used without a display */
+	screen = gdk_screen_get_default ();
+
+	if (screen != NULL)
+	{
+		obj->priv->icon_theme = g_object_ref (gtk_icon_theme_get_for_screen (screen));
+		g_signal_connect (obj->priv->icon_theme,
+				  "changed",
+				  G_CALLBACK (on_icon_theme_changed),
+				  obj);
+	}
 }
 
 static gboolean
@@ -523,183 +983,497 @@ model_node_visibility (GeditFileBrowserStore *model,
 	return !NODE_IS_FILTERED (node);
 }
 
+/* Visible position index
+ *
+ * The children of a directory are kept in an array, in the order in which
+ * they are presented, and every child knows its index in that array. On top
+ * of the array each directory maintains a binary indexed (Fenwick) tree
+ * counting the children which are currently exposed as rows of the model,
+ * so that converting between a child and its row number costs O(log n)
+ * instead of a scan over all the siblings.
+ *
+ * A change in the exposure of a single child is applied to the tree
+ * directly. Appending or removing the last child updates the tree in place
+ * as well, any other structural change marks the tree as stale and it is
+ * rebuilt, in linear time, on the next lookup.
+ */
 static gboolean
-model_node_inserted (GeditFileBrowserStore *model,
-		     FileBrowserNode       *node)
+file_browser_node_is_exposed (FileBrowserNode *node)
 {
-	return node == model->priv->virtual_root ||
-	       (model_node_visibility (model, node) && node->inserted);
-}
-
-/* Interface implementation */
+	if (!node->inserted)
+		return FALSE;
 
-static GtkTreeModelFlags
-gedit_file_browser_store_get_flags (GtkTreeModel *tree_model)
-{
-	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model), (GtkTreeModelFlags) 0);
+	if (NODE_IS_DUMMY (node))
+		return !NODE_IS_HIDDEN (node);
 
-	return GTK_TREE_MODEL_ITERS_PERSIST;
+	return !NODE_IS_FILTERED (node);
 }
 
-static gint
-gedit_file_browser_store_get_n_columns (GtkTreeModel *tree_model)
+static void
+visible_index_add (FileBrowserNodeDir *dir,
+		   guint               index,
+		   gint                delta)
 {
-	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model), 0);
-
-	return GEDIT_FILE_BROWSER_STORE_COLUMN_NUM;
+	for (guint i = index + 1; i <= dir->children->len; i += i & -i)
+		dir->visible_index[i] += delta;
 }
 
-static GType
-gedit_file_browser_store_get_column_type (GtkTreeModel *tree_model,
-					  gint          idx)
+/* Returns the number of exposed nodes among the first n children */
+static guint
+visible_index_count (FileBrowserNodeDir *dir,
+		     guint               n)
 {
-	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model), G_TYPE_INVALID);
-	g_return_val_if_fail (idx < GEDIT_FILE_BROWSER_STORE_COLUMN_NUM && idx >= 0, G_TYPE_INVALID);
+	guint count = 0;
 
-	return GEDIT_FILE_BROWSER_STORE (tree_model)->priv->column_types[idx];
+	for (guint i = n; i > 0; i -= i & -i)
+		count += dir->visible_index[i];
+
+	return count;
 }
 
-static gboolean
-gedit_file_browser_store_get_iter (GtkTreeModel *tree_model,
-				   GtkTreeIter  *iter,
-				   GtkTreePath  *path)
+static void
+visible_index_reserve (FileBrowserNodeDir *dir)
 {
-	GeditFileBrowserStore *model;
-	FileBrowserNode *node;
-	gint *indices, depth;
+	if (dir->visible_index_size < dir->children->len + 1)
+	{
+		dir->visible_index_size = MAX (dir->children->len + 1, dir->visible_index_size * 2);
+		dir->visible_index = g_renew (guint, dir->visible_index, dir->visible_index_size);
+	}
+}
 
-	g_assert (GEDIT_IS_FILE_BROWSER_STORE (tree_model));
-	g_assert (path != NULL);
+static void
+visible_index_rebuild (FileBrowserNodeDir *dir)
+{
+	guint len = dir->children->len;
 
-	model = GEDIT_FILE_BROWSER_STORE (tree_model);
-	indices = gtk_tree_path_get_indices (path);
-	depth = gtk_tree_path_get_depth (path);
-	node = model->priv->virtual_root;
+	visible_index_reserve (dir);
+	dir->visible_index[0] = 0;
 
-	for (guint i = 0; i < depth; ++i)
+	for (guint i = 1; i <= len; ++i)
 	{
-		GSList *item;
-		gint num = 0;
-
-		if (node == NULL)
-			return FALSE;
+		FileBrowserNode *child = g_ptr_array_index (dir->children, i - 1);
 
-		if (!NODE_IS_DIR (node))
-			return FALSE;
-
-		for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-		{
-			FileBrowserNode *child = (FileBrowserNode *)(item->data);
+		child->exposed = file_browser_node_is_exposed (child);
+		dir->visible_index[i] = child->exposed ? 1 : 0;
+	}
 
-			if (model_node_inserted (model, child))
-			{
-				if (num == indices[i])
-					break;
+	for (guint i = 1; i <= len; ++i)
+	{
+		guint parent = i + (i & -i);
 
-				num++;
-			}
-		}
+		if (parent <= len)
+			dir->visible_index[parent] += dir->visible_index[i];
+	}
 
-		if (item == NULL)
-			return FALSE;
+	dir->visible_index_stale = FALSE;
+}
 
-		node = (FileBrowserNode *)(item->data);
-	}
+static void
+visible_index_ensure (FileBrowserNodeDir *dir)
+{
+	if (dir->visible_index_stale)
+		visible_index_rebuild (dir);
+}
 
-	iter->user_data = node;
-	iter->user_data2 = NULL;
-	iter->user_data3 = NULL;
+static guint
+file_browser_node_dir_n_exposed (FileBrowserNodeDir *dir)
+{
+	visible_index_ensure (dir);
+	return visible_index_count (dir, dir->children->len);
+}
 
-	return node != NULL;
+/* Returns the number of exposed siblings in front of child */
+static guint
+file_browser_node_dir_position (FileBrowserNodeDir *dir,
+				FileBrowserNode    *child)
+{
+	visible_index_ensure (dir);
+	return visible_index_count (dir, child->index);
 }
 
-static GtkTreePath *
-gedit_file_browser_store_get_path_real (GeditFileBrowserStore *model,
-					FileBrowserNode       *node)
+/* Returns the nth exposed child of dir, or NULL */
+static FileBrowserNode *
+file_browser_node_dir_nth_exposed (FileBrowserNodeDir *dir,
+				   guint               n)
 {
-	GtkTreePath *path = gtk_tree_path_new ();
-	gint num = 0;
+	guint len = dir->children->len;
+	guint pos = 0;
+	guint step = 1;
 
-	while (node != model->priv->virtual_root)
+	visible_index_ensure (dir);
+
+	while (step <= len / 2)
+		step <<= 1;
+
+	for (; step > 0; step >>= 1)
 	{
-		if (node->parent == NULL)
+		if (pos + step <= len && dir->visible_index[pos + step] <= n)
 		{
-			gtk_tree_path_free (path);
-			return NULL;
+			pos += step;
+			n -= dir->visible_index[pos];
 		}
+	}
 
-		num = 0;
+	return pos < len ? g_ptr_array_index (dir->children, pos) : NULL;
+}
 
-		for (GSList *item = FILE_BROWSER_NODE_DIR (node->parent)->children; item; item = item->next)
-		{
-			FileBrowserNode *check = (FileBrowserNode *)(item->data);
+/* Must be called whenever the inserted state or the visibility flags of a
+   node which is part of its parent's children change */
+static void
+file_browser_node_update_exposed (FileBrowserNode *node)
+{
+	FileBrowserNodeDir *dir;
+	gboolean exposed = file_browser_node_is_exposed (node);
 
-			if (model_node_visibility (model, check) && (check == node || check->inserted))
-			{
-				if (check == node)
-				{
-					gtk_tree_path_prepend_index (path, num);
-					break;
-				}
+	if (exposed == node->exposed)
+		return;
 
-				++num;
-			}
-			else if (check == node)
-			{
-				if (NODE_IS_DUMMY (node))
-					g_warning ("Dummy not visible???");
+	node->exposed = exposed;
 
-				gtk_tree_path_free (path);
-				return NULL;
-			}
-		}
+	if (node->parent == NULL)
+		return;
 
-		node = node->parent;
-	}
+	dir = FILE_BROWSER_NODE_DIR (node->parent);
 
-	return path;
+	if (!dir->visible_index_stale)
+		visible_index_add (dir, node->index, exposed ? 1 : -1);
 }
 
-static GtkTreePath *
-gedit_file_browser_store_get_path (GtkTreeModel *tree_model,
-				   GtkTreeIter  *iter)
+/* The location of a directory is its key in the model, so it has to be
+   unindexed before its location changes */
+static void
+model_index_location (GeditFileBrowserStore *model,
+		      FileBrowserNode       *node)
 {
-	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model), NULL);
-	g_return_val_if_fail (iter != NULL, NULL);
-	g_return_val_if_fail (iter->user_data != NULL, NULL);
+	if (node->file != NULL)
+		g_hash_table_replace (model->priv->locations, node->file, node);
+}
 
-	return gedit_file_browser_store_get_path_real (GEDIT_FILE_BROWSER_STORE (tree_model),
-						       (FileBrowserNode *)(iter->user_data));
+static void
+model_unindex_location (GeditFileBrowserStore *model,
+			FileBrowserNode       *node)
+{
+	/* Only drop the entry when it still refers to this node */
+	if (node->file != NULL && g_hash_table_lookup (model->priv->locations, node->file) == node)
+		g_hash_table_remove (model->priv->locations, node->file);
 }
 
+/* The basename of the child is used as the key, so the child has to be
+   unindexed before its basename changes */
 static void
-gedit_file_browser_store_get_value (GtkTreeModel *tree_model,
-				    GtkTreeIter  *iter,
-				    gint          column,
-				    GValue       *value)
+file_browser_node_dir_index_name (FileBrowserNodeDir *dir,
+				  FileBrowserNode    *child)
 {
-	FileBrowserNode *node;
+	model_index_location (dir->model, child);
 
-	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model));
-	g_return_if_fail (iter != NULL);
-	g_return_if_fail (iter->user_data != NULL);
+	if (child->basename == NULL)
+		return;
 
-	node = (FileBrowserNode *)(iter->user_data);
+	if (dir->children_by_name == NULL)
+		dir->children_by_name = g_hash_table_new (g_str_hash, g_str_equal);
 
-	g_value_init (value, GEDIT_FILE_BROWSER_STORE (tree_model)->priv->column_types[column]);
+	g_hash_table_replace (dir->children_by_name, child->basename, child);
+}
 
-	switch (column)
-	{
-		case GEDIT_FILE_BROWSER_STORE_COLUMN_LOCATION:
-			set_gvalue_from_node (value, node);
-			break;
-		case GEDIT_FILE_BROWSER_STORE_COLUMN_MARKUP:
-			g_value_set_string (value, node->markup);
-			break;
+static void
+file_browser_node_dir_unindex_name (FileBrowserNodeDir *dir,
+				    FileBrowserNode    *child)
+{
+	model_unindex_location (dir->model, child);
+
+	if (child->basename == NULL || dir->children_by_name == NULL)
+		return;
+
+	/* Only drop the entry when it still refers to this child */
+	if (g_hash_table_lookup (dir->children_by_name, child->basename) == child)
+		g_hash_table_remove (dir->children_by_name, child->basename);
+}
+
+/* Returns the child of dir called name, or NULL */
+static FileBrowserNode *
+file_browser_node_dir_find_name (FileBrowserNodeDir *dir,
+				 const gchar        *name)
+{
+	if (dir->children_by_name == NULL)
+		return NULL;
+
+	return g_hash_table_lookup (dir->children_by_name, name);
+}
+
+/* The status of child from the last query of dir */
+static GeditFileBrowserStatus
+file_browser_node_dir_get_status (FileBrowserNodeDir *dir,
+				  FileBrowserNode    *child)
+{
+	if (dir->statuses == NULL || child->basename == NULL)
+		return GEDIT_FILE_BROWSER_STATUS_NONE;
+
+	return GPOINTER_TO_UINT (g_hash_table_lookup (dir->statuses, child->basename));
+}
+
+/* Whether node is located at file, without building the location of
+   nodes that do not keep one */
+static gboolean
+file_browser_node_is_file (FileBrowserNode *node,
+			   GFile           *file)
+{
+	gchar *name;
+	gboolean ret;
+
+	if (node->file != NULL)
+		return g_file_equal (node->file, file);
+
+	if (node->basename == NULL || node->parent == NULL)
+		return FALSE;
+
+	name = g_file_get_basename (file);
+	ret = g_strcmp0 (name, node->basename) == 0 &&
+	      g_file_has_parent (file, node->parent->file);
+	g_free (name);
+
+	return ret;
+}
+
+/* Returns the child of dir for file, or NULL */
+static FileBrowserNode *
+file_browser_node_dir_find_file (FileBrowserNodeDir *dir,
+				 GFile              *file)
+{
+	FileBrowserNode *node;
+	gchar *name = g_file_get_basename (file);
+
+	node = name != NULL ? file_browser_node_dir_find_name (dir, name) : NULL;
+	g_free (name);
+
+	/* The name alone is not enough, file might not be inside dir */
+	if (node != NULL && !g_file_has_parent (file, ((FileBrowserNode *)dir)->file))
+		return NULL;
+
+	return node;
+}
+
+static void
+file_browser_node_dir_insert (FileBrowserNodeDir *dir,
+			      FileBrowserNode    *child,
+			      guint               index)
+{
+	file_browser_node_dir_index_name (dir, child);
+	g_ptr_array_insert (dir->children, index, child);
+	child->exposed = file_browser_node_is_exposed (child);
+
+	if (index == dir->children->len - 1)
+	{
+		child->index = index;
+
+		/* Appending only requires filling in the new tree slot */
+		if (!dir->visible_index_stale)
+		{
+			guint i = index + 1;
+
+			visible_index_reserve (dir);
+			dir->visible_index[i] = (child->exposed ? 1 : 0) +
+			                        visible_index_count (dir, i - 1) -
+			                        visible_index_count (dir, i - (i & -i));
+		}
+	}
+	else
+	{
+		for (guint i = index; i < dir->children->len; ++i)
+			((FileBrowserNode *)g_ptr_array_index (dir->children, i))->index = i;
+
+		dir->visible_index_stale = TRUE;
+	}
+}
+
+static void
+file_browser_node_dir_remove (FileBrowserNodeDir *dir,
+			      FileBrowserNode    *child)
+{
+	guint index = child->index;
+
+	g_return_if_fail (index < dir->children->len &&
+	                  g_ptr_array_index (dir->children, index) == child);
+
+	file_browser_node_dir_unindex_name (dir, child);
+
+	if (index == dir->children->len - 1)
+	{
+		/* Removing the last child keeps the rest of the tree valid */
+		if (!dir->visible_index_stale && child->exposed)
+			visible_index_add (dir, index, -1);
+
+		g_ptr_array_set_size (dir->children, index);
+	}
+	else
+	{
+		g_ptr_array_remove_index (dir->children, index);
+
+		for (guint i = index; i < dir->children->len; ++i)
+			((FileBrowserNode *)g_ptr_array_index (dir->children, i))->index = i;
+
+		dir->visible_index_stale = TRUE;
+	}
+}
+
+/* Replaces the children of dir with the nodes in children, which takes
+   ownership of the array. The name index is left to the caller */
+static void
+file_browser_node_dir_set_children (FileBrowserNodeDir *dir,
+				    GPtrArray          *children)
+{
+	g_ptr_array_unref (dir->children);
+	dir->children = children;
+
+	for (guint i = 0; i < children->len; ++i)
+		((FileBrowserNode *)g_ptr_array_index (children, i))->index = i;
+
+	dir->visible_index_stale = TRUE;
+}
+
+/* Interface implementation */
+
+static GtkTreeModelFlags
+gedit_file_browser_store_get_flags (GtkTreeModel *tree_model)
+{
+	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model), (GtkTreeModelFlags) 0);
+
+	return GTK_TREE_MODEL_ITERS_PERSIST;
+}
+
+static gint
+gedit_file_browser_store_get_n_columns (GtkTreeModel *tree_model)
+{
+	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model), 0);
+
+	return GEDIT_FILE_BROWSER_STORE_COLUMN_NUM;
+}
+
+static GType
+gedit_file_browser_store_get_column_type (GtkTreeModel *tree_model,
+					  gint          idx)
+{
+	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model), G_TYPE_INVALID);
+	g_return_val_if_fail (idx < GEDIT_FILE_BROWSER_STORE_COLUMN_NUM && idx >= 0, G_TYPE_INVALID);
+
+	return GEDIT_FILE_BROWSER_STORE (tree_model)->priv->column_types[idx];
+}
+
+static gboolean
+gedit_file_browser_store_get_iter (GtkTreeModel *tree_model,
+				   GtkTreeIter  *iter,
+				   GtkTreePath  *path)
+{
+	GeditFileBrowserStore *model;
+	FileBrowserNode *node;
+	gint *indices, depth;
+
+	g_assert (GEDIT_IS_FILE_BROWSER_STORE (tree_model));
+	g_assert (path != NULL);
+
+	model = GEDIT_FILE_BROWSER_STORE (tree_model);
+	indices = gtk_tree_path_get_indices (path);
+	depth = gtk_tree_path_get_depth (path);
+	node = model->priv->virtual_root;
+
+	for (guint i = 0; i < depth; ++i)
+	{
+		if (node == NULL)
+			return FALSE;
+
+		if (!NODE_IS_DIR (node) || indices[i] < 0)
+			return FALSE;
+
+		node = file_browser_node_dir_nth_exposed (FILE_BROWSER_NODE_DIR (node), indices[i]);
+
+		if (node == NULL)
+			return FALSE;
+	}
+
+	iter->user_data = node;
+	iter->user_data2 = NULL;
+	iter->user_data3 = NULL;
+
+	return node != NULL;
+}
+
+static GtkTreePath *
+gedit_file_browser_store_get_path_real (GeditFileBrowserStore *model,
+					FileBrowserNode       *node)
+{
+	GtkTreePath *path = gtk_tree_path_new ();
+
+	while (node != model->priv->virtual_root)
+	{
+		if (node->parent == NULL)
+		{
+			gtk_tree_path_free (path);
+			return NULL;
+		}
+
+		if (!model_node_visibility (model, node))
+		{
+			if (NODE_IS_DUMMY (node))
+				g_warning ("Dummy not visible???");
+
+			gtk_tree_path_free (path);
+			return NULL;
+		}
+
+		gtk_tree_path_prepend_index (path,
+		                             file_browser_node_dir_position (FILE_BROWSER_NODE_DIR (node->parent),
+		                                                             node));
+
+		node = node->parent;
+	}
+
+	return path;
+}
+
+static GtkTreePath *
+gedit_file_browser_store_get_path (GtkTreeModel *tree_model,
+				   GtkTreeIter  *iter)
+{
+	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model), NULL);
+	g_return_val_if_fail (iter != NULL, NULL);
+	g_return_val_if_fail (iter->user_data != NULL, NULL);
+
+	return gedit_file_browser_store_get_path_real (GEDIT_FILE_BROWSER_STORE (tree_model),
+						       (FileBrowserNode *)(iter->user_data));
+}
+
+static void
+gedit_file_browser_store_get_value (GtkTreeModel *tree_model,
+				    GtkTreeIter  *iter,
+				    gint          column,
+				    GValue       *value)
+{
+	FileBrowserNode *node;
+
+	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model));
+	g_return_if_fail (iter != NULL);
+	g_return_if_fail (iter->user_data != NULL);
+
+	node = (FileBrowserNode *)(iter->user_data);
+
+	g_value_init (value, GEDIT_FILE_BROWSER_STORE (tree_model)->priv->column_types[column]);
+
+	switch (column)
+	{
+		case GEDIT_FILE_BROWSER_STORE_COLUMN_LOCATION:
+			set_gvalue_from_node (value, node);
+			break;
+		case GEDIT_FILE_BROWSER_STORE_COLUMN_MARKUP:
+			if (node->markup != NULL)
+				g_value_set_string (value, node->markup);
+			else if (node->name != NULL)
+				g_value_take_string (value, g_markup_escape_text (node->name, -1));
+			break;
 		case GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS:
 			g_value_set_uint (value, node->flags);
 			break;
 		case GEDIT_FILE_BROWSER_STORE_COLUMN_ICON:
+			/* Only rendered once the view shows the row, see
+			   _gedit_file_browser_store_iter_shown() */
 			g_value_set_object (value, node->icon);
 			break;
 		case GEDIT_FILE_BROWSER_STORE_COLUMN_ICON_NAME:
@@ -720,32 +1494,30 @@ static gboolean
 gedit_file_browser_store_iter_next (GtkTreeModel *tree_model,
 				    GtkTreeIter  *iter)
 {
-	GeditFileBrowserStore *model;
 	FileBrowserNode *node;
-	GSList *first;
+	FileBrowserNodeDir *dir;
+	FileBrowserNode *next;
 
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model), FALSE);
 	g_return_val_if_fail (iter != NULL, FALSE);
 	g_return_val_if_fail (iter->user_data != NULL, FALSE);
 
-	model = GEDIT_FILE_BROWSER_STORE (tree_model);
 	node = (FileBrowserNode *)(iter->user_data);
 
 	if (node->parent == NULL)
 		return FALSE;
 
-	first = g_slist_next (g_slist_find (FILE_BROWSER_NODE_DIR (node->parent)->children, node));
+	dir = FILE_BROWSER_NODE_DIR (node->parent);
 
-	for (GSList *item = first; item; item = item->next)
-	{
-		if (model_node_inserted (model, (FileBrowserNode *)(item->data)))
-		{
-			iter->user_data = item->data;
-			return TRUE;
-		}
-	}
+	/* The first exposed child after node */
+	visible_index_ensure (dir);
+	next = file_browser_node_dir_nth_exposed (dir, visible_index_count (dir, node->index + 1));
 
-	return FALSE;
+	if (next == NULL)
+		return FALSE;
+
+	iter->user_data = next;
+	return TRUE;
 }
 
 static gboolean
@@ -772,16 +1544,13 @@ gedit_file_browser_store_iter_children (GtkTreeModel *tree_model,
 	if (!NODE_IS_DIR (node))
 		return FALSE;
 
-	for (GSList *item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-	{
-		if (model_node_inserted (model, (FileBrowserNode *)(item->data)))
-		{
-			iter->user_data = item->data;
-			return TRUE;
-		}
-	}
+	node = file_browser_node_dir_nth_exposed (FILE_BROWSER_NODE_DIR (node), 0);
 
-	return FALSE;
+	if (node == NULL)
+		return FALSE;
+
+	iter->user_data = node;
+	return TRUE;
 }
 
 static gboolean
@@ -791,13 +1560,7 @@ filter_tree_model_iter_has_child_real (GeditFileBrowserStore *model,
 	if (!NODE_IS_DIR (node))
 		return FALSE;
 
-	for (GSList *item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-	{
-		if (model_node_inserted (model, (FileBrowserNode *)(item->data)))
-			return TRUE;
-	}
-
-	return FALSE;
+	return file_browser_node_dir_n_exposed (FILE_BROWSER_NODE_DIR (node)) > 0;
 }
 
 static gboolean
@@ -826,7 +1589,6 @@ gedit_file_browser_store_iter_n_children (GtkTreeModel *tree_model,
 {
 	FileBrowserNode *node;
 	GeditFileBrowserStore *model;
-	gint num = 0;
 
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model), FALSE);
 	g_return_val_if_fail (iter == NULL || iter->user_data != NULL, FALSE);
@@ -841,13 +1603,7 @@ gedit_file_browser_store_iter_n_children (GtkTreeModel *tree_model,
 	if (!NODE_IS_DIR (node))
 		return 0;
 
-	for (GSList *item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-	{
-		if (model_node_inserted (model, (FileBrowserNode *)(item->data)))
-			++num;
-	}
-
-	return num;
+	return file_browser_node_dir_n_exposed (FILE_BROWSER_NODE_DIR (node));
 }
 
 static gboolean
@@ -858,7 +1614,6 @@ gedit_file_browser_store_iter_nth_child (GtkTreeModel *tree_model,
 {
 	FileBrowserNode *node;
 	GeditFileBrowserStore *model;
-	gint num = 0;
 
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model), FALSE);
 	g_return_val_if_fail (parent == NULL || parent->user_data != NULL, FALSE);
@@ -870,24 +1625,16 @@ gedit_file_browser_store_iter_nth_child (GtkTreeModel *tree_model,
 	else
 		node = (FileBrowserNode *)(parent->user_data);
 
-	if (!NODE_IS_DIR (node))
+	if (!NODE_IS_DIR (node) || n < 0)
 		return FALSE;
 
-	for (GSList *item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-	{
-		if (model_node_inserted (model, (FileBrowserNode *)(item->data)))
-		{
-			if (num == n)
-			{
-				iter->user_data = item->data;
-				return TRUE;
-			}
+	node = file_browser_node_dir_nth_exposed (FILE_BROWSER_NODE_DIR (node), n);
 
-			++num;
-		}
-	}
+	if (node == NULL)
+		return FALSE;
 
-	return FALSE;
+	iter->user_data = node;
+	return TRUE;
 }
 
 static gboolean
@@ -923,6 +1670,7 @@ gedit_file_browser_store_row_inserted (GtkTreeModel *tree_model,
 	FileBrowserNode *node = (FileBrowserNode *)(iter->user_data);
 
 	node->inserted = TRUE;
+	file_browser_node_update_exposed (node);
 }
 
 static gboolean
@@ -1002,55 +1750,260 @@ model_end_loading (GeditFileBrowserStore *model,
 }
 
 static void
-model_node_update_visibility (GeditFileBrowserStore *model,
-			      FileBrowserNode       *node)
+name_pattern_clear (NamePattern *pattern)
 {
-	GtkTreeIter iter;
-
-	node->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
+	g_free (pattern->text);
 
-	if (FILTER_HIDDEN (model->priv->filter_mode) &&
-	    NODE_IS_HIDDEN (node))
-	{
-		node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
-		return;
-	}
+	if (pattern->spec != NULL)
+		g_pattern_spec_free (pattern->spec);
+}
 
-	if (FILTER_BINARY (model->priv->filter_mode) && !NODE_IS_DIR (node))
+static gint
+name_pattern_compare (gconstpointer a,
+		      gconstpointer b)
+{
+	return ((const NamePattern *)a)->kind - ((const NamePattern *)b)->kind;
+}
+
+static void
+name_patterns_add (GArray        *patterns,
+		   const gchar   *glob,
+		   FilterVerdict  verdict)
+{
+	NamePattern pattern = { 0, };
+	gsize length = strlen (glob);
+	gboolean leading = length > 0 && glob[0] == '*';
+	gboolean trailing = length > 1 && glob[length - 1] == '*';
+
+	pattern.verdict = verdict;
+	pattern.text = g_strndup (glob + leading, length - leading - trailing);
+	pattern.length = strlen (pattern.text);
+
+	if (strpbrk (pattern.text, "*?") != NULL)
+	{
+		pattern.kind = NAME_PATTERN_GLOB;
+		pattern.spec = g_pattern_spec_new (glob);
+	}
+	else if (pattern.length == 0 && leading)
+	{
+		pattern.kind = NAME_PATTERN_ANY;
+	}
+	else if (leading && trailing)
+	{
+		pattern.kind = NAME_PATTERN_CONTAINS;
+	}
+	else if (leading)
+	{
+		pattern.kind = NAME_PATTERN_SUFFIX;
+	}
+	else if (trailing)
+	{
+		pattern.kind = NAME_PATTERN_PREFIX;
+	}
+	else
+	{
+		pattern.kind = NAME_PATTERN_LITERAL;
+	}
+
+	g_array_append_val (patterns, pattern);
+}
+
+/* Returns the verdicts out of verdicts for which name matches at least
+   one pattern */
+static guint
+name_patterns_match (GArray      *patterns,
+		     const gchar *name,
+		     guint        verdicts)
+{
+	gsize length = strlen (name);
+	gchar *reversed = NULL;
+	guint matched = 0;
+
+	for (guint i = 0; i < patterns->len; ++i)
 	{
-		if (!NODE_IS_TEXT (node))
+		NamePattern *pattern = &g_array_index (patterns, NamePattern, i);
+		gboolean match = FALSE;
+
+		/* Skip patterns whose outcome is already known */
+		if ((pattern->verdict & (verdicts & ~matched)) == 0)
+			continue;
+
+		switch (pattern->kind)
 		{
-			node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
-			return;
+			case NAME_PATTERN_ANY:
+				match = TRUE;
+				break;
+			case NAME_PATTERN_LITERAL:
+				match = length == pattern->length &&
+				        memcmp (name, pattern->text, length) == 0;
+				break;
+			case NAME_PATTERN_PREFIX:
+				match = length >= pattern->length &&
+				        memcmp (name, pattern->text, pattern->length) == 0;
+				break;
+			case NAME_PATTERN_SUFFIX:
+				match = length >= pattern->length &&
+				        memcmp (name + length - pattern->length, pattern->text, pattern->length) == 0;
+				break;
+			case NAME_PATTERN_CONTAINS:
+				match = strstr (name, pattern->text) != NULL;
+				break;
+			case NAME_PATTERN_GLOB:
+				if (reversed == NULL)
+					reversed = g_utf8_strreverse (name, length);
+
+				match = g_pattern_match (pattern->spec, length, name, reversed);
+				break;
 		}
-		else if (model->priv->binary_patterns != NULL)
-		{
-			gssize name_length = strlen (node->name);
-			gchar *name_reversed = g_utf8_strreverse (node->name, name_length);
 
-			for (guint i = 0; i < model->priv->binary_pattern_specs->len; ++i)
-			{
-				GPatternSpec *spec = g_ptr_array_index (model->priv->binary_pattern_specs, i);
-
-				if (g_pattern_match (spec, name_length, node->name, name_reversed))
-				{
-					node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
-					g_free (name_reversed);
-					return;
-				}
-			}
+		if (match)
+			matched |= pattern->verdict;
+	}
 
-			g_free (name_reversed);
-		}
+	g_free (reversed);
+	return matched;
+}
+
+static void
+model_compile_name_patterns (GeditFileBrowserStore *model)
+{
+	GArray *patterns = model->priv->name_patterns;
+
+	g_array_set_size (patterns, 0);
+
+	if (model->priv->binary_patterns != NULL)
+	{
+		for (guint i = 0; model->priv->binary_patterns[i] != NULL; ++i)
+			name_patterns_add (patterns, model->priv->binary_patterns[i], FILTER_VERDICT_BINARY);
+	}
+
+	if (model->priv->filter_pattern != NULL)
+		name_patterns_add (patterns, model->priv->filter_pattern, FILTER_VERDICT_PATTERN);
+
+	/* Sorting by kind tries the cheap patterns first, which often
+	   settles a verdict before any GPatternSpec runs */
+	g_array_sort (patterns, name_pattern_compare);
+}
+
+/* Runs the batch filter function once over all of nodes */
+static void
+model_nodes_update_batch_verdicts (GeditFileBrowserStore  *model,
+				   FileBrowserNode       **nodes,
+				   guint                   n_nodes)
+{
+	GtkTreeIter *iters;
+	guint8 *filtered;
+
+	if (model->priv->batch_filter_func == NULL)
+	{
+		for (guint i = 0; i < n_nodes; ++i)
+			nodes[i]->filtered_by &= ~FILTER_VERDICT_BATCH;
+
+		return;
+	}
+
+	if (n_nodes == 0)
+		return;
+
+	iters = g_new (GtkTreeIter, n_nodes);
+	filtered = g_new0 (guint8, (n_nodes + 7) / 8);
+
+	for (guint i = 0; i < n_nodes; ++i)
+		iters[i].user_data = nodes[i];
+
+	model->priv->batch_filter_func (model, iters, n_nodes, filtered, model->priv->batch_filter_user_data);
+
+	for (guint i = 0; i < n_nodes; ++i)
+	{
+		if (filtered[i / 8] & (1 << (i % 8)))
+			nodes[i]->filtered_by |= FILTER_VERDICT_BATCH;
+		else
+			nodes[i]->filtered_by &= ~FILTER_VERDICT_BATCH;
 	}
 
-	if (model->priv->filter_func)
+	g_free (filtered);
+	g_free (iters);
+}
+
+/* Recomputes the cached filter verdicts of node listed in verdicts */
+static void
+model_node_update_verdicts (GeditFileBrowserStore *model,
+			    FileBrowserNode       *node,
+			    guint                  verdicts)
+{
+	guint filtered_by = node->filtered_by & ~verdicts;
+	guint name_verdicts = verdicts & (FILTER_VERDICT_BINARY | FILTER_VERDICT_PATTERN);
+
+	/* Names of directories and dummies never filter them on a pattern */
+	if (NODE_IS_DUMMY (node))
+		name_verdicts &= ~FILTER_VERDICT_PATTERN;
+
+	if (NODE_IS_DIR (node) || node->name == NULL || model->priv->name_patterns->len == 0)
+		name_verdicts = 0;
+
+	if (name_verdicts != 0)
+	{
+		guint matched = name_patterns_match (model->priv->name_patterns, node->name, name_verdicts);
+
+		filtered_by |= matched & FILTER_VERDICT_BINARY;
+
+		if ((name_verdicts & FILTER_VERDICT_PATTERN) && !(matched & FILTER_VERDICT_PATTERN))
+			filtered_by |= FILTER_VERDICT_PATTERN;
+	}
+
+	if ((verdicts & FILTER_VERDICT_FUNC) && model->priv->filter_func)
 	{
+		GtkTreeIter iter;
+
 		iter.user_data = node;
 
 		if (!model->priv->filter_func (model, &iter, model->priv->filter_user_data))
-			node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
+			filtered_by |= FILTER_VERDICT_FUNC;
+	}
+
+	node->filtered_by = filtered_by;
+
+	if (verdicts & FILTER_VERDICT_BATCH)
+		model_nodes_update_batch_verdicts (model, &node, 1);
+}
+
+static gboolean
+model_node_is_filtered (GeditFileBrowserStore *model,
+			FileBrowserNode       *node)
+{
+	if (FILTER_HIDDEN (model->priv->filter_mode) &&
+	    NODE_IS_HIDDEN (node))
+	{
+		return TRUE;
+	}
+
+	if (FILTER_BINARY (model->priv->filter_mode) && !NODE_IS_DIR (node))
+	{
+		if (!NODE_IS_TEXT (node) || (node->filtered_by & FILTER_VERDICT_BINARY))
+			return TRUE;
 	}
+
+	return (node->filtered_by & (FILTER_VERDICT_PATTERN | FILTER_VERDICT_FUNC | FILTER_VERDICT_BATCH)) != 0;
+}
+
+static void
+model_node_update_filtered (GeditFileBrowserStore *model,
+			    FileBrowserNode       *node)
+{
+	node->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
+
+	if (model_node_is_filtered (model, node))
+		node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
+
+	file_browser_node_update_exposed (node);
+}
+
+static void
+model_node_update_visibility (GeditFileBrowserStore *model,
+			      FileBrowserNode       *node)
+{
+	model_node_update_verdicts (model, node, FILTER_VERDICT_ALL);
+	model_node_update_filtered (model, node);
 }
 
 static gint
@@ -1067,14 +2020,7 @@ collate_nodes (FileBrowserNode *node1,
 	}
 	else
 	{
-		gchar *k1 = g_utf8_collate_key_for_filename (node1->name, -1);
-		gchar *k2 = g_utf8_collate_key_for_filename (node2->name, -1);
-		gint result = strcmp (k1, k2);
-
-		g_free (k1);
-		g_free (k2);
-
-		return result;
+		return strcmp (node1->collate_key, node2->collate_key);
 	}
 }
 
@@ -1099,6 +2045,28 @@ model_sort_default (FileBrowserNode *node1,
 	return collate_nodes (node1, node2);
 }
 
+static gint
+compare_children (gconstpointer a,
+		  gconstpointer b,
+		  gpointer      user_data)
+{
+	GeditFileBrowserStore *model = GEDIT_FILE_BROWSER_STORE (user_data);
+
+	return model->priv->sort_func (*(FileBrowserNode **)a, *(FileBrowserNode **)b);
+}
+
+static void
+model_sort_children (GeditFileBrowserStore *model,
+		     FileBrowserNodeDir    *dir)
+{
+	g_ptr_array_sort_with_data (dir->children, compare_children, model);
+
+	for (guint i = 0; i < dir->children->len; ++i)
+		((FileBrowserNode *)g_ptr_array_index (dir->children, i))->index = i;
+
+	dir->visible_index_stale = TRUE;
+}
+
 static void
 model_resort_node (GeditFileBrowserStore *model,
 		   FileBrowserNode       *node)
@@ -1108,7 +2076,7 @@ model_resort_node (GeditFileBrowserStore *model,
 	if (!model_node_visibility (model, node->parent))
 	{
 		/* Just sort the children of the parent */
-		dir->children = g_slist_sort (dir->children, (GCompareFunc)(model->priv->sort_func));
+		model_sort_children (model, dir);
 	}
 	else
 	{
@@ -1117,28 +2085,33 @@ model_resort_node (GeditFileBrowserStore *model,
 		gint *neworder;
 		gint pos = 0;
 
-		/* Store current positions */
-		for (GSList *item = dir->children; item; item = item->next)
+		/* Store current visible positions in the index, it is
+		   renumbered below anyway */
+		for (guint i = 0; i < dir->children->len; ++i)
 		{
-			FileBrowserNode *child = (FileBrowserNode *)(item->data);
+			FileBrowserNode *child = g_ptr_array_index (dir->children, i);
 
 			if (model_node_visibility (model, child))
-				child->pos = pos++;
+				child->index = pos++;
 		}
 
-		dir->children = g_slist_sort (dir->children, (GCompareFunc)(model->priv->sort_func));
+		g_ptr_array_sort_with_data (dir->children, compare_children, model);
 		neworder = g_new (gint, pos);
 		pos = 0;
 
 		/* Store the new positions */
-		for (GSList *item = dir->children; item; item = item->next)
+		for (guint i = 0; i < dir->children->len; ++i)
 		{
-			FileBrowserNode *child = (FileBrowserNode *)(item->data);
+			FileBrowserNode *child = g_ptr_array_index (dir->children, i);
 
 			if (model_node_visibility (model, child))
-				neworder[pos++] = child->pos;
+				neworder[pos++] = child->index;
+
+			child->index = i;
 		}
 
+		dir->visible_index_stale = TRUE;
+
 		iter.user_data = node->parent;
 		path = gedit_file_browser_store_get_path_real (model, node->parent);
 
@@ -1196,6 +2169,23 @@ row_inserted (GeditFileBrowserStore  *model,
 	gtk_tree_row_reference_free (ref);
 }
 
+/* Announces a set of rows of parent which have already been inserted
+   one by one, so that listeners can handle them in one go */
+static void
+rows_inserted (GeditFileBrowserStore *model,
+	       FileBrowserNode       *parent,
+	       GtkTreeIter           *iters,
+	       guint                  n_iters)
+{
+	GtkTreeIter iter;
+
+	if (n_iters == 0)
+		return;
+
+	iter.user_data = parent;
+	g_signal_emit (model, model_signals[ROWS_INSERTED], 0, &iter, iters, n_iters);
+}
+
 static void
 row_deleted (GeditFileBrowserStore *model,
              FileBrowserNode       *node,
@@ -1209,6 +2199,7 @@ row_deleted (GeditFileBrowserStore *model,
 
 	hidden = FILE_IS_HIDDEN (node->flags);
 	node->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+	file_browser_node_update_exposed (node);
 
 	/* Create temporary copies of the path as the signals may alter it */
 
@@ -1221,29 +2212,48 @@ row_deleted (GeditFileBrowserStore *model,
 	if (hidden)
 		node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
 
+	file_browser_node_update_exposed (node);
+
 	copy = gtk_tree_path_copy (path);
 	gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), copy);
 	gtk_tree_path_free (copy);
 }
 
+/* Refilters node and its children, recomputing only the verdicts
+   listed in verdicts. When narrowed is set the filter pattern only got
+   stricter, so nodes it already filters out are not tested again. The
+   batch verdict of the children of a directory is computed at once, so
+   batched tells whether the one of node is already known */
 static void
 model_refilter_node (GeditFileBrowserStore  *model,
 		     FileBrowserNode        *node,
-		     GtkTreePath           **path)
+		     GtkTreePath           **path,
+		     guint                   verdicts,
+		     gboolean                narrowed,
+		     gboolean                batched,
+		     GArray                 *inserted)
 {
 	gboolean old_visible;
 	gboolean new_visible;
 	FileBrowserNodeDir *dir;
-	GSList *item;
 	GtkTreeIter iter;
 	GtkTreePath *tmppath = NULL;
 	gboolean in_tree;
+	guint node_verdicts = verdicts;
+	GArray *children_inserted;
 
 	if (node == NULL)
 		return;
 
+	if (narrowed && (node->filtered_by & FILTER_VERDICT_PATTERN))
+		node_verdicts &= ~FILTER_VERDICT_PATTERN;
+
+	if (batched)
+		node_verdicts &= ~FILTER_VERDICT_BATCH;
+
 	old_visible = model_node_visibility (model, node);
-	model_node_update_visibility (model, node);
+	model_node_update_verdicts (model, node, node_verdicts);
+	model_node_update_filtered (model, node);
 
 	in_tree = node_in_tree (model, node);
 
@@ -1264,11 +2274,29 @@ model_refilter_node (GeditFileBrowserStore  *model,
 
 		dir = FILE_BROWSER_NODE_DIR (node);
 
-		for (item = dir->children; item; item = item->next)
-			model_refilter_node (model, (FileBrowserNode *)(item->data), path);
+		if (verdicts & FILTER_VERDICT_BATCH)
+		{
+			model_nodes_update_batch_verdicts (model,
+							   (FileBrowserNode **)dir->children->pdata,
+							   dir->children->len);
+		}
+
+		/* The children which show up are announced together */
+		children_inserted = g_array_new (FALSE, FALSE, sizeof (GtkTreeIter));
+
+		for (guint i = 0; i < dir->children->len; ++i)
+		{
+			model_refilter_node (model, g_ptr_array_index (dir->children, i), path,
+					     verdicts, narrowed, TRUE, children_inserted);
+		}
 
 		if (in_tree)
 			gtk_tree_path_up (*path);
+
+		rows_inserted (model, node,
+			       (GtkTreeIter *)children_inserted->data,
+			       children_inserted->len);
+		g_array_free (children_inserted, TRUE);
 	}
 
 	if (in_tree)
@@ -1285,6 +2313,12 @@ model_refilter_node (GeditFileBrowserStore  *model,
 			{
 				iter.user_data = node;
 				row_inserted (model, path, &iter);
+
+				if (inserted != NULL)
+					g_array_append_val (inserted, iter);
+				else
+					rows_inserted (model, node->parent, &iter, 1);
+
 				gtk_tree_path_next (*path);
 			}
 		}
@@ -1301,26 +2335,69 @@ model_refilter_node (GeditFileBrowserStore  *model,
 }
 
 static void
-model_refilter (GeditFileBrowserStore *model)
+model_refilter (GeditFileBrowserStore *model,
+		guint                  verdicts,
+		gboolean               narrowed)
 {
-	model_refilter_node (model, model->priv->root, NULL);
+	model_refilter_node (model, model->priv->root, NULL, verdicts, narrowed, FALSE, NULL);
 }
 
+/* Sets the name of node, taking ownership of name, along with the
+   markup and collation key derived from it */
 static void
-file_browser_node_set_name (FileBrowserNode *node)
+file_browser_node_take_name (FileBrowserNode *node,
+			     gchar           *name)
 {
 	g_free (node->name);
 	g_free (node->markup);
+	g_free (node->collate_key);
 
-	if (node->file)
-		node->name = gedit_file_browser_utils_file_basename (node->file);
-	else
-		node->name = NULL;
+	node->name = name;
+	node->markup = NULL;
+	node->collate_key = name != NULL ? g_utf8_collate_key_for_filename (name, -1) : NULL;
+}
+
+/* Returns a new reference to the location of node, or NULL for a dummy */
+static GFile *
+file_browser_node_get_file (FileBrowserNode *node)
+{
+	if (node->file != NULL)
+		return g_object_ref (node->file);
+
+	if (node->basename == NULL)
+		return NULL;
+
+	return g_file_get_child (node->parent->file, node->basename);
+}
+
+/* Sets the location of node, the directory flag must be set already */
+static void
+file_browser_node_set_file (FileBrowserNode *node,
+			    GFile           *file)
+{
+	g_clear_object (&node->file);
+	g_free (node->basename);
+
+	node->basename = file != NULL ? g_file_get_basename (file) : NULL;
+
+	if (file != NULL && NODE_IS_DIR (node))
+		node->file = g_object_ref (file);
+}
+
+static void
+file_browser_node_set_name (FileBrowserNode *node)
+{
+	GFile *file = file_browser_node_get_file (node);
 
-	if (node->name)
-		node->markup = g_markup_escape_text (node->name, -1);
+	if (file)
+	{
+		file_browser_node_take_name (node, gedit_file_browser_utils_file_basename (file));
+		g_object_unref (file);
+	}
 	else
-		node->markup = NULL;
+	{
+		file_browser_node_take_name (node, NULL);
+	}
 }
 
 static void
@@ -1328,13 +2405,13 @@ file_browser_node_init (FileBrowserNode *node,
 			GFile           *file,
 			FileBrowserNode *parent)
 {
+	node->parent = parent;
+
 	if (file != NULL)
 	{
-		node->file = g_object_ref (file);
-		file_browser_node_set_name (node);
+		file_browser_node_set_file (node, file);
+		file_browser_node_take_name (node, gedit_file_browser_utils_file_basename (file));
 	}
-
-	node->parent = parent;
 }
 
 static FileBrowserNode *
@@ -1354,27 +2431,67 @@ file_browser_node_dir_new (GeditFileBrowserStore *model,
 {
 	FileBrowserNode *node = (FileBrowserNode *)g_slice_new0 (FileBrowserNodeDir);
 
-	file_browser_node_init (node, file, parent);
-
 	node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_DIRECTORY;
+	file_browser_node_init (node, file, parent);
 
+	FILE_BROWSER_NODE_DIR (node)->children = g_ptr_array_new ();
 	FILE_BROWSER_NODE_DIR (node)->model = model;
 
 	return node;
 }
 
+/* Loaded directories which are not shown stay loaded and monitored, so
+   that going back to them is instant. They are unloaded again, the one
+   shown longest ago first, once they hold more than cache-size files */
+static void
+model_detached_add (GeditFileBrowserStore *model,
+		    FileBrowserNode       *node)
+{
+	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
+
+	if (dir->detached_link != NULL)
+		return;
+
+	g_queue_push_head (&model->priv->detached, node);
+	dir->detached_link = model->priv->detached.head;
+	dir->detached_size = dir->children->len;
+
+	model->priv->detached_size += dir->detached_size;
+}
+
+static void
+model_detached_remove (GeditFileBrowserStore *model,
+		       FileBrowserNode       *node)
+{
+	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
+
+	if (dir->detached_link == NULL)
+		return;
+
+	g_queue_delete_link (&model->priv->detached, dir->detached_link);
+	dir->detached_link = NULL;
+
+	model->priv->detached_size -= dir->detached_size;
+}
+
 static void
 file_browser_node_free_children (GeditFileBrowserStore *model,
 				 FileBrowserNode       *node)
 {
+	FileBrowserNodeDir *dir;
+
 	if (node == NULL || !NODE_IS_DIR (node))
 		return;
 
-	for (GSList *item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-		file_browser_node_free (model, (FileBrowserNode *)(item->data));
+	dir = FILE_BROWSER_NODE_DIR (node);
+	model_detached_remove (model, node);
+
+	for (guint i = 0; i < dir->children->len; ++i)
+		file_browser_node_free (model, g_ptr_array_index (dir->children, i));
 
-	g_slist_free (FILE_BROWSER_NODE_DIR (node)->children);
-	FILE_BROWSER_NODE_DIR (node)->children = NULL;
+	g_ptr_array_set_size (dir->children, 0);
+	g_clear_pointer (&dir->children_by_name, g_hash_table_unref);
+	dir->visible_index_stale = FALSE;
 
 	/* This node is no longer loaded */
 	node->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_LOADED;
@@ -1391,6 +2508,8 @@ file_browser_node_free (GeditFileBrowserStore *model,
 	{
 		FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
 
+		model_detached_remove (model, node);
+
 		if (dir->cancellable)
 		{
 			g_cancellable_cancel (dir->cancellable);
@@ -1401,28 +2520,64 @@ file_browser_node_free (GeditFileBrowserStore *model,
 
 		file_browser_node_free_children (model, node);
 
+		g_ptr_array_unref (dir->children);
+		g_clear_pointer (&dir->children_by_name, g_hash_table_unref);
+		g_free (dir->visible_index);
+
 		if (dir->monitor)
 		{
 			g_file_monitor_cancel (dir->monitor);
 			g_object_unref (dir->monitor);
 		}
+
+		file_browser_node_dir_clear_monitor_events (dir);
+		file_browser_node_dir_clear_statuses (dir);
 	}
 
+	/* Only directories have state attached to their location */
 	if (node->file)
 	{
+		model_unindex_location (model, node);
 		g_signal_emit (model, model_signals[UNLOAD], 0, node->file);
 		g_object_unref (node->file);
 	}
 
-	if (node->icon)
-		g_object_unref (node->icon);
+	g_free (node->basename);
+
+	g_clear_object (&node->gicon);
+	g_clear_object (&node->icon);
 
 	if (node->emblem)
 		g_object_unref (node->emblem);
 
-	g_free (node->icon_name);
 	g_free (node->name);
 	g_free (node->markup);
+	g_free (node->collate_key);
+
+	if (NODE_IS_DIR (node))
+		g_slice_free (FileBrowserNodeDir, (FileBrowserNodeDir *)node);
+	else
+		g_slice_free (FileBrowserNode, (FileBrowserNode *)node);
+}
+
+/* Frees a node which was prepared for the model but never added to it.
+   Such a node has no children, icon or monitor and nobody has seen it,
+   so this can be called from any thread */
+static void
+file_browser_node_free_unused (FileBrowserNode *node)
+{
+	if (NODE_IS_DIR (node))
+	{
+		FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
+
+		g_ptr_array_unref (dir->children);
+	}
+
+	g_clear_object (&node->file);
+	g_free (node->basename);
+	g_free (node->name);
+	g_free (node->markup);
+	g_free (node->collate_key);
 
 	if (NODE_IS_DIR (node))
 		g_slice_free (FileBrowserNodeDir, (FileBrowserNodeDir *)node);
@@ -1449,14 +2604,14 @@ model_remove_node_children (GeditFileBrowserStore *model,
 {
 	FileBrowserNodeDir *dir;
 	GtkTreePath *path_child;
-	GSList *list;
+	GPtrArray *children;
 
 	if (node == NULL || !NODE_IS_DIR (node))
 		return;
 
 	dir = FILE_BROWSER_NODE_DIR (node);
 
-	if (dir->children == NULL)
+	if (dir->children->len == 0)
 		return;
 
 	if (!model_node_visibility (model, node))
@@ -1473,14 +2628,48 @@ model_remove_node_children (GeditFileBrowserStore *model,
 	else
 		path_child = gtk_tree_path_copy (path);
 
-	gtk_tree_path_down (path_child);
+	if (!free_nodes)
+	{
+		/* The nodes stay in place, work on a copy since a dummy might
+		   be added while removing the rows */
+		children = g_ptr_array_sized_new (dir->children->len);
+
+		for (guint i = 0; i < dir->children->len; ++i)
+			g_ptr_array_add (children, g_ptr_array_index (dir->children, i));
+
+		gtk_tree_path_down (path_child);
+
+		for (guint i = 0; i < children->len; ++i)
+			model_remove_node (model, g_ptr_array_index (children, i), path_child, FALSE);
+
+		g_ptr_array_unref (children);
+	}
+	else
+	{
+		/* Remove the children starting from the last one, which keeps
+		   taking them out of the children array cheap. A leading dummy
+		   is kept, it shows up once the last real child is gone */
+		while (dir->children->len > 0)
+		{
+			FileBrowserNode *child = g_ptr_array_index (dir->children, dir->children->len - 1);
+			GtkTreePath *path = NULL;
+
+			if (dir->children->len == 1 && NODE_IS_DUMMY (child))
+				break;
+
+			if (model_node_visibility (model, child))
+			{
+				path = gtk_tree_path_copy (path_child);
+				gtk_tree_path_append_index (path, file_browser_node_dir_position (dir, child));
+			}
 
-	list = g_slist_copy (dir->children);
+			model_remove_node (model, child, path, TRUE);
 
-	for (GSList *item = list; item; item = item->next)
-		model_remove_node (model, (FileBrowserNode *)(item->data), path_child, free_nodes);
+			if (path != NULL)
+				gtk_tree_path_free (path);
+		}
+	}
 
-	g_slist_free (list);
 	gtk_tree_path_free (path_child);
 }
 
@@ -1505,6 +2694,16 @@ model_remove_node (GeditFileBrowserStore *model,
 	gboolean free_path = FALSE;
 	FileBrowserNode *parent;
 
+	/* Directories above the virtual root are monitored while they are
+	   detached, move the virtual root out of one which is going away */
+	if (free_nodes && node->parent != NULL && NODE_IS_DIR (node) &&
+	    model->priv->virtual_root != NULL &&
+	    node_has_parent (model->priv->virtual_root, node))
+	{
+		model_clear (model, FALSE);
+		set_virtual_root_from_node (model, node->parent);
+	}
+
 	if (path == NULL)
 	{
 		path = gedit_file_browser_store_get_path_real (model, node);
@@ -1524,8 +2723,7 @@ model_remove_node (GeditFileBrowserStore *model,
 
 	/* Remove the node from the parents children list */
 	if (free_nodes && parent)
-		FILE_BROWSER_NODE_DIR (node->parent)->children =
-			g_slist_remove (FILE_BROWSER_NODE_DIR (node->parent)->children, node);
+		file_browser_node_dir_remove (FILE_BROWSER_NODE_DIR (parent), node);
 
 	/* If this is the virtual root, than set the parent as the virtual root */
 	if (node == model->priv->virtual_root)
@@ -1538,15 +2736,175 @@ model_remove_node (GeditFileBrowserStore *model,
 		file_browser_node_free (model, node);
 }
 
-/**
- * model_clear:
- * @model: the #GeditFileBrowserStore
- * @free_nodes: whether to also remove the nodes from memory
- *
- * Removes all nodes from the model. This function is used
- * to remove all the nodes from the _model_. Don't use it to just free the
- * nodes in the model.
- */
+static gboolean
+file_browser_node_is_ancestor (FileBrowserNode *node,
+			       FileBrowserNode *descendant)
+{
+	for (; descendant != NULL; descendant = descendant->parent)
+	{
+		if (descendant == node)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gint
+compare_nodes_for_removal (gconstpointer a,
+			   gconstpointer b)
+{
+	const FileBrowserNode *node1 = *(FileBrowserNode * const *)a;
+	const FileBrowserNode *node2 = *(FileBrowserNode * const *)b;
+
+	if (node1->parent != node2->parent)
+		return node1->parent < node2->parent ? -1 : 1;
+
+	/* Last child first, the positions before it stay valid */
+	if (node1->index != node2->index)
+		return node1->index < node2->index ? 1 : -1;
+
+	return 0;
+}
+
+/* Removes the siblings in nodes, sorted from the last child to the
+   first one, from dir in a single pass over its children */
+static void
+model_remove_sibling_nodes (GeditFileBrowserStore *model,
+			    FileBrowserNodeDir    *dir,
+			    FileBrowserNode      **nodes,
+			    guint                  n_nodes)
+{
+	FileBrowserNode *parent = (FileBrowserNode *)dir;
+	GtkTreePath *parent_path = NULL;
+	gint next;
+	guint n_children = 0;
+
+	if (model_node_visibility (model, parent))
+		parent_path = gedit_file_browser_store_get_path_real (model, parent);
+
+	/* The nodes stay in the children until all the rows are deleted,
+	   the handlers of the signals can still walk the model */
+	for (guint i = 0; i < n_nodes; ++i)
+	{
+		FileBrowserNode *node = nodes[i];
+		GtkTreePath *path = NULL;
+
+		if (parent_path != NULL && model_node_visibility (model, node))
+		{
+			path = gtk_tree_path_copy (parent_path);
+			gtk_tree_path_append_index (path, file_browser_node_dir_position (dir, node));
+		}
+
+		model_remove_node_children (model, node, path, TRUE);
+
+		if (path != NULL)
+		{
+			row_deleted (model, node, path);
+			gtk_tree_path_free (path);
+		}
+	}
+
+	/* Drop them all in one pass, the last of nodes comes first */
+	next = n_nodes - 1;
+
+	for (guint i = 0; i < dir->children->len; ++i)
+	{
+		FileBrowserNode *child = g_ptr_array_index (dir->children, i);
+
+		if (next >= 0 && child == nodes[next])
+		{
+			file_browser_node_dir_unindex_name (dir, child);
+			file_browser_node_free (model, child);
+			--next;
+			continue;
+		}
+
+		child->index = n_children;
+		dir->children->pdata[n_children++] = child;
+	}
+
+	g_ptr_array_set_size (dir->children, n_children);
+	dir->visible_index_stale = TRUE;
+
+	if (parent_path != NULL)
+	{
+		model_check_dummy (model, parent);
+		gtk_tree_path_free (parent_path);
+	}
+}
+
+/* Removes and frees nodes, doing the work for all the nodes of a
+   directory at once instead of one node at a time */
+static void
+model_remove_nodes (GeditFileBrowserStore *model,
+		    GPtrArray             *nodes)
+{
+	GHashTable *set = g_hash_table_new (NULL, NULL);
+	GHashTable *seen = g_hash_table_new (NULL, NULL);
+	GPtrArray *batch = g_ptr_array_sized_new (nodes->len);
+	GPtrArray *single = g_ptr_array_new ();
+	guint i = 0;
+
+	for (guint j = 0; j < nodes->len; ++j)
+		g_hash_table_add (set, g_ptr_array_index (nodes, j));
+
+	for (guint j = 0; j < nodes->len; ++j)
+	{
+		FileBrowserNode *node = g_ptr_array_index (nodes, j);
+		FileBrowserNode *ancestor;
+
+		/* Nodes inside another removed node go away with it */
+		for (ancestor = node->parent; ancestor != NULL; ancestor = ancestor->parent)
+		{
+			if (g_hash_table_contains (set, ancestor))
+				break;
+		}
+
+		if (ancestor != NULL || !g_hash_table_add (seen, node))
+			continue;
+
+		/* Taking out the virtual root or one of its parents moves the
+		   virtual root, model_remove_node knows how to do that */
+		if (node->parent == NULL || file_browser_node_is_ancestor (node, model->priv->virtual_root))
+			g_ptr_array_add (single, node);
+		else
+			g_ptr_array_add (batch, node);
+	}
+
+	g_hash_table_unref (set);
+	g_hash_table_unref (seen);
+	g_ptr_array_sort (batch, compare_nodes_for_removal);
+
+	while (i < batch->len)
+	{
+		FileBrowserNode *parent = ((FileBrowserNode *)g_ptr_array_index (batch, i))->parent;
+		guint start = i;
+
+		while (i < batch->len && ((FileBrowserNode *)g_ptr_array_index (batch, i))->parent == parent)
+			++i;
+
+		model_remove_sibling_nodes (model,
+					    FILE_BROWSER_NODE_DIR (parent),
+					    (FileBrowserNode **)batch->pdata + start,
+					    i - start);
+	}
+
+	for (guint j = 0; j < single->len; ++j)
+		model_remove_node (model, g_ptr_array_index (single, j), NULL, TRUE);
+
+	g_ptr_array_unref (batch);
+	g_ptr_array_unref (single);
+}
+
+/**
+ * model_clear:
+ * @model: the #GeditFileBrowserStore
+ * @free_nodes: whether to also remove the nodes from memory
+ *
+ * Removes all nodes from the model. This function is used
+ * to remove all the nodes from the _model_. Don't use it to just free the
+ * nodes in the model.
+ */
 static void
 model_clear (GeditFileBrowserStore *model,
 	     gboolean               free_nodes)
@@ -1561,9 +2919,9 @@ model_clear (GeditFileBrowserStore *model,
 	{
 		FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (model->priv->virtual_root);
 
-		if (dir->children != NULL)
+		if (dir->children->len > 0)
 		{
-			FileBrowserNode *dummy = (FileBrowserNode *)(dir->children->data);
+			FileBrowserNode *dummy = g_ptr_array_index (dir->children, 0);
 
 			if (NODE_IS_DUMMY (dummy) && model_node_visibility (model, dummy))
 			{
@@ -1589,6 +2947,7 @@ file_browser_node_unload (GeditFileBrowserStore *model,
 		return;
 
 	dir = FILE_BROWSER_NODE_DIR (node);
+	model_detached_remove (model, node);
 
 	if (remove_children)
 		model_remove_node_children (model, node, NULL, TRUE);
@@ -1610,85 +2969,180 @@ file_browser_node_unload (GeditFileBrowserStore *model,
 		dir->monitor = NULL;
 	}
 
+	file_browser_node_dir_clear_monitor_events (dir);
+	file_browser_node_dir_clear_statuses (dir);
+
 	node->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_LOADED;
 }
 
-static void
-model_recomposite_icon_real (GeditFileBrowserStore *tree_model,
-			     FileBrowserNode       *node,
-			     GFileInfo             *info)
+static GdkPixbuf *
+render_icon (GIcon     *gicon,
+	     GdkPixbuf *emblem,
+	     gint       icon_size)
 {
-	GdkPixbuf *icon;
+	GdkPixbuf *icon = NULL;
+	GdkPixbuf *composite;
 
-	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model));
-	g_return_if_fail (node != NULL);
+	if (gicon != NULL)
+		icon = gedit_file_browser_utils_pixbuf_from_icon (gicon, GTK_ICON_SIZE_MENU);
 
-	if (node->file == NULL)
-		return;
+	/* Fallback to the same icon as the file browser */
+	if (!icon)
+		icon = gedit_file_browser_utils_pixbuf_from_theme ("text-x-generic", GTK_ICON_SIZE_MENU);
 
-	if (info)
-	{
-		GIcon *gicon = g_file_info_get_icon (info);
+	if (!emblem)
+		return icon;
 
-		if (gicon != NULL)
-			icon = gedit_file_browser_utils_pixbuf_from_icon (gicon, GTK_ICON_SIZE_MENU);
-		else
-			icon = NULL;
+	if (icon == NULL)
+	{
+		composite = gdk_pixbuf_new (gdk_pixbuf_get_colorspace (emblem),
+					    gdk_pixbuf_get_has_alpha (emblem),
+					    gdk_pixbuf_get_bits_per_sample (emblem),
+					    icon_size,
+					    icon_size);
 	}
 	else
 	{
-		icon = gedit_file_browser_utils_pixbuf_from_file (node->file, GTK_ICON_SIZE_MENU, FALSE);
+		composite = gdk_pixbuf_copy (icon);
+		g_object_unref (icon);
 	}
 
-	/* Fallback to the same icon as the file browser */
-	if (!icon)
-		icon = gedit_file_browser_utils_pixbuf_from_theme ("text-x-generic", GTK_ICON_SIZE_MENU);
+	gdk_pixbuf_composite (emblem, composite,
+			      icon_size - 10, icon_size - 10, 10,
+			      10, icon_size - 10, icon_size - 10,
+			      1, 1, GDK_INTERP_NEAREST, 255);
 
-	if (node->icon)
-		g_object_unref (node->icon);
+	return composite;
+}
 
-	if (node->emblem)
+static GdkPixbuf *
+model_get_status_emblem (GeditFileBrowserStore  *model,
+			 GeditFileBrowserStatus  status)
+{
+	static const gchar *names[GEDIT_FILE_BROWSER_STATUS_NUM] = {
+		[GEDIT_FILE_BROWSER_STATUS_UNTRACKED] = "emblem-new",
+		[GEDIT_FILE_BROWSER_STATUS_ADDED] = "list-add",
+		[GEDIT_FILE_BROWSER_STATUS_MODIFIED] = "document-edit",
+		[GEDIT_FILE_BROWSER_STATUS_CONFLICTED] = "dialog-warning"
+	};
+
+	/* Same size as the emblems set through the message bus */
+	if (model->priv->status_emblems[status] == NULL && names[status] != NULL)
 	{
-		gint icon_size;
+		model->priv->status_emblems[status] =
+			gtk_icon_theme_load_icon (gtk_icon_theme_get_default (),
+						  names[status],
+						  10,
+						  GTK_ICON_LOOKUP_FORCE_SIZE,
+						  NULL);
+	}
 
-		gtk_icon_size_lookup (GTK_ICON_SIZE_MENU, NULL, &icon_size);
+	return model->priv->status_emblems[status];
+}
 
-		if (icon == NULL)
-		{
-			node->icon = gdk_pixbuf_new (gdk_pixbuf_get_colorspace (node->emblem),
-						     gdk_pixbuf_get_has_alpha (node->emblem),
-						     gdk_pixbuf_get_bits_per_sample (node->emblem),
-						     icon_size,
-						     icon_size);
-		}
-		else
-		{
-			node->icon = gdk_pixbuf_copy (icon);
-			g_object_unref (icon);
-		}
+/* Returns the icon of node, rendering it the first time it is needed.
+   Nodes with the same icon and emblem share the same pixbuf */
+static GdkPixbuf *
+model_node_get_icon (GeditFileBrowserStore *model,
+		     FileBrowserNode       *node)
+{
+	IconCacheKey lookup;
+	gpointer cached;
+
+	if (NODE_IS_DUMMY (node))
+		return NULL;
+
+	if (node->icon != NULL)
+		return node->icon;
+
+	lookup.gicon = node->gicon;
+	lookup.emblem = node->emblem;
+
+	/* An emblem set through the model wins over the status */
+	if (lookup.emblem == NULL && node->status != GEDIT_FILE_BROWSER_STATUS_NONE)
+		lookup.emblem = model_get_status_emblem (model, node->status);
 
-		gdk_pixbuf_composite (node->emblem, node->icon,
-				      icon_size - 10, icon_size - 10, 10,
-				      10, icon_size - 10, icon_size - 10,
-				      1, 1, GDK_INTERP_NEAREST, 255);
+	gtk_icon_size_lookup (GTK_ICON_SIZE_MENU, NULL, &lookup.size);
+
+	if (!g_hash_table_lookup_extended (model->priv->icon_cache, &lookup, NULL, &cached))
+	{
+		IconCacheKey *key = g_slice_new (IconCacheKey);
+
+		key->gicon = lookup.gicon != NULL ? g_object_ref (lookup.gicon) : NULL;
+		key->emblem = lookup.emblem != NULL ? g_object_ref (lookup.emblem) : NULL;
+		key->size = lookup.size;
+
+		/* The nodes keep their own reference to their icon */
+		if (g_hash_table_size (model->priv->icon_cache) >= ICON_CACHE_SIZE)
+			g_hash_table_remove_all (model->priv->icon_cache);
+
+		cached = render_icon (key->gicon, key->emblem, key->size);
+		g_hash_table_insert (model->priv->icon_cache, key, cached);
 	}
-	else
+
+	if (cached != NULL)
+		node->icon = g_object_ref (cached);
+
+	return node->icon;
+}
+
+/* The full content type of info when it was asked for, the one guessed
+   from the name otherwise */
+static const gchar *
+file_info_get_content_type (GFileInfo *info)
+{
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE))
+		return g_file_info_get_content_type (info);
+
+	return g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
+}
+
+static GIcon *
+model_get_content_type_icon (GeditFileBrowserStore *model,
+			     const gchar           *content_type)
+{
+	GIcon *icon = g_hash_table_lookup (model->priv->content_type_icons, content_type);
+
+	if (icon == NULL)
 	{
-		node->icon = icon;
+		icon = g_content_type_get_icon (content_type);
+		g_hash_table_insert (model->priv->content_type_icons, g_strdup (content_type), icon);
 	}
+
+	return icon;
 }
 
+/* Sets the icon of node from info, the pixbuf itself is only looked up
+   when the icon column is requested */
 static void
-model_recomposite_icon (GeditFileBrowserStore *tree_model,
-			GtkTreeIter           *iter)
+model_node_set_icon_from_info (GeditFileBrowserStore *model,
+			       FileBrowserNode       *node,
+			       GFileInfo             *info)
 {
-	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model));
-	g_return_if_fail (iter != NULL);
-	g_return_if_fail (iter->user_data != NULL);
+	GIcon *gicon = NULL;
+	const gchar *content_type;
+
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_ICON))
+		gicon = g_file_info_get_icon (info);
+	else if ((content_type = file_info_get_content_type (info)) != NULL)
+		gicon = model_get_content_type_icon (model, content_type);
+
+	g_clear_object (&node->gicon);
+	g_clear_object (&node->icon);
+
+	if (gicon == NULL)
+		return;
 
-	model_recomposite_icon_real (tree_model,
-				     (FileBrowserNode *)(iter->user_data),
-				     NULL);
+	/* Every file gets its own icon instance, keep only one of each */
+	node->gicon = g_hash_table_lookup (model->priv->gicons, gicon);
+
+	if (node->gicon == NULL)
+	{
+		node->gicon = gicon;
+		g_hash_table_add (model->priv->gicons, g_object_ref (gicon));
+	}
+
+	g_object_ref (node->gicon);
 }
 
 static FileBrowserNode *
@@ -1698,8 +3152,7 @@ model_create_dummy_node (GeditFileBrowserStore *model,
 	FileBrowserNode *dummy;
 
 	dummy = file_browser_node_new (NULL, parent);
-	dummy->name = g_strdup (_("(Empty)"));
-	dummy->markup = g_markup_escape_text (dummy->name, -1);
+	file_browser_node_take_name (dummy, g_strdup (_("(Empty)")));
 
 	dummy->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_DUMMY;
 	dummy->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
@@ -1736,23 +3189,24 @@ model_check_dummy (GeditFileBrowserStore *model,
 		GtkTreePath *path;
 		guint flags;
 
-		if (dir->children == NULL)
+		if (dir->children->len == 0)
 		{
 			model_add_dummy_node (model, node);
 			return;
 		}
 
-		dummy = (FileBrowserNode *)(dir->children->data);
+		dummy = g_ptr_array_index (dir->children, 0);
 
 		if (!NODE_IS_DUMMY (dummy))
 		{
 			dummy = model_create_dummy_node (model, node);
-			dir->children = g_slist_prepend (dir->children, dummy);
+			file_browser_node_dir_insert (dir, dummy, 0);
 		}
 
 		if (!model_node_visibility (model, node))
 		{
 			dummy->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+			file_browser_node_update_exposed (dummy);
 			return;
 		}
 
@@ -1760,10 +3214,12 @@ model_check_dummy (GeditFileBrowserStore *model,
 		   for real children */
 		flags = dummy->flags;
 		dummy->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+		file_browser_node_update_exposed (dummy);
 
 		if (!filter_tree_model_iter_has_child_real (model, node))
 		{
 			dummy->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+			file_browser_node_update_exposed (dummy);
 
 			if (FILE_IS_HIDDEN (flags))
 			{
@@ -1783,6 +3239,7 @@ model_check_dummy (GeditFileBrowserStore *model,
 			dummy->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
 			path = gedit_file_browser_store_get_path_real (model, dummy);
 			dummy->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+			file_browser_node_update_exposed (dummy);
 
 			row_deleted (model, dummy, path);
 			gtk_tree_path_free (path);
@@ -1796,11 +3253,24 @@ insert_node_sorted (GeditFileBrowserStore *model,
 		    FileBrowserNode       *parent)
 {
 	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
+	guint low = 0;
+	guint high = dir->children->len;
 
 	if (model->priv->sort_func == NULL)
-		dir->children = g_slist_append (dir->children, child);
-	else
-		dir->children = g_slist_insert_sorted (dir->children, child, (GCompareFunc)(model->priv->sort_func));
+		low = high;
+
+	/* Insert in front of the first child which does not sort before it */
+	while (low < high)
+	{
+		guint mid = low + (high - low) / 2;
+
+		if (model->priv->sort_func (child, g_ptr_array_index (dir->children, mid)) > 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	file_browser_node_dir_insert (dir, child, low);
 }
 
 static void
@@ -1808,6 +3278,8 @@ model_add_node (GeditFileBrowserStore *model,
 		FileBrowserNode       *child,
 		FileBrowserNode       *parent)
 {
+	child->status = file_browser_node_dir_get_status (FILE_BROWSER_NODE_DIR (parent), child);
+
 	/* Add child to parents children */
 	insert_node_sorted (model, child, parent);
 
@@ -1822,6 +3294,8 @@ model_add_node (GeditFileBrowserStore *model,
 		/* Emit row inserted */
 		row_inserted (model, &path, &iter);
 		gtk_tree_path_free (path);
+
+		rows_inserted (model, parent, &iter, 1);
 	}
 
 	model_check_dummy (model, parent);
@@ -1835,83 +3309,91 @@ model_add_nodes_batch (GeditFileBrowserStore *model,
 {
 	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
 	GSList *sorted_children = g_slist_sort (children, (GCompareFunc)model->priv->sort_func);
-	GSList *child = sorted_children;
-	GSList *prev = NULL;
-	GSList *l = dir->children;
+	GPtrArray *merged;
+	GArray *iters = NULL;
+	GtkTreePath *parent_path = NULL;
+	guint position = 0;
+	guint i = 0;
 
 	model_check_dummy (model, parent);
 
-	while (child)
-	{
-		FileBrowserNode *node = child->data;
-		GtkTreeIter iter;
-		GtkTreePath *path;
+	/* Merge the new nodes into the children in one go. Rows are only
+	   exposed once they are inserted, so the new nodes can all be put
+	   in place before the rows are emitted */
+	merged = g_ptr_array_sized_new (dir->children->len + g_slist_length (sorted_children));
 
-		/* Reached the end of the first list, just append the second */
-		if (l == NULL)
+	for (GSList *child = sorted_children; child; child = child->next)
+	{
+		while (i < dir->children->len &&
+		       model->priv->sort_func (g_ptr_array_index (dir->children, i), child->data) <= 0)
 		{
-			dir->children = g_slist_concat (dir->children, child);
+			g_ptr_array_add (merged, g_ptr_array_index (dir->children, i++));
+		}
 
-			for (l = child; l; l = l->next)
-			{
-				if (model_node_visibility (model, parent) &&
-				    model_node_visibility (model, l->data))
-				{
-					iter.user_data = l->data;
-					path = gedit_file_browser_store_get_path_real (model, l->data);
-
-					/* Emit row inserted */
-					row_inserted (model, &path, &iter);
-					gtk_tree_path_free (path);
-				}
-
-				model_check_dummy (model, l->data);
-			}
+		g_ptr_array_add (merged, child->data);
+	}
 
-			break;
-		}
+	for (; i < dir->children->len; ++i)
+		g_ptr_array_add (merged, g_ptr_array_index (dir->children, i));
 
-		if (model->priv->sort_func (l->data, node) > 0)
+	file_browser_node_dir_set_children (dir, merged);
+
+	for (GSList *child = sorted_children; child; child = child->next)
+		file_browser_node_dir_index_name (dir, child->data);
+
+	if (model_node_visibility (model, parent))
+	{
+		parent_path = gedit_file_browser_store_get_path_real (model, parent);
+		iters = g_array_new (FALSE, FALSE, sizeof (GtkTreeIter));
+	}
+
+	/* The new nodes come in the same order as in the children, so their
+	   rows can be located by walking the children once instead of
+	   computing the full path of every node */
+	i = 0;
+
+	for (GSList *child = sorted_children; child; child = child->next)
+	{
+		FileBrowserNode *node = child->data;
+
+		if (parent_path != NULL && model_node_visibility (model, node))
 		{
-			GSList *next_child;
+			GtkTreeIter iter;
+			GtkTreePath *path;
 
-			if (prev == NULL)
-			{
-				/* Prepend to the list */
-				dir->children = g_slist_prepend (dir->children, child);
-			}
-			else
+			for (; i < node->index; ++i)
 			{
-				prev->next = child;
+				if (file_browser_node_is_exposed (g_ptr_array_index (dir->children, i)))
+					++position;
 			}
 
-			next_child = child->next;
-			prev = child;
-			child->next = l;
-			child = next_child;
-
-			if (model_node_visibility (model, parent) &&
-			    model_node_visibility (model, node))
-			{
-				iter.user_data = node;
-				path = gedit_file_browser_store_get_path_real (model, node);
+			iter.user_data = node;
+			path = gtk_tree_path_copy (parent_path);
+			gtk_tree_path_append_index (path, position);
 
-				/* Emit row inserted */
-				row_inserted (model, &path, &iter);
-				gtk_tree_path_free (path);
-			}
+			/* Emit row inserted */
+			row_inserted (model, &path, &iter);
+			g_array_append_val (iters, iter);
 
-			model_check_dummy (model, node);
+			/* Continue from where the row ended up, in case the
+			   insertion caused other changes to the model */
+			position = gtk_tree_path_get_indices (path)[gtk_tree_path_get_depth (path) - 1] + 1;
+			i = node->index + 1;
 
-			/* Try again at the same l position with the next child */
-		}
-		else
-		{
-			/* Move to the next item in the list */
-			prev = l;
-			l = l->next;
+			gtk_tree_path_free (path);
 		}
+
+		model_check_dummy (model, node);
 	}
+
+	if (iters != NULL)
+	{
+		rows_inserted (model, parent, (GtkTreeIter *)iters->data, iters->len);
+		g_array_free (iters, TRUE);
+	}
+
+	gtk_tree_path_free (parent_path);
+	g_slist_free (sorted_children);
 }
 
 static gchar const *
@@ -1922,7 +3404,7 @@ backup_content_type (GFileInfo *info)
 	if (!g_file_info_get_is_backup (info))
 		return NULL;
 
-	content = g_file_info_get_content_type (info);
+	content = file_info_get_content_type (info);
 
 	if (!content || g_content_type_equals (content, "application/x-trash"))
 		return "text/plain";
@@ -1958,103 +3440,462 @@ content_type_is_text (gchar const *content_type)
 #endif
 }
 
-static void
-file_browser_node_set_from_info (GeditFileBrowserStore *model,
-				 FileBrowserNode       *node,
-				 GFileInfo             *info,
-				 gboolean               isadded)
+static gboolean
+file_info_is_text (GFileInfo *info)
 {
 	gchar const *content;
-	gboolean free_info = FALSE;
-	GtkTreePath *path;
-	gchar *uri;
-	GError *error = NULL;
-
-	if (info == NULL)
-	{
-		info = g_file_query_info (node->file,
-					  STANDARD_ATTRIBUTE_TYPES,
-					  G_FILE_QUERY_INFO_NONE,
-					  NULL,
-					  &error);
 
-		if (!info)
-		{
-			if (!(error->domain == G_IO_ERROR && error->code == G_IO_ERROR_NOT_FOUND))
-			{
-				uri = g_file_get_uri (node->file);
-				g_warning ("Could not get info for %s: %s", uri, error->message);
-				g_free (uri);
-			}
+	if (!(content = backup_content_type (info)))
+		content = file_info_get_content_type (info);
 
-			g_error_free (error);
-			return;
-		}
+	return content_type_is_text (content);
+}
 
-		free_info = TRUE;
-	}
+/* Sets the flags which only depend on info. This does not look at the
+   model, so it can be used while preparing nodes in another thread */
+static void
+file_browser_node_set_flags_from_info (FileBrowserNode *node,
+				       GFileInfo       *info)
+{
+	node->flags &= ~(GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN |
+			 GEDIT_FILE_BROWSER_STORE_FLAG_IS_TEXT);
 
 	if (g_file_info_get_is_hidden (info) || g_file_info_get_is_backup (info))
 		node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
 
 	if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
-	{
 		node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_DIRECTORY;
-	}
-	else
-	{
-		if (!(content = backup_content_type (info)))
-			content = g_file_info_get_content_type (info);
+	else if (file_info_is_text (info))
+		node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_TEXT;
 
-		if (content_type_is_text (content))
-			node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_TEXT;
-	}
-
-	model_recomposite_icon_real (model, node, info);
+	node->content_type_known = g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE);
+}
 
-	if (free_info)
-		g_object_unref (info);
+/* Files whose full content type is looked up together, in a thread */
+typedef struct
+{
+	GPtrArray *files;
 
-	if (isadded)
-	{
-		path = gedit_file_browser_store_get_path_real (model, node);
-		model_refilter_node (model, node, &path);
-		gtk_tree_path_free (path);
+	/* The files which could be queried, and their info */
+	GPtrArray *resolved;
+	GPtrArray *infos;
+} ContentTypeQuery;
 
-		model_check_dummy (model, node->parent);
-	}
-	else
-	{
-		model_node_update_visibility (model, node);
-	}
+static void
+content_type_query_free (ContentTypeQuery *query)
+{
+	g_ptr_array_unref (query->files);
+	g_ptr_array_unref (query->resolved);
+	g_ptr_array_unref (query->infos);
+	g_slice_free (ContentTypeQuery, query);
 }
 
-static FileBrowserNode *
-node_list_contains_file (GSList *children,
-			 GFile  *file)
+static void
+content_type_query_thread (GTask            *task,
+			   gpointer          source_object,
+			   ContentTypeQuery *query,
+			   GCancellable     *cancellable)
 {
-	for (GSList *item = children; item; item = item->next)
+	for (guint i = 0; i < query->files->len; ++i)
 	{
-		FileBrowserNode *node = (FileBrowserNode *)(item->data);
+		GFile *file = g_ptr_array_index (query->files, i);
+		GFileInfo *info;
+
+		if (g_cancellable_is_cancelled (cancellable))
+			break;
+
+		/* A file which is gone keeps its guessed content type */
+		info = g_file_query_info (file,
+					  CONTENT_ATTRIBUTE_TYPES,
+					  G_FILE_QUERY_INFO_NONE,
+					  cancellable,
+					  NULL);
 
-		if (node->file != NULL && g_file_equal (node->file, file))
-			return node;
+		if (info != NULL)
+		{
+			g_ptr_array_add (query->resolved, g_object_ref (file));
+			g_ptr_array_add (query->infos, info);
+		}
 	}
 
-	return NULL;
+	g_task_return_boolean (task, TRUE);
 }
 
-static FileBrowserNode *
-model_add_node_from_file (GeditFileBrowserStore *model,
-			  FileBrowserNode       *parent,
-			  GFile                 *file,
-			  GFileInfo             *info)
+/* Updates node from its full content type, which may change its icon
+   and whether it is text */
+static void
+model_node_set_content_type_from_info (GeditFileBrowserStore *model,
+				       FileBrowserNode       *node,
+				       GFileInfo             *info)
+{
+	gboolean was_text = NODE_IS_TEXT (node);
+	GIcon *gicon = node->gicon;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+
+	if (!NODE_IS_DIR (node))
+	{
+		node->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_TEXT;
+
+		if (file_info_is_text (info))
+			node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_TEXT;
+	}
+
+	model_node_set_icon_from_info (model, node, info);
+
+	/* Files hidden as binary until now may show up, or the other way
+	   around */
+	if (was_text != NODE_IS_TEXT (node))
+		model_refilter_node (model, node, NULL, 0, FALSE, FALSE, NULL);
+
+	if (gicon != node->gicon && model_node_visibility (model, node))
+	{
+		iter.user_data = node;
+		path = gedit_file_browser_store_get_path_real (model, node);
+		row_changed (model, &path, &iter);
+		gtk_tree_path_free (path);
+	}
+}
+
+static gboolean model_resolve_next_content_types (GeditFileBrowserStore *model);
+
+static void
+content_type_query_cb (GObject               *source_object,
+		       GAsyncResult          *result,
+		       GeditFileBrowserStore *model)
+{
+	GTask *task = G_TASK (result);
+	ContentTypeQuery *query = g_task_get_task_data (task);
+
+	/* Simply return if we were cancelled, the model may be gone */
+	if (g_cancellable_is_cancelled (g_task_get_cancellable (task)))
+		return;
+
+	g_clear_object (&model->priv->content_type_cancellable);
+
+	for (guint i = 0; i < query->resolved->len; ++i)
+	{
+		FileBrowserNode *node;
+
+		node = model_find_node (model, g_ptr_array_index (query->resolved, i));
+
+		if (node != NULL)
+			model_node_set_content_type_from_info (model, node, g_ptr_array_index (query->infos, i));
+	}
+
+	/* Rows which were shown in the meantime */
+	model_resolve_next_content_types (model);
+}
+
+static gboolean
+model_resolve_next_content_types (GeditFileBrowserStore *model)
+{
+	ContentTypeQuery *query;
+	GTask *task;
+
+	model->priv->content_type_queue_id = 0;
+
+	/* The running query starts the next one when it is done */
+	if (model->priv->content_type_cancellable != NULL ||
+	    model->priv->content_type_queue->len == 0)
+	{
+		return G_SOURCE_REMOVE;
+	}
+
+	query = g_slice_new (ContentTypeQuery);
+	query->files = model->priv->content_type_queue;
+	query->resolved = g_ptr_array_new_with_free_func (g_object_unref);
+	query->infos = g_ptr_array_new_with_free_func (g_object_unref);
+
+	model->priv->content_type_queue = g_ptr_array_new_with_free_func (g_object_unref);
+	model->priv->content_type_cancellable = g_cancellable_new ();
+
+	task = g_task_new (NULL,
+			   model->priv->content_type_cancellable,
+			   (GAsyncReadyCallback)content_type_query_cb,
+			   model);
+	g_task_set_task_data (task, query, (GDestroyNotify)content_type_query_free);
+	g_task_run_in_thread (task, (GTaskThreadFunc)content_type_query_thread);
+	g_object_unref (task);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Queues looking up the full content type of node. The rows shown at
+   once are looked up together, when idle */
+static void
+model_resolve_content_type (GeditFileBrowserStore *model,
+			    FileBrowserNode       *node)
+{
+	node->content_type_known = TRUE;
+	g_ptr_array_add (model->priv->content_type_queue, file_browser_node_get_file (node));
+
+	if (model->priv->content_type_queue_id == 0)
+	{
+		model->priv->content_type_queue_id =
+			g_idle_add ((GSourceFunc)model_resolve_next_content_types, model);
+	}
+}
+
+static void
+model_cancel_content_types (GeditFileBrowserStore *model)
+{
+	if (model->priv->content_type_queue_id != 0)
+	{
+		g_source_remove (model->priv->content_type_queue_id);
+		model->priv->content_type_queue_id = 0;
+	}
+
+	if (model->priv->content_type_cancellable != NULL)
+	{
+		g_cancellable_cancel (model->priv->content_type_cancellable);
+		g_clear_object (&model->priv->content_type_cancellable);
+	}
+
+	g_ptr_array_set_size (model->priv->content_type_queue, 0);
+}
+
+typedef struct
+{
+	GeditFileBrowserStatusProvider *provider;
+	GFile                          *location;
+	GHashTable                     *statuses;
+} StatusQuery;
+
+static void
+status_query_free (StatusQuery *query)
+{
+	g_object_unref (query->provider);
+	g_object_unref (query->location);
+
+	if (query->statuses != NULL)
+		g_hash_table_unref (query->statuses);
+
+	g_slice_free (StatusQuery, query);
+}
+
+/* Runs in a thread, the provider goes through the whole directory in
+   one go */
+static void
+status_query_thread (GTask        *task,
+		     gpointer      source_object,
+		     StatusQuery  *query,
+		     GCancellable *cancellable)
+{
+	query->statuses = gedit_file_browser_status_provider_get_statuses (query->provider,
+									   query->location,
+									   cancellable,
+									   NULL);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+/* Updates the statuses of all the children of dir in one pass. Only the
+   shown rows whose status changed are rendered again */
+static void
+model_apply_statuses (GeditFileBrowserStore *model,
+		      FileBrowserNodeDir    *dir)
+{
+	for (guint i = 0; i < dir->children->len; ++i)
+	{
+		FileBrowserNode *child = g_ptr_array_index (dir->children, i);
+		GeditFileBrowserStatus status = file_browser_node_dir_get_status (dir, child);
+		GtkTreePath *path;
+		GtkTreeIter iter;
+
+		if (NODE_IS_DUMMY (child) || child->status == status)
+			continue;
+
+		child->status = status;
+
+		/* The emblem changed, the icon is rendered again when asked for */
+		g_clear_object (&child->icon);
+
+		if (model_node_visibility (model, child))
+		{
+			iter.user_data = child;
+			path = gedit_file_browser_store_get_path_real (model, child);
+			row_changed (model, &path, &iter);
+			gtk_tree_path_free (path);
+		}
+	}
+}
+
+static void
+status_query_cb (GObject            *source_object,
+		 GAsyncResult       *result,
+		 FileBrowserNodeDir *dir)
+{
+	GTask *task = G_TASK (result);
+	StatusQuery *query = g_task_get_task_data (task);
+
+	/* The directory was unloaded in the meantime */
+	if (g_cancellable_is_cancelled (g_task_get_cancellable (task)))
+		return;
+
+	g_clear_object (&dir->statuses_cancellable);
+
+	/* Keep showing the previous statuses when the provider failed */
+	if (query->statuses != NULL)
+	{
+		g_clear_pointer (&dir->statuses, g_hash_table_unref);
+		dir->statuses = g_steal_pointer (&query->statuses);
+
+		model_apply_statuses (dir->model, dir);
+	}
+
+	/* Changes which came in while querying */
+	if (dir->statuses_stale)
+		schedule_statuses (dir->model, (FileBrowserNode *)dir);
+}
+
+static gboolean
+query_statuses (FileBrowserNodeDir *dir)
+{
+	StatusQuery *query;
+	GTask *task;
+
+	dir->statuses_id = 0;
+
+	/* Only one query at a time, this is queried again once the running
+	   one is done */
+	if (dir->statuses_cancellable != NULL)
+	{
+		dir->statuses_stale = TRUE;
+		return G_SOURCE_REMOVE;
+	}
+
+	dir->statuses_stale = FALSE;
+	dir->statuses_cancellable = g_cancellable_new ();
+
+	query = g_slice_new0 (StatusQuery);
+	query->provider = g_object_ref (dir->model->priv->status_provider);
+	query->location = g_object_ref (((FileBrowserNode *)dir)->file);
+
+	task = g_task_new (NULL,
+			   dir->statuses_cancellable,
+			   (GAsyncReadyCallback)status_query_cb,
+			   dir);
+	g_task_set_task_data (task, query, (GDestroyNotify)status_query_free);
+	g_task_run_in_thread (task, (GTaskThreadFunc)status_query_thread);
+	g_object_unref (task);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Statuses are queried for the whole directory once changes to it have
+   settled down, like the monitor events */
+static void
+schedule_statuses (GeditFileBrowserStore *model,
+		   FileBrowserNode       *node)
+{
+	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
+
+	if (model->priv->status_provider == NULL ||
+	    !model->priv->show_status ||
+	    node->file == NULL)
+	{
+		return;
+	}
+
+	if (dir->statuses_id == 0)
+	{
+		dir->statuses_id = g_timeout_add (MONITOR_EVENTS_COALESCE_MSEC,
+						  (GSourceFunc)query_statuses,
+						  dir);
+	}
+}
+
+static void
+file_browser_node_dir_clear_statuses (FileBrowserNodeDir *dir)
+{
+	if (dir->statuses_id != 0)
+	{
+		g_source_remove (dir->statuses_id);
+		dir->statuses_id = 0;
+	}
+
+	if (dir->statuses_cancellable != NULL)
+	{
+		g_cancellable_cancel (dir->statuses_cancellable);
+		g_clear_object (&dir->statuses_cancellable);
+	}
+
+	dir->statuses_stale = FALSE;
+	g_clear_pointer (&dir->statuses, g_hash_table_unref);
+}
+
+static void
+file_browser_node_set_from_info (GeditFileBrowserStore *model,
+				 FileBrowserNode       *node,
+				 GFileInfo             *info,
+				 gboolean               isadded)
+{
+	gboolean free_info = FALSE;
+	GtkTreePath *path;
+	gchar *uri;
+	GError *error = NULL;
+
+	if (info == NULL)
+	{
+		GFile *file = file_browser_node_get_file (node);
+
+		info = g_file_query_info (file,
+					  STANDARD_ATTRIBUTE_TYPES,
+					  G_FILE_QUERY_INFO_NONE,
+					  NULL,
+					  &error);
+
+		if (!info)
+		{
+			if (!(error->domain == G_IO_ERROR && error->code == G_IO_ERROR_NOT_FOUND))
+			{
+				uri = g_file_get_uri (file);
+				g_warning ("Could not get info for %s: %s", uri, error->message);
+				g_free (uri);
+			}
+
+			g_object_unref (file);
+			g_error_free (error);
+			return;
+		}
+
+		g_object_unref (file);
+
+		free_info = TRUE;
+	}
+
+	file_browser_node_set_flags_from_info (node, info);
+	model_node_set_icon_from_info (model, node, info);
+
+	if (free_info)
+		g_object_unref (info);
+
+	if (isadded)
+	{
+		path = gedit_file_browser_store_get_path_real (model, node);
+		model_refilter_node (model, node, &path, FILTER_VERDICT_ALL, FALSE, FALSE, NULL);
+		gtk_tree_path_free (path);
+
+		model_check_dummy (model, node->parent);
+	}
+	else
+	{
+		model_node_update_visibility (model, node);
+	}
+}
+
+static FileBrowserNode *
+model_add_node_from_file (GeditFileBrowserStore *model,
+			  FileBrowserNode       *parent,
+			  GFile                 *file,
+			  GFileInfo             *info)
 {
 	FileBrowserNode *node;
 	gboolean free_info = FALSE;
 	GError *error = NULL;
 
-	if ((node = node_list_contains_file (FILE_BROWSER_NODE_DIR (parent)->children, file)) == NULL)
+	if ((node = file_browser_node_dir_find_file (FILE_BROWSER_NODE_DIR (parent), file)) == NULL)
 	{
 		if (info == NULL)
 		{
@@ -2093,306 +3934,1411 @@ model_add_node_from_file (GeditFileBrowserStore *model,
 	return node;
 }
 
-/* We pass in a copy of the list of parent->children so that we do
- * not have to check if a file already exists among the ones we just
- * added */
+static gboolean
+file_info_is_listed (GFileInfo *info)
+{
+	GFileType type = g_file_info_get_file_type (info);
+	gchar const *name;
+
+	/* Skip all non regular, non directory files */
+	if (type != G_FILE_TYPE_REGULAR &&
+	    type != G_FILE_TYPE_DIRECTORY &&
+	    type != G_FILE_TYPE_SYMBOLIC_LINK)
+	{
+		return FALSE;
+	}
+
+	name = g_file_info_get_name (info);
+
+	/* Skip '.' and '..' directories */
+	return type != G_FILE_TYPE_DIRECTORY ||
+	       (strcmp (name, ".") != 0 && strcmp (name, "..") != 0);
+}
+
+/* Builds the node for file and appends it to batch, taking ownership
+   of info. This can be called from any thread */
+static void
+loaded_nodes_append (GArray                *batch,
+		     GeditFileBrowserStore *model,
+		     FileBrowserNode       *parent,
+		     GFile                 *file,
+		     GFileInfo             *info)
+{
+	LoadedNode loaded;
+
+	if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+		loaded.node = file_browser_node_dir_new (model, NULL, parent);
+	else
+		loaded.node = file_browser_node_new (NULL, parent);
+
+	file_browser_node_set_file (loaded.node, file);
+
+	/* For local files this is the name file_browser_node_set_name
+	   would query for, so save the round trip */
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME) &&
+	    g_file_has_uri_scheme (file, "file"))
+	{
+		file_browser_node_take_name (loaded.node, g_strdup (g_file_info_get_display_name (info)));
+	}
+	else
+	{
+		file_browser_node_set_name (loaded.node);
+	}
+
+	file_browser_node_set_flags_from_info (loaded.node, info);
+	loaded.info = info;
+
+	g_array_append_val (batch, loaded);
+}
+
+static void
+loaded_node_clear (LoadedNode *loaded)
+{
+	if (loaded->node != NULL)
+		file_browser_node_free_unused (loaded->node);
+
+	g_object_unref (loaded->info);
+}
+
+static LoadBatch *
+load_batch_new (void)
+{
+	LoadBatch *batch = g_slice_new (LoadBatch);
+
+	batch->removed = g_ptr_array_new_with_free_func (g_free);
+	batch->nodes = g_array_sized_new (FALSE, FALSE, sizeof (LoadedNode), DIRECTORY_LOAD_ITEMS_PER_CALLBACK);
+	g_array_set_clear_func (batch->nodes, (GDestroyNotify)loaded_node_clear);
+
+	return batch;
+}
+
+static void
+load_batch_free (LoadBatch *batch)
+{
+	g_ptr_array_unref (batch->removed);
+	g_array_unref (batch->nodes);
+	g_slice_free (LoadBatch, batch);
+}
+
+/* Merges a batch of LoadedNode prepared by the loading thread into
+   parent, skipping the files which are already there */
 static void
-model_add_nodes_from_files (GeditFileBrowserStore *model,
-			    FileBrowserNode       *parent,
-			    GSList                *original_children,
-			    GList                 *files)
+model_add_loaded_nodes (GeditFileBrowserStore *model,
+			FileBrowserNode       *parent,
+			GArray                *batch)
 {
+	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
+	GPtrArray *added = g_ptr_array_sized_new (batch->len);
 	GSList *nodes = NULL;
 
-	for (GList *item = files; item; item = item->next)
+	for (guint i = 0; i < batch->len; ++i)
 	{
-		GFileInfo *info = G_FILE_INFO (item->data);
-		GFileType type = g_file_info_get_file_type (info);
-		gchar const *name;
-		GFile *file;
-		FileBrowserNode *node;
+		LoadedNode *loaded = &g_array_index (batch, LoadedNode, i);
 
-		/* Skip all non regular, non directory files */
-		if (type != G_FILE_TYPE_REGULAR &&
-		    type != G_FILE_TYPE_DIRECTORY &&
-		    type != G_FILE_TYPE_SYMBOLIC_LINK)
-		{
-			g_object_unref (info);
+		if (file_browser_node_dir_find_name (dir, g_file_info_get_name (loaded->info)))
 			continue;
-		}
 
-		name = g_file_info_get_name (info);
+		/* Until the next query, new files get the last known status */
+		loaded->node->status = file_browser_node_dir_get_status (dir, loaded->node);
 
-		/* Skip '.' and '..' directories */
-		if (type == G_FILE_TYPE_DIRECTORY &&
-		    (strcmp (name, ".") == 0 ||
-		     strcmp (name, "..") == 0))
-		{
-			g_object_unref (info);
-			continue;
-		}
+		model_node_set_icon_from_info (model, loaded->node, loaded->info);
+		model_node_update_verdicts (model, loaded->node, FILTER_VERDICT_ALL & ~FILTER_VERDICT_BATCH);
 
-		file = g_file_get_child (parent->file, name);
-		if (!(node = node_list_contains_file (original_children, file)))
-		{
-			if (type == G_FILE_TYPE_DIRECTORY)
-				node = file_browser_node_dir_new (model, file, parent);
-			else
-				node = file_browser_node_new (file, parent);
+		g_ptr_array_add (added, loaded->node);
+		loaded->node = NULL;
+	}
+
+	/* One call to the batch filter for the whole batch */
+	model_nodes_update_batch_verdicts (model, (FileBrowserNode **)added->pdata, added->len);
+
+	for (guint i = 0; i < added->len; ++i)
+	{
+		FileBrowserNode *node = g_ptr_array_index (added, i);
+
+		model_node_update_filtered (model, node);
+		nodes = g_slist_prepend (nodes, node);
+	}
+
+	if (nodes)
+		model_add_nodes_batch (model, nodes, parent);
+
+	/* Directories to be expanded again are loaded right away, without
+	   waiting for the view to get to them */
+	for (guint i = 0; model->priv->prefetches != NULL && i < added->len; ++i)
+	{
+		FileBrowserNode *node = g_ptr_array_index (added, i);
+
+		if (NODE_IS_DIR (node) && !NODE_LOADED (node) &&
+		    g_hash_table_contains (model->priv->prefetches, node->file))
+		{
+			model_load_directory (model, node);
+		}
+	}
+
+	g_ptr_array_unref (added);
+}
+
+static FileBrowserNode *
+model_add_node_from_dir (GeditFileBrowserStore *model,
+			 FileBrowserNode       *parent,
+			 GFile                 *file)
+{
+	FileBrowserNode *node;
+
+	/* Check if it already exists */
+	if ((node = file_browser_node_dir_find_file (FILE_BROWSER_NODE_DIR (parent), file)) == NULL)
+	{
+		node = file_browser_node_dir_new (model, file, parent);
+		file_browser_node_set_from_info (model, node, NULL, FALSE);
+
+		if (node->name == NULL)
+			file_browser_node_set_name (node);
+
+		node->icon_name = g_intern_static_string ("folder-symbolic");
+
+		model_add_node (model, node, parent);
+	}
+
+	return node;
+}
+
+static void
+monitor_query_free (MonitorQuery *query)
+{
+	g_object_unref (query->cancellable);
+	g_ptr_array_unref (query->files);
+	g_ptr_array_unref (query->replaced);
+
+	if (query->batch != NULL)
+		g_array_unref (query->batch);
+
+	g_slice_free (MonitorQuery, query);
+}
+
+/* Runs in a thread, queries the info of all the files in one go */
+static void
+monitor_query_thread (GTask        *task,
+		      gpointer      source_object,
+		      MonitorQuery *query,
+		      GCancellable *cancellable)
+{
+	query->batch = g_array_sized_new (FALSE, FALSE, sizeof (LoadedNode), query->files->len);
+	g_array_set_clear_func (query->batch, (GDestroyNotify)loaded_node_clear);
+
+	for (guint i = 0; i < query->files->len; ++i)
+	{
+		GFile *file = g_ptr_array_index (query->files, i);
+		GFileInfo *info;
+
+		if (g_cancellable_is_cancelled (cancellable))
+			break;
+
+		/* The file may well be gone again by now */
+		info = g_file_query_info (file,
+					  STANDARD_ATTRIBUTE_TYPES,
+					  G_FILE_QUERY_INFO_NONE,
+					  cancellable,
+					  NULL);
+
+		if (info == NULL)
+			continue;
+
+		if (file_info_is_listed (info))
+			loaded_nodes_append (query->batch, query->model, (FileBrowserNode *)query->dir, file, info);
+		else
+			g_object_unref (info);
+	}
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+monitor_query_cb (GObject      *source_object,
+		  GAsyncResult *result,
+		  MonitorQuery *query)
+{
+	FileBrowserNodeDir *dir = query->dir;
+
+	/* The directory was unloaded in the meantime */
+	if (g_cancellable_is_cancelled (query->cancellable))
+		return;
+
+	g_clear_object (&dir->monitor_cancellable);
+
+	for (guint i = 0; i < query->replaced->len; ++i)
+	{
+		FileBrowserNode *node;
+
+		node = file_browser_node_dir_find_file (dir, g_ptr_array_index (query->replaced, i));
+
+		if (node != NULL)
+			model_remove_node (dir->model, node, NULL, TRUE);
+	}
+
+	model_add_loaded_nodes (dir->model, (FileBrowserNode *)dir, query->batch);
+
+	/* Events which came in while querying */
+	if (dir->monitor_events != NULL && g_hash_table_size (dir->monitor_events) > 0)
+		schedule_monitor_events (dir);
+}
+
+static gboolean
+apply_monitor_events (FileBrowserNodeDir *dir)
+{
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+	GPtrArray *files;
+	GPtrArray *replaced;
+
+	dir->monitor_events_id = 0;
+
+	/* Wait for the previous events to be applied first, this is
+	   rescheduled when they are */
+	if (dir->monitor_cancellable != NULL)
+		return G_SOURCE_REMOVE;
+
+	files = g_ptr_array_new_with_free_func (g_object_unref);
+	replaced = g_ptr_array_new_with_free_func (g_object_unref);
+
+	g_hash_table_iter_init (&iter, dir->monitor_events);
+
+	while (g_hash_table_iter_next (&iter, &key, &value))
+	{
+		GFile *file = key;
+		FileBrowserNode *node;
+
+		switch (GPOINTER_TO_INT (value))
+		{
+			case MONITOR_EVENT_DELETED:
+				node = file_browser_node_dir_find_file (dir, file);
+
+				if (node != NULL)
+					model_remove_node (dir->model, node, NULL, TRUE);
+				break;
+			case MONITOR_EVENT_REPLACED:
+				g_ptr_array_add (replaced, g_object_ref (file));
+				/* fall through */
+			case MONITOR_EVENT_CREATED:
+				g_ptr_array_add (files, g_object_ref (file));
+				break;
+		}
+	}
+
+	g_hash_table_remove_all (dir->monitor_events);
+
+	if (files->len > 0)
+	{
+		MonitorQuery *query = g_slice_new0 (MonitorQuery);
+		GTask *task;
+
+		dir->monitor_cancellable = g_cancellable_new ();
+
+		query->model = dir->model;
+		query->dir = dir;
+		query->cancellable = g_object_ref (dir->monitor_cancellable);
+		query->files = files;
+		query->replaced = replaced;
+
+		task = g_task_new (NULL,
+				   query->cancellable,
+				   (GAsyncReadyCallback)monitor_query_cb,
+				   query);
+		g_task_set_task_data (task, query, (GDestroyNotify)monitor_query_free);
+		g_task_run_in_thread (task, (GTaskThreadFunc)monitor_query_thread);
+		g_object_unref (task);
+	}
+	else
+	{
+		g_ptr_array_unref (files);
+		g_ptr_array_unref (replaced);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_monitor_events (FileBrowserNodeDir *dir)
+{
+	if (dir->monitor_events_id == 0)
+	{
+		dir->monitor_events_id = g_timeout_add (MONITOR_EVENTS_COALESCE_MSEC,
+							(GSourceFunc)apply_monitor_events,
+							dir);
+	}
+}
+
+static void
+file_browser_node_dir_clear_monitor_events (FileBrowserNodeDir *dir)
+{
+	if (dir->monitor_events_id != 0)
+	{
+		g_source_remove (dir->monitor_events_id);
+		dir->monitor_events_id = 0;
+	}
+
+	if (dir->monitor_cancellable != NULL)
+	{
+		g_cancellable_cancel (dir->monitor_cancellable);
+		g_clear_object (&dir->monitor_cancellable);
+	}
+
+	g_clear_pointer (&dir->monitor_events, g_hash_table_unref);
+}
+
+/* Events are not applied right away, but gathered for a moment so that
+   a burst of changes results in a single query and batched changes to
+   the model. Only the last state of each file matters */
+static void
+on_directory_monitor_event (GFileMonitor      *monitor,
+			    GFile             *file,
+			    GFile             *other_file,
+			    GFileMonitorEvent  event_type,
+			    FileBrowserNode   *parent)
+{
+	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
+	MonitorEvent previous;
+	MonitorEvent event;
+
+	/* Saving a file changes its status without changing the listing */
+	if (dir->model->priv->status_provider != NULL && dir->model->priv->show_status)
+	{
+		gedit_file_browser_status_provider_file_changed (dir->model->priv->status_provider,
+								 file);
+		schedule_statuses (dir->model, parent);
+	}
+
+	switch (event_type)
+	{
+		case G_FILE_MONITOR_EVENT_DELETED:
+			event = MONITOR_EVENT_DELETED;
+			break;
+		case G_FILE_MONITOR_EVENT_CREATED:
+			event = MONITOR_EVENT_CREATED;
+			break;
+		default:
+			return;
+	}
+
+	if (dir->monitor_events == NULL)
+	{
+		dir->monitor_events = g_hash_table_new_full (g_file_hash,
+							     (GEqualFunc)g_file_equal,
+							     g_object_unref,
+							     NULL);
+	}
+
+	previous = GPOINTER_TO_INT (g_hash_table_lookup (dir->monitor_events, file));
+
+	/* A file deleted and created again needs its node refreshed, while
+	   a file created and deleted again just needs to go, if it was
+	   there at all */
+	if (event == MONITOR_EVENT_CREATED &&
+	    (previous == MONITOR_EVENT_DELETED || previous == MONITOR_EVENT_REPLACED))
+	{
+		event = MONITOR_EVENT_REPLACED;
+	}
+
+	g_hash_table_replace (dir->monitor_events, g_object_ref (file), GINT_TO_POINTER (event));
+	schedule_monitor_events (dir);
+}
+
+static AsyncNode *
+async_node_ref (AsyncNode *async)
+{
+	g_atomic_int_inc (&async->ref_count);
+	return async;
+}
+
+/* The last reference can be dropped by the loading thread, so this
+   must not touch the model */
+static void
+async_node_unref (AsyncNode *async)
+{
+	LoadBatch *batch;
+
+	if (!g_atomic_int_dec_and_test (&async->ref_count))
+		return;
+
+	while ((batch = g_queue_pop_head (&async->batches)))
+		load_batch_free (batch);
+
+	g_list_free_full (async->infos, g_object_unref);
+
+	g_mutex_clear (&async->lock);
+	g_main_context_unref (async->context);
+	g_object_unref (async->cancellable);
+	g_object_unref (async->file);
+	g_slice_free (AsyncNode, async);
+}
+
+static void
+model_end_directory_load (AsyncNode *async)
+{
+	FileBrowserNodeDir *dir = async->dir;
+	FileBrowserNode *parent = (FileBrowserNode *)dir;
+
+	/* We're done loading */
+	g_object_unref (dir->cancellable);
+	dir->cancellable = NULL;
+
+/*
+ * FIXME: This is temporarly, it is a bug in gio:
+ * http://bugzilla.gnome.org/show_bug.cgi?id=565924
+ */
+#ifndef G_OS_WIN32
+	if (g_file_is_native (parent->file) && dir->monitor == NULL)
+	{
+		dir->monitor = g_file_monitor_directory (parent->file,
+							 G_FILE_MONITOR_NONE,
+							 NULL,
+							 NULL);
+		if (dir->monitor != NULL)
+		{
+			g_signal_connect (dir->monitor,
+					  "changed",
+					  G_CALLBACK (on_directory_monitor_event),
+					  parent);
+		}
+	}
+#endif
+
+	model_check_dummy (dir->model, parent);
+	model_end_loading (dir->model, parent);
+
+	schedule_statuses (dir->model, parent);
+}
+
+/* Merges the batches handed over by the loading thread until the time
+   budget runs out, so that the view keeps drawing while a large
+   directory comes in */
+static gboolean
+model_merge_loaded_batches (AsyncNode *async)
+{
+	gint64 deadline = g_get_monotonic_time () + DIRECTORY_LOAD_MERGE_BUDGET_USEC;
+	gboolean finished;
+
+	while (!g_cancellable_is_cancelled (async->cancellable))
+	{
+		LoadBatch *batch;
+
+		g_mutex_lock (&async->lock);
+		batch = g_queue_pop_head (&async->batches);
+
+		if (batch == NULL)
+		{
+			async->merging = FALSE;
+			finished = async->enumerated;
+			g_mutex_unlock (&async->lock);
+
+			if (finished)
+				model_end_directory_load (async);
+
+			return G_SOURCE_REMOVE;
+		}
+
+		g_mutex_unlock (&async->lock);
+
+		for (guint i = 0; i < batch->removed->len; ++i)
+		{
+			FileBrowserNode *node;
+
+			node = file_browser_node_dir_find_name (async->dir, g_ptr_array_index (batch->removed, i));
+
+			if (node != NULL)
+				model_remove_node (async->model, node, NULL, TRUE);
+		}
+
+		model_add_loaded_nodes (async->model, (FileBrowserNode *)async->dir, batch->nodes);
+		load_batch_free (batch);
+
+		if (g_get_monotonic_time () >= deadline)
+			return G_SOURCE_CONTINUE;
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Runs in the loading thread */
+static void
+async_node_push_batch (AsyncNode *async,
+		       LoadBatch *batch)
+{
+	gboolean schedule;
+
+	g_mutex_lock (&async->lock);
+	g_queue_push_tail (&async->batches, batch);
+	schedule = !async->merging;
+	async->merging = TRUE;
+	g_mutex_unlock (&async->lock);
+
+	if (schedule)
+	{
+		GSource *source = g_idle_source_new ();
+
+		g_source_set_priority (source, G_PRIORITY_DEFAULT_IDLE);
+		g_source_set_callback (source,
+				       (GSourceFunc)model_merge_loaded_batches,
+				       async_node_ref (async),
+				       (GDestroyNotify)async_node_unref);
+		g_source_attach (source, async->context);
+		g_source_unref (source);
+	}
+}
+
+static GFile *
+snapshot_file_for_location (GFile *location)
+{
+	gchar *uri;
+	gchar *checksum;
+	gchar *path;
+	GFile *file;
+
+	uri = g_file_get_uri (location);
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, uri, -1);
+	path = g_build_filename (g_get_user_cache_dir (), "gedit", "file-browser", checksum, NULL);
+
+	file = g_file_new_for_path (path);
+
+	g_free (path);
+	g_free (checksum);
+	g_free (uri);
+
+	return file;
+}
+
+/* Returns the part of info which is kept in a snapshot, the entries of
+   a file are equal as long as it did not change */
+static GVariant *
+snapshot_entry_new (GFileInfo *info)
+{
+	GIcon *icon = NULL;
+	gchar *icon_str = NULL;
+	GFileType type = g_file_info_get_file_type (info);
+	guint64 mtime = 0;
+	const gchar *content_type = file_info_get_content_type (info);
+	GVariant *entry;
+
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_ICON))
+		icon = g_file_info_get_icon (info);
+
+	if (icon != NULL)
+		icon_str = g_icon_to_string (icon);
+
+	/* The contents of a directory changing does not change its node,
+	   and refreshing it would collapse it */
+	if (type != G_FILE_TYPE_DIRECTORY)
+		mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+	entry = g_variant_new ("(ssubbsst)",
+			       g_file_info_get_name (info),
+			       g_file_info_get_display_name (info) ? g_file_info_get_display_name (info) : "",
+			       type,
+			       g_file_info_get_is_hidden (info),
+			       g_file_info_get_is_backup (info),
+			       content_type ? content_type : "",
+			       icon_str ? icon_str : "",
+			       mtime);
+
+	g_free (icon_str);
+	return g_variant_ref_sink (entry);
+}
+
+static GFileInfo *
+snapshot_entry_to_info (GVariant *entry)
+{
+	GFileInfo *info = g_file_info_new ();
+	const gchar *name;
+	const gchar *display_name;
+	const gchar *content_type;
+	const gchar *icon_str;
+	guint32 type;
+	gboolean hidden;
+	gboolean backup;
+	guint64 mtime;
+
+	g_variant_get (entry, "(&s&subb&s&st)",
+		       &name, &display_name, &type, &hidden, &backup,
+		       &content_type, &icon_str, &mtime);
+
+	g_file_info_set_name (info, name);
+	g_file_info_set_file_type (info, type);
+	g_file_info_set_is_hidden (info, hidden);
+	g_file_info_set_is_backup (info, backup);
+	g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED, mtime);
+
+	if (*display_name != '\0')
+		g_file_info_set_display_name (info, display_name);
+
+	/* Kept as a guess, the file may have changed since */
+	if (*content_type != '\0')
+		g_file_info_set_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE, content_type);
+
+	if (*icon_str != '\0')
+	{
+		GIcon *icon = g_icon_new_for_string (icon_str, NULL);
+
+		if (icon != NULL)
+		{
+			g_file_info_set_icon (info, icon);
+			g_object_unref (icon);
+		}
+	}
+
+	return info;
+}
+
+/* Reads the snapshot of location, if there is one, into a table from
+   the file names to their entries */
+static GHashTable *
+snapshot_load (GFile        *location,
+	       GCancellable *cancellable)
+{
+	GFile *file = snapshot_file_for_location (location);
+	GHashTable *entries = NULL;
+	GVariant *snapshot;
+	GVariant *children;
+	const gchar *uri;
+	gchar *contents;
+	gchar *location_uri;
+	gsize length;
+
+	if (!g_file_load_contents (file, cancellable, &contents, &length, NULL, NULL))
+	{
+		g_object_unref (file);
+		return NULL;
+	}
+
+	g_object_unref (file);
+
+	snapshot = g_variant_new_from_data (G_VARIANT_TYPE (SNAPSHOT_VARIANT_TYPE),
+					    contents, length, FALSE,
+					    g_free, contents);
+	g_variant_ref_sink (snapshot);
+
+	g_variant_get (snapshot, "(&s@a(ssubbsst))", &uri, &children);
+	location_uri = g_file_get_uri (location);
+
+	/* Guard against hash collisions */
+	if (g_strcmp0 (uri, location_uri) == 0)
+	{
+		GVariantIter iter;
+		GVariant *entry;
+
+		entries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify)g_variant_unref);
+		g_variant_iter_init (&iter, children);
+
+		while ((entry = g_variant_iter_next_value (&iter)))
+		{
+			const gchar *name;
+
+			/* The name points into the entry, which the table owns */
+			g_variant_get_child (entry, 0, "&s", &name);
+			g_hash_table_replace (entries, (gpointer)name, entry);
+		}
+	}
+
+	g_free (location_uri);
+	g_variant_unref (children);
+	g_variant_unref (snapshot);
+
+	return entries;
+}
+
+/* Drops the least recently written snapshots */
+static void
+snapshot_prune (GFile *dir)
+{
+	GFileEnumerator *enumerator;
+	GPtrArray *infos;
+	GFileInfo *info;
+
+	enumerator = g_file_enumerate_children (dir,
+						G_FILE_ATTRIBUTE_STANDARD_NAME ","
+						G_FILE_ATTRIBUTE_TIME_MODIFIED,
+						G_FILE_QUERY_INFO_NONE,
+						NULL,
+						NULL);
+
+	if (enumerator == NULL)
+		return;
+
+	infos = g_ptr_array_new_with_free_func (g_object_unref);
+
+	while ((info = g_file_enumerator_next_file (enumerator, NULL, NULL)))
+		g_ptr_array_add (infos, info);
+
+	g_object_unref (enumerator);
+
+	while (infos->len > SNAPSHOT_MAX_FILES)
+	{
+		guint oldest = 0;
+		GFile *file;
+
+		for (guint i = 1; i < infos->len; ++i)
+		{
+			guint64 mtime = g_file_info_get_attribute_uint64 (g_ptr_array_index (infos, i),
+									  G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+			if (mtime < g_file_info_get_attribute_uint64 (g_ptr_array_index (infos, oldest),
+								      G_FILE_ATTRIBUTE_TIME_MODIFIED))
+			{
+				oldest = i;
+			}
+		}
+
+		file = g_file_get_child (dir, g_file_info_get_name (g_ptr_array_index (infos, oldest)));
+		g_file_delete (file, NULL, NULL);
+		g_object_unref (file);
+
+		g_ptr_array_remove_index_fast (infos, oldest);
+	}
+
+	g_ptr_array_unref (infos);
+}
+
+static void
+snapshot_save (GFile    *location,
+	       GVariant *children)
+{
+	GFile *file = snapshot_file_for_location (location);
+	GFile *dir = g_file_get_parent (file);
+	gchar *dir_path = g_file_get_path (dir);
+	gchar *uri = g_file_get_uri (location);
+	GVariant *snapshot;
+
+	snapshot = g_variant_ref_sink (g_variant_new ("(s@a(ssubbsst))", uri, children));
+
+	if (g_mkdir_with_parents (dir_path, 0700) == 0 &&
+	    g_file_replace_contents (file,
+				     g_variant_get_data (snapshot),
+				     g_variant_get_size (snapshot),
+				     NULL, FALSE,
+				     G_FILE_CREATE_PRIVATE | G_FILE_CREATE_REPLACE_DESTINATION,
+				     NULL, NULL, NULL))
+	{
+		snapshot_prune (dir);
+	}
+
+	g_variant_unref (snapshot);
+	g_free (uri);
+	g_free (dir_path);
+	g_object_unref (dir);
+	g_object_unref (file);
+}
+
+/* Hands the snapshot to the main thread in batches, so that the
+   listing is shown while the directory is being read */
+static void
+async_node_push_snapshot (AsyncNode  *async,
+			  GHashTable *snapshot)
+{
+	GHashTableIter iter;
+	gpointer value;
+	LoadBatch *batch = load_batch_new ();
+
+	g_hash_table_iter_init (&iter, snapshot);
+
+	while (g_hash_table_iter_next (&iter, NULL, &value))
+	{
+		GFileInfo *info = snapshot_entry_to_info (value);
+		GFile *file = g_file_get_child (async->file, g_file_info_get_name (info));
+
+		loaded_nodes_append (batch->nodes, async->model, (FileBrowserNode *)async->dir, file, info);
+		g_object_unref (file);
+
+		if (batch->nodes->len == DIRECTORY_LOAD_ITEMS_PER_CALLBACK)
+		{
+			async_node_push_batch (async, batch);
+			batch = load_batch_new ();
+		}
+	}
+
+	if (batch->nodes->len > 0)
+		async_node_push_batch (async, batch);
+	else
+		load_batch_free (batch);
+}
+
+/* Turns files, enumerated from the directory, into a batch leaving out
+   what is already shown from the snapshot. Takes ownership of files */
+static void
+async_node_push_files (AsyncNode       *async,
+		       GHashTable      *snapshot,
+		       GVariantBuilder *listing,
+		       GList           *files,
+		       gboolean        *changed)
+{
+	FileBrowserNode *parent = (FileBrowserNode *)async->dir;
+	LoadBatch *batch = load_batch_new ();
+
+	for (GList *item = files; item; item = item->next)
+	{
+		GFileInfo *info = G_FILE_INFO (item->data);
+		const gchar *name = g_file_info_get_name (info);
+		GVariant *entry;
+		GFile *file;
+
+		if (!file_info_is_listed (info))
+		{
+			g_object_unref (info);
+			continue;
+		}
+
+		entry = snapshot_entry_new (info);
+		g_variant_builder_add_value (listing, entry);
+
+		if (snapshot != NULL)
+		{
+			GVariant *previous = g_hash_table_lookup (snapshot, name);
+
+			if (previous != NULL && g_variant_equal (previous, entry))
+			{
+				/* Already shown as it is */
+				g_hash_table_remove (snapshot, name);
+				g_variant_unref (entry);
+				g_object_unref (info);
+				continue;
+			}
+
+			if (previous != NULL)
+			{
+				g_ptr_array_add (batch->removed, g_strdup (name));
+				g_hash_table_remove (snapshot, name);
+			}
+
+			*changed = TRUE;
+		}
+
+		g_variant_unref (entry);
+
+		file = g_file_get_child (async->file, name);
+		loaded_nodes_append (batch->nodes, async->model, parent, file, info);
+		g_object_unref (file);
+	}
+
+	if (batch->nodes->len > 0 || batch->removed->len > 0)
+		async_node_push_batch (async, batch);
+	else
+		load_batch_free (batch);
+
+	g_list_free (files);
+}
+
+/* Runs in a thread. When there is a snapshot of the directory it is
+   shown first, and only the files which differ from it are passed on
+   while enumerating. The snapshot is written again when the listing
+   changed */
+static void
+model_load_directory_thread (GTask        *task,
+			     gpointer      source_object,
+			     AsyncNode    *async,
+			     GCancellable *cancellable)
+{
+	GFileEnumerator *enumerator = NULL;
+	GHashTable *snapshot;
+	GVariantBuilder listing;
+	GError *error = NULL;
+	gboolean changed;
+	GList *files;
+
+	snapshot = snapshot_load (async->file, cancellable);
+
+	if (snapshot != NULL)
+		async_node_push_snapshot (async, snapshot);
+
+	changed = snapshot == NULL;
+
+	if (!async->prefetched)
+	{
+		enumerator = g_file_enumerate_children (async->file,
+							STANDARD_ATTRIBUTE_TYPES,
+							G_FILE_QUERY_INFO_NONE,
+							cancellable,
+							&error);
+	}
+
+	if (!async->prefetched && enumerator == NULL)
+	{
+		if (snapshot != NULL)
+		{
+			/* Do not show a directory which is gone again */
+			if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+			{
+				GFile *file = snapshot_file_for_location (async->file);
+
+				g_file_delete (file, NULL, NULL);
+				g_object_unref (file);
+			}
+
+			g_hash_table_unref (snapshot);
+		}
+
+		g_task_return_error (task, error);
+		return;
+	}
+
+	g_variant_builder_init (&listing, G_VARIANT_TYPE ("a(ssubbsst)"));
+
+	if (async->prefetched)
+	{
+		/* Already enumerated, hand it over in the same portions */
+		files = async->infos;
+		async->infos = NULL;
+
+		while (files != NULL)
+		{
+			GList *rest = g_list_nth (files, DIRECTORY_LOAD_ITEMS_PER_CALLBACK);
+
+			if (rest != NULL)
+			{
+				rest->prev->next = NULL;
+				rest->prev = NULL;
+			}
+
+			async_node_push_files (async, snapshot, &listing, files, &changed);
+			files = rest;
+		}
+	}
+	else
+	{
+		while ((files = g_file_enumerator_next_files (enumerator,
+							      DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
+							      cancellable,
+							      &error)))
+		{
+			async_node_push_files (async, snapshot, &listing, files, &changed);
+		}
+
+		g_file_enumerator_close (enumerator, NULL, NULL);
+		g_object_unref (enumerator);
+	}
+
+	if (error == NULL && snapshot != NULL && g_hash_table_size (snapshot) > 0)
+	{
+		/* What is left in the snapshot is gone */
+		LoadBatch *batch = load_batch_new ();
+		GHashTableIter iter;
+		gpointer key;
+
+		g_hash_table_iter_init (&iter, snapshot);
+
+		while (g_hash_table_iter_next (&iter, &key, NULL))
+			g_ptr_array_add (batch->removed, g_strdup (key));
+
+		async_node_push_batch (async, batch);
+		changed = TRUE;
+	}
+
+	if (error == NULL && changed)
+		snapshot_save (async->file, g_variant_builder_end (&listing));
+	else
+		g_variant_builder_clear (&listing);
+
+	if (snapshot != NULL)
+		g_hash_table_unref (snapshot);
+
+	if (error != NULL)
+		g_task_return_error (task, error);
+	else
+		g_task_return_boolean (task, TRUE);
+}
+
+static void
+model_load_directory_cb (GObject      *source_object,
+			 GAsyncResult *result,
+			 AsyncNode    *async)
+{
+	FileBrowserNodeDir *dir = async->dir;
+	GError *error = NULL;
+	gboolean finished;
+
+	g_task_propagate_boolean (G_TASK (result), &error);
+
+	/* Simply return if we were cancelled */
+	if (g_cancellable_is_cancelled (async->cancellable))
+	{
+		g_clear_error (&error);
+		return;
+	}
+
+	if (error != NULL)
+	{
+		/* Otherwise handle the error appropriately */
+		g_signal_emit (dir->model,
+			       model_signals[ERROR],
+			       0,
+			       GEDIT_FILE_BROWSER_ERROR_LOAD_DIRECTORY,
+			       error->message);
+
+		file_browser_node_unload (dir->model, (FileBrowserNode *)dir, TRUE);
+		g_error_free (error);
+		return;
+	}
+
+	/* Let the pending batches be merged first if there are any */
+	g_mutex_lock (&async->lock);
+	async->enumerated = TRUE;
+	finished = !async->merging;
+	g_mutex_unlock (&async->lock);
+
+	if (finished)
+		model_end_directory_load (async);
+}
+
+/* Starts the loading thread of node, taking infos when the directory
+   was prefetched */
+static void
+model_start_directory_load (GeditFileBrowserStore *model,
+			    FileBrowserNode       *node,
+			    gboolean               prefetched,
+			    GList                 *infos)
+{
+	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
+	AsyncNode *async;
+	GTask *task;
+
+	async = g_slice_new0 (AsyncNode);
+	async->model = model;
+	async->dir = dir;
+	async->file = g_object_ref (node->file);
+	async->cancellable = g_object_ref (dir->cancellable);
+	async->context = g_main_context_ref_thread_default ();
+	async->ref_count = 1;
+	async->prefetched = prefetched;
+	async->infos = infos;
+	g_mutex_init (&async->lock);
+	g_queue_init (&async->batches);
+
+	/* Enumerate and prepare the nodes in a thread, the task owns the
+	   initial reference */
+	task = g_task_new (NULL,
+			   async->cancellable,
+			   (GAsyncReadyCallback)model_load_directory_cb,
+			   async);
+	g_task_set_task_data (task, async, (GDestroyNotify)async_node_unref);
+	g_task_run_in_thread (task, (GTaskThreadFunc)model_load_directory_thread);
+	g_object_unref (task);
+}
+
+static void
+model_load_directory (GeditFileBrowserStore *model,
+		      FileBrowserNode       *node)
+{
+	FileBrowserNodeDir *dir;
+	Prefetch *prefetch = NULL;
+
+	g_return_if_fail (NODE_IS_DIR (node));
+
+	dir = FILE_BROWSER_NODE_DIR (node);
+
+	/* Cancel a previous load */
+	if (dir->cancellable != NULL)
+		file_browser_node_unload (dir->model, node, TRUE);
+
+	node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_LOADED;
+	model_begin_loading (model, node);
+
+	dir->cancellable = g_cancellable_new ();
 
-			file_browser_node_set_from_info (model, node, info, FALSE);
+	if (model->priv->prefetches != NULL)
+		prefetch = g_hash_table_lookup (model->priv->prefetches, node->file);
 
-			nodes = g_slist_prepend (nodes, node);
-		}
+	if (prefetch == NULL)
+	{
+		model_start_directory_load (model, node, FALSE, NULL);
+	}
+	else if (prefetch->done)
+	{
+		GList *infos = prefetch->infos;
 
-		g_object_unref (file);
-		g_object_unref (info);
+		prefetch->infos = NULL;
+		g_hash_table_remove (model->priv->prefetches, node->file);
+
+		model_start_directory_load (model, node, TRUE, infos);
 	}
+	else
+	{
+		/* The load starts when the listing comes in */
+		g_clear_object (&prefetch->waiting_cancellable);
 
-	if (nodes)
-		model_add_nodes_batch (model, nodes, parent);
+		prefetch->waiting = node;
+		prefetch->waiting_cancellable = g_object_ref (dir->cancellable);
+	}
 }
 
-static FileBrowserNode *
-model_add_node_from_dir (GeditFileBrowserStore *model,
-			 FileBrowserNode       *parent,
-			 GFile                 *file)
+static Prefetch *
+prefetch_new (GeditFileBrowserStore *model,
+	      GFile                 *location)
 {
-	FileBrowserNode *node;
-
-	/* Check if it already exists */
-	if ((node = node_list_contains_file (FILE_BROWSER_NODE_DIR (parent)->children, file)) == NULL)
-	{
-		node = file_browser_node_dir_new (model, file, parent);
-		file_browser_node_set_from_info (model, node, NULL, FALSE);
-
-		if (node->name == NULL)
-			file_browser_node_set_name (node);
+	Prefetch *prefetch = g_slice_new0 (Prefetch);
+	gchar *uri = g_file_get_uri (location);
 
-		node->icon_name = g_strdup ("folder-symbolic");
+	prefetch->model = model;
+	prefetch->location = g_object_ref (location);
+	prefetch->cancellable = g_object_ref (model->priv->prefetch_cancellable);
+	prefetch->ref_count = 1;
 
-		model_add_node (model, node, parent);
+	for (gchar *c = uri; *c != '\0'; ++c)
+	{
+		if (*c == '/')
+			prefetch->depth++;
 	}
 
-	return node;
+	g_free (uri);
+	return prefetch;
 }
 
-static void
-on_directory_monitor_event (GFileMonitor      *monitor,
-			    GFile             *file,
-			    GFile             *other_file,
-			    GFileMonitorEvent  event_type,
-			    FileBrowserNode   *parent)
+static Prefetch *
+prefetch_ref (Prefetch *prefetch)
 {
-	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
-	FileBrowserNode *node;
+	g_atomic_int_inc (&prefetch->ref_count);
+	return prefetch;
+}
 
-	switch (event_type)
-	{
-		case G_FILE_MONITOR_EVENT_DELETED:
-			node = node_list_contains_file (dir->children, file);
+/* The last reference can be dropped by the enumerating thread */
+static void
+prefetch_unref (Prefetch *prefetch)
+{
+	if (!g_atomic_int_dec_and_test (&prefetch->ref_count))
+		return;
 
-			if (node != NULL)
-				model_remove_node (dir->model, node, NULL, TRUE);
-			break;
-		case G_FILE_MONITOR_EVENT_CREATED:
-			if (g_file_query_exists (file, NULL))
-				model_add_node_from_file (dir->model, parent, file, NULL);
+	g_list_free_full (prefetch->infos, g_object_unref);
+	g_clear_object (&prefetch->waiting_cancellable);
+	g_object_unref (prefetch->cancellable);
+	g_object_unref (prefetch->location);
+	g_slice_free (Prefetch, prefetch);
+}
 
-			break;
-		default:
-			break;
-	}
+static gint
+compare_prefetch_depth (Prefetch **a,
+			Prefetch **b)
+{
+	return (gint)(*a)->depth - (gint)(*b)->depth;
 }
 
 static void
-async_node_free (AsyncNode *async)
+file_info_list_free (GList *infos)
 {
-	g_object_unref (async->cancellable);
-	g_slist_free (async->original_children);
-	g_slice_free (AsyncNode, async);
+	g_list_free_full (infos, g_object_unref);
 }
 
+/* Runs in a thread */
 static void
-model_iterate_next_files_cb (GFileEnumerator *enumerator,
-			     GAsyncResult    *result,
-			     AsyncNode       *async)
+prefetch_thread (GTask        *task,
+		 gpointer      source_object,
+		 Prefetch     *prefetch,
+		 GCancellable *cancellable)
 {
+	GFileEnumerator *enumerator;
 	GError *error = NULL;
-	GList *files = g_file_enumerator_next_files_finish (enumerator, result, &error);
-	FileBrowserNodeDir *dir = async->dir;
-	FileBrowserNode *parent = (FileBrowserNode *)dir;
-
-	if (files == NULL)
-	{
-		g_file_enumerator_close (enumerator, NULL, NULL);
-		g_object_unref (enumerator);
-		async_node_free (async);
+	GList *infos = NULL;
+	GList *files;
 
-		if (!error)
-		{
-			/* We're done loading */
-			g_object_unref (dir->cancellable);
-			dir->cancellable = NULL;
+	enumerator = g_file_enumerate_children (prefetch->location,
+						STANDARD_ATTRIBUTE_TYPES,
+						G_FILE_QUERY_INFO_NONE,
+						cancellable,
+						&error);
 
-/*
- * FIXME: This is temporarly, it is a bug in gio:
- * http://bugzilla.gnome.org/show_bug.cgi?id=565924
- */
-#ifndef G_OS_WIN32
-			if (g_file_is_native (parent->file) && dir->monitor == NULL)
-			{
-				dir->monitor = g_file_monitor_directory (parent->file,
-									 G_FILE_MONITOR_NONE,
-									 NULL,
-									 NULL);
-				if (dir->monitor != NULL)
-				{
-					g_signal_connect (dir->monitor,
-							  "changed",
-							  G_CALLBACK (on_directory_monitor_event),
-							  parent);
-				}
-			}
-#endif
+	if (enumerator == NULL)
+	{
+		g_task_return_error (task, error);
+		return;
+	}
 
-			model_check_dummy (dir->model, parent);
-			model_end_loading (dir->model, parent);
-		}
-		else
-		{
-			/* Simply return if we were cancelled */
-			if (error->domain == G_IO_ERROR && error->code == G_IO_ERROR_CANCELLED)
-				return;
+	while ((files = g_file_enumerator_next_files (enumerator,
+						      DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
+						      cancellable,
+						      &error)))
+	{
+		infos = g_list_concat (files, infos);
+	}
 
-			/* Otherwise handle the error appropriately */
-			g_signal_emit (dir->model,
-				       model_signals[ERROR],
-				       0,
-				       GEDIT_FILE_BROWSER_ERROR_LOAD_DIRECTORY,
-				       error->message);
+	g_file_enumerator_close (enumerator, NULL, NULL);
+	g_object_unref (enumerator);
 
-			file_browser_node_unload (dir->model, (FileBrowserNode *)parent, TRUE);
-			g_error_free (error);
-		}
-	}
-	else if (g_cancellable_is_cancelled (async->cancellable))
+	if (error != NULL)
 	{
-		/* Check cancel state manually */
-		g_file_enumerator_close (enumerator, NULL, NULL);
-		g_object_unref (enumerator);
-		async_node_free (async);
+		file_info_list_free (infos);
+		g_task_return_error (task, error);
 	}
 	else
 	{
-		model_add_nodes_from_files (dir->model, parent, async->original_children, files);
-
-		g_list_free (files);
-		next_files_async (enumerator, async);
+		g_task_return_pointer (task, infos, (GDestroyNotify)file_info_list_free);
 	}
 }
 
+static gboolean
+prefetch_expire_cb (GeditFileBrowserStore *model)
+{
+	model->priv->prefetch_expire_id = 0;
+	model_cancel_prefetch (model);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void prefetch_cb (GObject      *source_object,
+			 GAsyncResult *result,
+			 Prefetch     *prefetch);
+
 static void
-next_files_async (GFileEnumerator *enumerator,
-		  AsyncNode       *async)
+model_prefetch_next (GeditFileBrowserStore *model)
 {
-	g_file_enumerator_next_files_async (enumerator,
-					    DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-					    G_PRIORITY_DEFAULT,
-					    async->cancellable,
-					    (GAsyncReadyCallback)model_iterate_next_files_cb,
-					    async);
+	Prefetch *prefetch;
+
+	while (model->priv->prefetch_running < PREFETCH_MAX_PARALLEL &&
+	       (prefetch = g_queue_pop_head (&model->priv->prefetch_queue)) != NULL)
+	{
+		GTask *task;
+
+		/* The task takes the reference of the queue */
+		task = g_task_new (NULL,
+				   prefetch->cancellable,
+				   (GAsyncReadyCallback)prefetch_cb,
+				   prefetch);
+		g_task_set_task_data (task, prefetch, (GDestroyNotify)prefetch_unref);
+		g_task_run_in_thread (task, (GTaskThreadFunc)prefetch_thread);
+		g_object_unref (task);
+
+		model->priv->prefetch_running++;
+	}
+
+	/* Whatever was not loaded by now is likely not needed */
+	if (model->priv->prefetch_running == 0 && model->priv->prefetch_expire_id == 0)
+	{
+		model->priv->prefetch_expire_id =
+			g_timeout_add_seconds (PREFETCH_EXPIRE_SEC,
+					       (GSourceFunc)prefetch_expire_cb,
+					       model);
+	}
 }
 
 static void
-model_iterate_children_cb (GFile        *file,
-			   GAsyncResult *result,
-			   AsyncNode    *async)
+prefetch_cb (GObject      *source_object,
+	     GAsyncResult *result,
+	     Prefetch     *prefetch)
 {
+	GeditFileBrowserStore *model = prefetch->model;
+	FileBrowserNode *node = prefetch->waiting;
 	GError *error = NULL;
-	GFileEnumerator *enumerator;
+	GList *infos;
 
-	if (g_cancellable_is_cancelled (async->cancellable))
+	infos = g_task_propagate_pointer (G_TASK (result), &error);
+
+	/* Simply return if we were cancelled */
+	if (g_cancellable_is_cancelled (prefetch->cancellable))
 	{
-		async_node_free (async);
+		file_info_list_free (infos);
+		g_clear_error (&error);
 		return;
 	}
 
-	if (!(enumerator = g_file_enumerate_children_finish (file, result, &error)))
+	model->priv->prefetch_running--;
+
+	if (node != NULL && g_cancellable_is_cancelled (prefetch->waiting_cancellable))
+		node = NULL;
+
+	if (error != NULL)
 	{
-		/* Simply return if we were cancelled or if the dir is not there */
-		FileBrowserNodeDir *dir = async->dir;
+		/* Let the normal load report the error */
+		g_hash_table_remove (model->priv->prefetches, prefetch->location);
 
-		/* Otherwise handle the error appropriately */
-		g_signal_emit (dir->model,
-			       model_signals[ERROR],
-			       0,
-			       GEDIT_FILE_BROWSER_ERROR_LOAD_DIRECTORY,
-			       error->message);
+		if (node != NULL)
+			model_start_directory_load (model, node, FALSE, NULL);
 
-		file_browser_node_unload (dir->model, (FileBrowserNode *)dir, TRUE);
 		g_error_free (error);
-		async_node_free (async);
+	}
+	else if (node != NULL)
+	{
+		g_hash_table_remove (model->priv->prefetches, prefetch->location);
+		model_start_directory_load (model, node, TRUE, infos);
 	}
 	else
 	{
-		next_files_async (enumerator, async);
+		prefetch->infos = infos;
+		prefetch->done = TRUE;
+
+		/* The directory might already be shown, collapsed */
+		node = model_find_node (model, prefetch->location);
+
+		if (node != NULL && NODE_IS_DIR (node) && !NODE_LOADED (node))
+			model_load_directory (model, node);
 	}
+
+	model_prefetch_next (model);
 }
 
 static void
-model_load_directory (GeditFileBrowserStore *model,
-		      FileBrowserNode       *node)
+model_cancel_prefetch (GeditFileBrowserStore *model)
 {
-	FileBrowserNodeDir *dir;
-	AsyncNode *async;
+	Prefetch *prefetch;
 
-	g_return_if_fail (NODE_IS_DIR (node));
+	if (model->priv->prefetch_cancellable == NULL)
+		return;
 
-	dir = FILE_BROWSER_NODE_DIR (node);
+	g_cancellable_cancel (model->priv->prefetch_cancellable);
+	g_clear_object (&model->priv->prefetch_cancellable);
 
-	/* Cancel a previous load */
-	if (dir->cancellable != NULL)
-		file_browser_node_unload (dir->model, node, TRUE);
+	/* Loads waiting for a listing go on without it */
+	if (model->priv->prefetches != NULL)
+	{
+		GHashTableIter iter;
 
-	node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_LOADED;
-	model_begin_loading (model, node);
+		g_hash_table_iter_init (&iter, model->priv->prefetches);
 
-	dir->cancellable = g_cancellable_new ();
+		while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&prefetch))
+		{
+			if (prefetch->waiting != NULL &&
+			    !g_cancellable_is_cancelled (prefetch->waiting_cancellable))
+			{
+				g_hash_table_iter_steal (&iter);
+				model_start_directory_load (model, prefetch->waiting, FALSE, NULL);
+				prefetch_unref (prefetch);
+			}
+		}
 
-	async = g_slice_new (AsyncNode);
-	async->dir = dir;
-	async->cancellable = g_object_ref (dir->cancellable);
-	async->original_children = g_slist_copy (dir->children);
+		g_clear_pointer (&model->priv->prefetches, g_hash_table_unref);
+	}
+
+	while ((prefetch = g_queue_pop_head (&model->priv->prefetch_queue)))
+		prefetch_unref (prefetch);
 
-	/* Start loading async */
-	g_file_enumerate_children_async (node->file,
-					 STANDARD_ATTRIBUTE_TYPES,
-					 G_FILE_QUERY_INFO_NONE,
-					 G_PRIORITY_DEFAULT,
-					 async->cancellable,
-					 (GAsyncReadyCallback)model_iterate_children_cb,
-					 async);
+	if (model->priv->prefetch_expire_id != 0)
+	{
+		g_source_remove (model->priv->prefetch_expire_id);
+		model->priv->prefetch_expire_id = 0;
+	}
+
+	model->priv->prefetch_running = 0;
 }
 
+/* Returns file and its parents which are not in the model yet, top
+   first, and sets found to the directory they go in */
 static GList *
-get_parent_files (GeditFileBrowserStore *model,
-		  GFile                 *file)
+get_missing_parent_files (GeditFileBrowserStore  *model,
+			  GFile                  *file,
+			  FileBrowserNode       **found)
 {
 	GList *result = NULL;
 
-	result = g_list_prepend (result, g_object_ref (file));
+	*found = model->priv->root;
+	file = g_object_ref (file);
 
-	while ((file = g_file_get_parent (file)))
+	do
 	{
-		if (g_file_equal (file, model->priv->root->file))
+		FileBrowserNode *node = g_hash_table_lookup (model->priv->locations, file);
+
+		if (node != NULL)
 		{
+			*found = node;
 			g_object_unref (file);
 			break;
 		}
 
 		result = g_list_prepend (result, file);
 	}
+	while ((file = g_file_get_parent (file)));
 
 	return result;
 }
@@ -2404,7 +5350,7 @@ model_fill (GeditFileBrowserStore  *model,
 {
 	gboolean free_path = FALSE;
 	GtkTreeIter iter = {0,};
-	GSList *item;
+	FileBrowserNodeDir *dir;
 	FileBrowserNode *child;
 
 	if (node == NULL)
@@ -2437,17 +5383,23 @@ model_fill (GeditFileBrowserStore  *model,
 
 	if (NODE_IS_DIR (node))
 	{
+		GArray *iters = g_array_new (FALSE, FALSE, sizeof (GtkTreeIter));
+
 		/* Go to the first child */
 		gtk_tree_path_down (*path);
+		dir = FILE_BROWSER_NODE_DIR (node);
 
-		for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
+		for (guint i = 0; i < dir->children->len; ++i)
 		{
-			child = (FileBrowserNode *) (item->data);
+			child = g_ptr_array_index (dir->children, i);
 
 			if (model_node_visibility (model, child))
 			{
 				model_fill (model, child, path);
 
+				iter.user_data = child;
+				g_array_append_val (iters, iter);
+
 				/* Increase path for next child */
 				gtk_tree_path_next (*path);
 			}
@@ -2455,6 +5407,11 @@ model_fill (GeditFileBrowserStore  *model,
 
 		/* Move back up to node path */
 		gtk_tree_path_up (*path);
+
+		/* The children are announced together, like when they are
+		   loaded */
+		rows_inserted (model, node, (GtkTreeIter *)iters->data, iters->len);
+		g_array_free (iters, TRUE);
 	}
 
 	model_check_dummy (model, node);
@@ -2463,71 +5420,136 @@ model_fill (GeditFileBrowserStore  *model,
 		gtk_tree_path_free (*path);
 }
 
+/* Drops the children of node other than child, which leads down to the
+   virtual root */
 static void
-set_virtual_root_from_node (GeditFileBrowserStore *model,
-			    FileBrowserNode       *node)
+file_browser_node_keep_child (GeditFileBrowserStore *model,
+			      FileBrowserNode       *node,
+			      FileBrowserNode       *child)
 {
-	FileBrowserNode *prev = node;
-	FileBrowserNode *next = prev->parent;
+	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
+	GPtrArray *children = g_ptr_array_ref (dir->children);
 	FileBrowserNode *check;
-	FileBrowserNodeDir *dir;
-	GSList *copy;
-	GtkTreePath *empty = NULL;
 
-	/* Free all the nodes below that we don't need in cache */
-	while (prev != model->priv->root)
+	file_browser_node_dir_set_children (dir, g_ptr_array_new ());
+	g_ptr_array_add (dir->children, child);
+	child->index = 0;
+
+	g_clear_pointer (&dir->children_by_name, g_hash_table_unref);
+	file_browser_node_dir_index_name (dir, child);
+
+	for (guint i = 0; i < children->len; ++i)
 	{
-		dir = FILE_BROWSER_NODE_DIR (next);
-		copy = g_slist_copy (dir->children);
+		check = g_ptr_array_index (children, i);
 
-		for (GSList *item = copy; item; item = item->next)
-		{
-			check = (FileBrowserNode *)(item->data);
+		if (check != child)
+			file_browser_node_free (model, check);
+	}
 
-			if (prev == node)
-			{
-				/* Only free the children, keeping this depth in cache */
-				if (check != node)
-				{
-					file_browser_node_free_children (model, check);
-					file_browser_node_unload (model, check, FALSE);
-				}
-			}
-			else if (check != prev)
-			{
-				/* Only free when the node is not in the chain */
-				dir->children = g_slist_remove (dir->children, check);
-				file_browser_node_free (model, check);
-			}
-		}
+	g_ptr_array_unref (children);
+}
 
-		if (prev != node)
-			file_browser_node_unload (model, next, FALSE);
+static void
+model_detached_evict (GeditFileBrowserStore *model,
+		      FileBrowserNode       *node,
+		      FileBrowserNode       *virtual_root)
+{
+	model_detached_remove (model, node);
 
-		g_slist_free (copy);
-		prev = next;
-		next = prev->parent;
+	/* Directories above the virtual root keep the way down to it */
+	for (FileBrowserNode *child = virtual_root; child != NULL; child = child->parent)
+	{
+		if (child->parent == node)
+		{
+			file_browser_node_keep_child (model, node, child);
+			file_browser_node_unload (model, node, FALSE);
+			return;
+		}
 	}
 
-	/* Free all the nodes up that we don't need in cache */
-	for (GSList *item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
+	file_browser_node_free_children (model, node);
+	file_browser_node_unload (model, node, FALSE);
+}
+
+/* Unloads detached directories until they fit in the cache. Unless the
+   model was just cleared, the ones below the virtual root have rows
+   and are left alone */
+static void
+model_trim_detached (GeditFileBrowserStore *model,
+		     FileBrowserNode       *virtual_root,
+		     gboolean               cleared)
+{
+	GList *item = model->priv->detached.tail;
+
+	while (item != NULL && model->priv->detached_size > model->priv->cache_size)
 	{
-		check = (FileBrowserNode *)(item->data);
+		FileBrowserNode *node = item->data;
 
-		if (NODE_IS_DIR (check))
+		if (!cleared && virtual_root != NULL && node_has_parent (node, virtual_root))
 		{
-			for (copy = FILE_BROWSER_NODE_DIR (check)->children; copy; copy = copy->next)
-			{
-				file_browser_node_free_children (model, (FileBrowserNode*) (copy->data));
-				file_browser_node_unload (model, (FileBrowserNode*) (copy->data), FALSE);
-			}
+			item = item->prev;
+			continue;
 		}
-		else if (NODE_IS_DUMMY (check))
+
+		/* Evicting may free other detached directories below node */
+		model_detached_evict (model, node, virtual_root);
+		item = model->priv->detached.tail;
+	}
+}
+
+/* Detaches the loaded directories which are not shown below
+   virtual_root. The directories in it are expected to be loaded, like
+   they used to be before the cache */
+static void
+model_detach_hidden (GeditFileBrowserStore *model,
+		     FileBrowserNode       *virtual_root)
+{
+	GHashTableIter iter;
+	FileBrowserNode *node;
+
+	g_hash_table_iter_init (&iter, model->priv->locations);
+
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&node))
+	{
+		if (!NODE_LOADED (node))
+			continue;
+
+		if (node == virtual_root || node->parent == virtual_root)
+			model_detached_remove (model, node);
+		else
+			model_detached_add (model, node);
+	}
+}
+
+static void
+set_virtual_root_from_node (GeditFileBrowserStore *model,
+			    FileBrowserNode       *node)
+{
+	FileBrowserNode *check;
+	FileBrowserNodeDir *dir;
+	GtkTreePath *empty = NULL;
+
+	/* The model is cleared, so the directories which are not shown any
+	   more can go without removing their rows */
+	model_detach_hidden (model, node);
+	model_trim_detached (model, node, TRUE);
+
+	dir = FILE_BROWSER_NODE_DIR (node);
+
+	for (guint i = 0; i < dir->children->len; ++i)
+	{
+		check = g_ptr_array_index (dir->children, i);
+
+		if (NODE_IS_DUMMY (check))
 		{
 			check->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+			file_browser_node_update_exposed (check);
 		}
 	}
 
+	/* What was prefetched for the previous virtual root is not needed */
+	model_cancel_prefetch (model);
+
 	/* Now finally, set the virtual root, and load it up! */
 	model->priv->virtual_root = node;
 
@@ -2552,9 +5574,9 @@ set_virtual_root_from_file (GeditFileBrowserStore *model,
 	/* Always clear the model before altering the nodes */
 	model_clear (model, FALSE);
 
-	/* Create the node path, get all the uri's */
-	files = get_parent_files (model, file);
-	parent = model->priv->root;
+	/* Only the directories below the deepest one already in the model
+	   need to be added */
+	files = get_missing_parent_files (model, file, &parent);
 
 	for (GList *item = files; item; item = item->next)
 	{
@@ -2568,48 +5590,33 @@ set_virtual_root_from_file (GeditFileBrowserStore *model,
 	set_virtual_root_from_node (model, parent);
 }
 
+/* Returns the node at file, or NULL when it is not in the model. This
+   takes at most two lookups, of file itself when it is a directory and
+   of its name in the directory containing it otherwise */
 static FileBrowserNode *
-model_find_node_children (GeditFileBrowserStore *model,
-			  FileBrowserNode       *parent,
-			  GFile                 *file)
+model_find_node (GeditFileBrowserStore *model,
+		 GFile                 *file)
 {
-	FileBrowserNodeDir *dir;
-	FileBrowserNode *child;
-	FileBrowserNode *result;
-
-	if (!NODE_IS_DIR (parent))
-		return NULL;
+	FileBrowserNode *node;
+	GFile *parent;
 
-	dir = FILE_BROWSER_NODE_DIR (parent);
+	node = g_hash_table_lookup (model->priv->locations, file);
 
-	for (GSList *children = dir->children; children; children = children->next)
-	{
-		child = (FileBrowserNode *)(children->data);
+	if (node != NULL)
+		return node;
 
-		result = model_find_node (model, child, file);
+	parent = g_file_get_parent (file);
 
-		if (result)
-			return result;
-	}
+	if (parent == NULL)
+		return NULL;
 
-	return NULL;
-}
+	node = g_hash_table_lookup (model->priv->locations, parent);
+	g_object_unref (parent);
 
-static FileBrowserNode *
-model_find_node (GeditFileBrowserStore *model,
-		 FileBrowserNode       *node,
-		 GFile                 *file)
-{
 	if (node == NULL)
-		node = model->priv->root;
-
-	if (node->file && g_file_equal (node->file, file))
-		return node;
-
-	if (NODE_IS_DIR (node) && g_file_has_prefix (file, node->file))
-		return model_find_node_children (model, node, file);
+		return NULL;
 
-	return NULL;
+	return file_browser_node_dir_find_file (FILE_BROWSER_NODE_DIR (node), file);
 }
 
 static GQuark
@@ -2827,9 +5834,7 @@ gedit_file_browser_store_set_value (GeditFileBrowserStore *tree_model,
 
 		data = g_value_dup_string (value);
 
-		if (!data)
-			data = g_strdup (node->name);
-
+		/* Without custom markup the escaped name is used */
 		g_free (node->markup);
 		node->markup = data;
 	}
@@ -2849,7 +5854,8 @@ gedit_file_browser_store_set_value (GeditFileBrowserStore *tree_model,
 		else
 			node->emblem = NULL;
 
-		model_recomposite_icon (tree_model, iter);
+		/* Composited again with the new emblem when next needed */
+		g_clear_object (&node->icon);
 	}
 	else
 	{
@@ -2883,6 +5889,8 @@ GeditFileBrowserStoreResult
 gedit_file_browser_store_set_virtual_root_from_location (GeditFileBrowserStore *model,
 							 GFile                 *root)
 {
+	FileBrowserNode *node;
+
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model), GEDIT_FILE_BROWSER_STORE_RESULT_NO_CHANGE);
 
 	if (root == NULL)
@@ -2898,12 +5906,15 @@ gedit_file_browser_store_set_virtual_root_from_location (GeditFileBrowserStore *
 	if (model->priv->virtual_root && g_file_equal (model->priv->virtual_root->file, root))
 		return GEDIT_FILE_BROWSER_STORE_RESULT_NO_CHANGE;
 
-	/* Check if uri is the root itself */
-	if (g_file_equal (model->priv->root->file, root))
+	/* Check if uri is the root itself, or another directory which is
+	   already in the model */
+	node = g_hash_table_lookup (model->priv->locations, root);
+
+	if (node != NULL)
 	{
 		/* Always clear the model before altering the nodes */
 		model_clear (model, FALSE);
-		set_virtual_root_from_node (model, model->priv->root);
+		set_virtual_root_from_node (model, node);
 		return GEDIT_FILE_BROWSER_STORE_RESULT_OK;
 	}
 
@@ -3036,6 +6047,8 @@ gedit_file_browser_store_set_root_and_virtual_root (GeditFileBrowserStore *model
 	/* Always clear the model before altering the nodes */
 	model_clear (model, TRUE);
 	file_browser_node_free (model, model->priv->root);
+	model_cancel_prefetch (model);
+	model_cancel_content_types (model);
 
 	model->priv->root = NULL;
 	model->priv->virtual_root = NULL;
@@ -3044,6 +6057,7 @@ gedit_file_browser_store_set_root_and_virtual_root (GeditFileBrowserStore *model
 	{
 		/* Create the root node */
 		node = file_browser_node_dir_new (model, root, NULL);
+		model_index_location (model, node);
 
 		model->priv->root = node;
 		return model_mount_root (model, virtual_root);
@@ -3082,17 +6096,46 @@ gedit_file_browser_store_get_virtual_root (GeditFileBrowserStore *model)
 {
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model), NULL);
 
-	if (model->priv->virtual_root == NULL || model->priv->virtual_root->file == NULL)
-		return NULL;
-	else
-		return g_file_dup (model->priv->virtual_root->file);
+	if (model->priv->virtual_root == NULL || model->priv->virtual_root->file == NULL)
+		return NULL;
+	else
+		return g_file_dup (model->priv->virtual_root->file);
+}
+
+void
+_gedit_file_browser_store_iter_expanded (GeditFileBrowserStore *model,
+					 GtkTreeIter           *iter)
+{
+	FileBrowserNode *node;
+
+	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
+	g_return_if_fail (iter != NULL);
+	g_return_if_fail (iter->user_data != NULL);
+
+	node = (FileBrowserNode *)(iter->user_data);
+
+	if (!NODE_IS_DIR (node))
+		return;
+
+	/* Shown again, it is no longer up for eviction */
+	model_detached_remove (model, node);
+
+	if (!NODE_LOADED (node))
+	{
+		/* Load it now */
+		model_load_directory (model, node);
+	}
 }
 
+/* Called by the view for the rows it shows on screen. The view asks for
+   the values of every row while it validates them in the background, so
+   only this looks up the full content type and renders the icon */
 void
-_gedit_file_browser_store_iter_expanded (GeditFileBrowserStore *model,
-					 GtkTreeIter           *iter)
+_gedit_file_browser_store_iter_shown (GeditFileBrowserStore *model,
+				      GtkTreeIter           *iter)
 {
 	FileBrowserNode *node;
+	GtkTreePath *path;
 
 	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
 	g_return_if_fail (iter != NULL);
@@ -3100,10 +6143,17 @@ _gedit_file_browser_store_iter_expanded (GeditFileBrowserStore *model,
 
 	node = (FileBrowserNode *)(iter->user_data);
 
-	if (NODE_IS_DIR (node) && !NODE_LOADED (node))
+	if (NODE_IS_DUMMY (node))
+		return;
+
+	if (!node->content_type_known)
+		model_resolve_content_type (model, node);
+
+	if (node->icon == NULL && model_node_get_icon (model, node) != NULL)
 	{
-		/* Load it now */
-		model_load_directory (model, node);
+		path = gedit_file_browser_store_get_path_real (model, node);
+		row_changed (model, &path, iter);
+		gtk_tree_path_free (path);
 	}
 }
 
@@ -3122,10 +6172,11 @@ _gedit_file_browser_store_iter_collapsed (GeditFileBrowserStore *model,
 	if (NODE_IS_DIR (node) && NODE_LOADED (node))
 	{
 		/* Unload children of the children, keeping 1 depth in cache */
+		FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
 
-		for (GSList *item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
+		for (guint i = 0; i < dir->children->len; ++i)
 		{
-			node = (FileBrowserNode *)(item->data);
+			node = g_ptr_array_index (dir->children, i);
 
 			if (NODE_IS_DIR (node) && NODE_LOADED (node))
 			{
@@ -3136,6 +6187,135 @@ _gedit_file_browser_store_iter_collapsed (GeditFileBrowserStore *model,
 	}
 }
 
+guint
+gedit_file_browser_store_get_cache_size (GeditFileBrowserStore *model)
+{
+	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model), 0);
+
+	return model->priv->cache_size;
+}
+
+/* Sets how many files the directories which are not shown may hold
+   together before they are unloaded, 0 unloads them right away */
+void
+gedit_file_browser_store_set_cache_size (GeditFileBrowserStore *model,
+					 guint                  cache_size)
+{
+	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
+
+	if (model->priv->cache_size == cache_size)
+		return;
+
+	model->priv->cache_size = cache_size;
+	model_trim_detached (model, model->priv->virtual_root, FALSE);
+
+	g_object_notify (G_OBJECT (model), "cache-size");
+}
+
+/* Queries the statuses of the loaded directories again, clear drops the
+   current ones right away */
+static void
+model_requery_statuses (GeditFileBrowserStore *model,
+			gboolean               clear)
+{
+	GHashTableIter iter;
+	FileBrowserNode *node;
+	GPtrArray *loaded;
+
+	/* Rows changing may change the model, so the directories are
+	   collected first */
+	loaded = g_ptr_array_new ();
+	g_hash_table_iter_init (&iter, model->priv->locations);
+
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&node))
+	{
+		if (NODE_LOADED (node))
+			g_ptr_array_add (loaded, node);
+	}
+
+	for (guint i = 0; i < loaded->len; ++i)
+	{
+		node = g_ptr_array_index (loaded, i);
+
+		if (clear)
+		{
+			file_browser_node_dir_clear_statuses (FILE_BROWSER_NODE_DIR (node));
+			model_apply_statuses (model, FILE_BROWSER_NODE_DIR (node));
+		}
+
+		schedule_statuses (model, node);
+	}
+
+	g_ptr_array_unref (loaded);
+}
+
+gboolean
+gedit_file_browser_store_get_show_status (GeditFileBrowserStore *model)
+{
+	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model), FALSE);
+
+	return model->priv->show_status;
+}
+
+/* Sets whether the statuses of the status provider are shown. Hiding them
+   drops the current ones, showing them queries the loaded directories */
+void
+gedit_file_browser_store_set_show_status (GeditFileBrowserStore *model,
+					  gboolean               show_status)
+{
+	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
+
+	show_status = show_status != FALSE;
+
+	if (model->priv->show_status == show_status)
+		return;
+
+	model->priv->show_status = show_status;
+	model_requery_statuses (model, TRUE);
+
+	g_object_notify (G_OBJECT (model), "show-status");
+}
+
+static void
+on_status_provider_changed (GeditFileBrowserStatusProvider *provider,
+			    GeditFileBrowserStore          *model)
+{
+	model_requery_statuses (model, FALSE);
+}
+
+/* Sets the provider of the statuses shown as emblems, NULL to show none.
+   Loaded directories are queried again */
+void
+gedit_file_browser_store_set_status_provider (GeditFileBrowserStore          *model,
+					      GeditFileBrowserStatusProvider *provider)
+{
+	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
+	g_return_if_fail (provider == NULL || GEDIT_IS_FILE_BROWSER_STATUS_PROVIDER (provider));
+
+	if (model->priv->status_provider == provider)
+		return;
+
+	if (model->priv->status_provider != NULL)
+	{
+		g_signal_handlers_disconnect_by_func (model->priv->status_provider,
+						      on_status_provider_changed,
+						      model);
+	}
+
+	g_set_object (&model->priv->status_provider, provider);
+
+	if (provider != NULL)
+	{
+		g_signal_connect (provider,
+				  "changed",
+				  G_CALLBACK (on_status_provider_changed),
+				  model);
+	}
+
+	/* The statuses of the previous provider go right away */
+	model_requery_statuses (model, TRUE);
+}
+
 GeditFileBrowserStoreFilterMode
 gedit_file_browser_store_get_filter_mode (GeditFileBrowserStore *model)
 {
@@ -3151,8 +6331,9 @@ gedit_file_browser_store_set_filter_mode (GeditFileBrowserStore           *model
 	if (model->priv->filter_mode == mode)
 		return;
 
+	/* The cached verdicts do not depend on the mode */
 	model->priv->filter_mode = mode;
-	model_refilter (model);
+	model_refilter (model, 0, FALSE);
 
 	g_object_notify (G_OBJECT (model), "filter-mode");
 }
@@ -3166,7 +6347,7 @@ gedit_file_browser_store_set_filter_func (GeditFileBrowserStore           *model
 
 	model->priv->filter_func = func;
 	model->priv->filter_user_data = user_data;
-	model_refilter (model);
+	model_refilter (model, FILTER_VERDICT_FUNC, FALSE);
 }
 
 const gchar * const *
@@ -3181,38 +6362,73 @@ gedit_file_browser_store_set_binary_patterns (GeditFileBrowserStore  *model,
 {
 	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
 
-	if (model->priv->binary_patterns != NULL)
-	{
-		g_strfreev (model->priv->binary_patterns);
-		g_ptr_array_unref (model->priv->binary_pattern_specs);
-	}
-
+	g_strfreev (model->priv->binary_patterns);
 	model->priv->binary_patterns = g_strdupv ((gchar **)binary_patterns);
 
-	if (binary_patterns == NULL)
-	{
-		model->priv->binary_pattern_specs = NULL;
-	}
-	else
-	{
-		gssize n_patterns = g_strv_length ((gchar **) binary_patterns);
+	model_compile_name_patterns (model);
+	model_refilter (model, FILTER_VERDICT_BINARY, FALSE);
 
-		model->priv->binary_pattern_specs = g_ptr_array_sized_new (n_patterns);
-		g_ptr_array_set_free_func (model->priv->binary_pattern_specs, (GDestroyNotify) g_pattern_spec_free);
+	g_object_notify (G_OBJECT (model), "binary-patterns");
+}
 
-		for (guint i = 0; binary_patterns[i] != NULL; ++i)
-			g_ptr_array_add (model->priv->binary_pattern_specs, g_pattern_spec_new (binary_patterns[i]));
-	}
+const gchar *
+gedit_file_browser_store_get_filter_pattern (GeditFileBrowserStore *model)
+{
+	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model), NULL);
 
-	model_refilter (model);
+	return model->priv->filter_pattern;
+}
 
-	g_object_notify (G_OBJECT (model), "binary-patterns");
+/* Only shows the files whose name matches the glob pattern, directories
+   are always shown */
+void
+gedit_file_browser_store_set_filter_pattern (GeditFileBrowserStore *model,
+					     const gchar           *pattern)
+{
+	gboolean narrowed;
+
+	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
+
+	if (pattern != NULL && *pattern == '\0')
+		pattern = NULL;
+
+	if (g_strcmp0 (pattern, model->priv->filter_pattern) == 0)
+		return;
+
+	/* Anything matching "a*b" also matches "a*", so while the pattern
+	   is only extended after a trailing '*' no hidden file can show up */
+	narrowed = pattern != NULL &&
+	           model->priv->filter_pattern != NULL &&
+	           g_str_has_suffix (model->priv->filter_pattern, "*") &&
+	           g_str_has_prefix (pattern, model->priv->filter_pattern);
+
+	g_free (model->priv->filter_pattern);
+	model->priv->filter_pattern = g_strdup (pattern);
+
+	model_compile_name_patterns (model);
+	model_refilter (model, FILTER_VERDICT_PATTERN, narrowed);
+}
+
+/* Filters rows many at a time, which is cheaper than the filter
+   function for filters with a high cost per call */
+void
+gedit_file_browser_store_set_batch_filter_func (GeditFileBrowserStore                *model,
+						GeditFileBrowserStoreBatchFilterFunc  func,
+						gpointer                              user_data)
+{
+	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
+
+	model->priv->batch_filter_func = func;
+	model->priv->batch_filter_user_data = user_data;
+	model_refilter (model, FILTER_VERDICT_BATCH, FALSE);
 }
 
+/* The filter functions are run again, the name patterns are owned by
+   the store which refilters by itself when they change */
 void
 gedit_file_browser_store_refilter (GeditFileBrowserStore *model)
 {
-	model_refilter (model);
+	model_refilter (model, FILTER_VERDICT_FUNC | FILTER_VERDICT_BATCH, FALSE);
 }
 
 GeditFileBrowserStoreFilterMode
@@ -3236,31 +6452,31 @@ gedit_file_browser_store_refresh (GeditFileBrowserStore *model)
 	g_signal_emit (model, model_signals[END_REFRESH], 0);
 }
 
+/* Only directories keep their location, other nodes follow their
+   parent automatically */
 static void
-reparent_node (FileBrowserNode *node,
-	       gboolean         reparent)
+reparent_node (GeditFileBrowserStore *model,
+	       FileBrowserNode       *node,
+	       gboolean               reparent)
 {
+	FileBrowserNodeDir *dir;
+
 	if (!node->file)
 		return;
 
 	if (reparent)
 	{
-		GFile *parent = node->parent->file;
-		gchar *base = g_file_get_basename (node->file);
-
+		model_unindex_location (model, node);
 		g_object_unref (node->file);
 
-		node->file = g_file_get_child (parent, base);
-		g_free (base);
+		node->file = g_file_get_child (node->parent->file, node->basename);
+		model_index_location (model, node);
 	}
 
-	if (NODE_IS_DIR (node))
-	{
-		FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
+	dir = FILE_BROWSER_NODE_DIR (node);
 
-		for (GSList *child = dir->children; child; child = child->next)
-			reparent_node ((FileBrowserNode *)child->data, TRUE);
-	}
+	for (guint i = 0; i < dir->children->len; ++i)
+		reparent_node (model, g_ptr_array_index (dir->children, i), TRUE);
 }
 
 gboolean
@@ -3282,28 +6498,45 @@ gedit_file_browser_store_rename (GeditFileBrowserStore  *model,
 
 	node = (FileBrowserNode *)(iter->user_data);
 
-	parent = g_file_get_parent (node->file);
-	g_return_val_if_fail (parent != NULL, FALSE);
+	previous = file_browser_node_get_file (node);
+	g_return_val_if_fail (previous != NULL, FALSE);
+
+	parent = g_file_get_parent (previous);
+
+	if (parent == NULL)
+	{
+		g_object_unref (previous);
+		g_return_val_if_reached (FALSE);
+	}
 
 	file = g_file_get_child (parent, new_name);
 	g_object_unref (parent);
 
-	if (g_file_equal (node->file, file))
+	if (g_file_equal (previous, file))
 	{
+		g_object_unref (previous);
 		g_object_unref (file);
 		return TRUE;
 	}
 
-	if (g_file_move (node->file, file, G_FILE_COPY_NONE, NULL, NULL, NULL, &err))
+	if (g_file_move (previous, file, G_FILE_COPY_NONE, NULL, NULL, NULL, &err))
 	{
-		previous = node->file;
-		node->file = file;
+		FileBrowserNodeDir *dir = node->parent != NULL ? FILE_BROWSER_NODE_DIR (node->parent) : NULL;
+
+		/* The name index is keyed on the basename being replaced */
+		if (dir != NULL)
+			file_browser_node_dir_unindex_name (dir, node);
+
+		file_browser_node_set_file (node, file);
+
+		if (dir != NULL)
+			file_browser_node_dir_index_name (dir, node);
 
 		/* This makes sure the actual info for the node is requeried */
 		file_browser_node_set_name (node);
 		file_browser_node_set_from_info (model, node, NULL, TRUE);
 
-		reparent_node (node, FALSE);
+		reparent_node (model, node, FALSE);
 
 		if (model_node_visibility (model, node))
 		{
@@ -3317,6 +6550,7 @@ gedit_file_browser_store_rename (GeditFileBrowserStore  *model,
 		else
 		{
 			g_object_unref (previous);
+			g_object_unref (file);
 
 			if (error != NULL)
 			{
@@ -3330,14 +6564,16 @@ gedit_file_browser_store_rename (GeditFileBrowserStore  *model,
 			return FALSE;
 		}
 
-		g_signal_emit (model, model_signals[RENAME], 0, previous, node->file);
+		g_signal_emit (model, model_signals[RENAME], 0, previous, file);
 
 		g_object_unref (previous);
+		g_object_unref (file);
 
 		return TRUE;
 	}
 	else
 	{
+		g_object_unref (previous);
 		g_object_unref (file);
 
 		if (err)
@@ -3361,6 +6597,12 @@ async_data_free (AsyncData *data)
 {
 	g_object_unref (data->cancellable);
 	g_list_free_full (data->files, g_object_unref);
+	g_list_free_full (data->untrashable, g_object_unref);
+	g_ptr_array_unref (data->deleted);
+	g_clear_error (&data->error);
+
+	if (data->flush_id != 0)
+		g_source_remove (data->flush_id);
 
 	if (!data->removed)
 		data->model->priv->async_handles = g_slist_remove (data->model->priv->async_handles, data);
@@ -3374,11 +6616,49 @@ emit_no_trash (AsyncData *data)
 	/* Emit the no trash error */
 	gboolean ret;
 
-	g_signal_emit (data->model, model_signals[NO_TRASH], 0, data->files, &ret);
+	g_signal_emit (data->model, model_signals[NO_TRASH], 0, data->untrashable, &ret);
 
 	return ret;
 }
 
+/* Takes the rows of the files deleted so far out of the model, and
+   reports the progress of the job */
+static void
+delete_files_flush (AsyncData *data)
+{
+	GPtrArray *nodes = g_ptr_array_sized_new (data->deleted->len);
+
+	if (data->flush_id != 0)
+	{
+		g_source_remove (data->flush_id);
+		data->flush_id = 0;
+	}
+
+	for (guint i = 0; i < data->deleted->len; ++i)
+	{
+		FileBrowserNode *node = model_find_node (data->model, g_ptr_array_index (data->deleted, i));
+
+		if (node != NULL)
+			g_ptr_array_add (nodes, node);
+	}
+
+	g_ptr_array_set_size (data->deleted, 0);
+
+	model_remove_nodes (data->model, nodes);
+	g_ptr_array_unref (nodes);
+
+	g_signal_emit (data->model, model_signals[DELETE_PROGRESS], 0, data->n_done, data->n_files);
+}
+
+static gboolean
+delete_files_flush_cb (AsyncData *data)
+{
+	data->flush_id = 0;
+	delete_files_flush (data);
+
+	return G_SOURCE_REMOVE;
+}
+
 static void
 delete_file_finished (GFile        *file,
 		      GAsyncResult *res,
@@ -3392,82 +6672,146 @@ delete_file_finished (GFile        *file,
 	else
 		ok = g_file_delete_finish (file, res, &error);
 
-	if (ok)
+	data->n_running--;
+
+	/* The model is gone, wait for the other operations to end */
+	if (data->removed)
 	{
-		/* Remove the file from the model */
-		FileBrowserNode *node = model_find_node (data->model, NULL, file);
+		g_clear_error (&error);
 
-		if (node != NULL)
-			model_remove_node (data->model, node, NULL, TRUE);
+		if (data->n_running == 0)
+			async_data_free (data);
 
-		/* Process the next file */
-		data->iter = data->iter->next;
+		return;
 	}
-	else if (!ok && error != NULL)
+
+	if (ok)
 	{
-		gint code = error->code;
-		g_error_free (error);
+		data->n_done++;
+		g_ptr_array_add (data->deleted, g_object_ref (file));
 
-		if (data->trash && code == G_IO_ERROR_NOT_SUPPORTED)
+		if (data->flush_id == 0)
 		{
-			/* Trash is not supported on this system. Ask the user
-			 * if he wants to delete completely the files instead.
-			 */
-			if (emit_no_trash (data))
-			{
-				/* Changes this into a delete job */
-				data->trash = FALSE;
-				data->iter = data->files;
-			}
-			else
-			{
-				/* End the job */
-				async_data_free (data);
-				return;
-			}
+			data->flush_id = g_timeout_add (DELETE_FLUSH_INTERVAL_MSEC,
+							(GSourceFunc)delete_files_flush_cb,
+							data);
 		}
-		else if (code == G_IO_ERROR_CANCELLED)
+	}
+	else if (data->trash && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+	{
+		/* Trash is not supported for this file, the user is asked
+		   about all such files once the others are done */
+		data->untrashable = g_list_prepend (data->untrashable, g_object_ref (file));
+	}
+	else if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+	{
+		/* The file is left alone, and so are the ones not started yet */
+		g_cancellable_cancel (data->cancellable);
+	}
+	else
+	{
+		/* Reported once the job is over, as the other operations
+		   go on meanwhile */
+		if (data->n_failed++ == 0)
 		{
-			/* Job has been cancelled, end the job */
-			async_data_free (data);
-			return;
+			data->error = error;
+			error = NULL;
 		}
 	}
 
+	g_clear_error (&error);
+
 	/* Continue the job */
 	delete_files (data);
 }
 
+static void
+emit_delete_error (AsyncData *data)
+{
+	gchar *message;
+
+	if (data->n_failed == 1)
+	{
+		message = g_strdup (data->error->message);
+	}
+	else
+	{
+		message = g_strdup_printf (ngettext ("%s (and %u other file)",
+						     "%s (and %u other files)",
+						     data->n_failed - 1),
+					   data->error->message,
+					   data->n_failed - 1);
+	}
+
+	g_signal_emit (data->model, model_signals[ERROR], 0,
+		       GEDIT_FILE_BROWSER_ERROR_DELETE,
+		       message);
+
+	g_free (message);
+}
+
 static void
 delete_files (AsyncData *data)
 {
-	GFile *file;
+	gboolean cancelled = g_cancellable_is_cancelled (data->cancellable);
 
-	/* Check if our job is done */
-	if (data->iter == NULL)
+	while (!cancelled && data->iter != NULL && data->n_running < DELETE_MAX_PARALLEL)
 	{
-		async_data_free (data);
-		return;
+		GFile *file = G_FILE (data->iter->data);
+
+		data->iter = data->iter->next;
+		data->n_running++;
+
+		if (data->trash)
+		{
+			g_file_trash_async (file,
+					    G_PRIORITY_DEFAULT,
+					    data->cancellable,
+					    (GAsyncReadyCallback)delete_file_finished,
+					    data);
+		}
+		else
+		{
+			g_file_delete_async (file,
+					     G_PRIORITY_DEFAULT,
+					     data->cancellable,
+					     (GAsyncReadyCallback)delete_file_finished,
+					     data);
+		}
 	}
 
-	file = G_FILE (data->iter->data);
+	/* Check if our job is done */
+	if (data->n_running > 0 || (!cancelled && data->iter != NULL))
+		return;
 
-	if (data->trash)
+	/* Remove what is gone before asking what to do with the rest */
+	delete_files_flush (data);
+
+	if (!cancelled && data->untrashable != NULL && emit_no_trash (data))
 	{
-		g_file_trash_async (file,
-				    G_PRIORITY_DEFAULT,
-				    data->cancellable,
-				    (GAsyncReadyCallback)delete_file_finished,
-				    data);
+		/* Changes this into a delete job for the remaining files */
+		g_list_free_full (data->files, g_object_unref);
+
+		data->files = g_list_reverse (data->untrashable);
+		data->untrashable = NULL;
+		data->iter = data->files;
+		data->trash = FALSE;
+
+		delete_files (data);
+		return;
 	}
-	else
+
+	/* Tells that the job is over, also when it was cancelled */
+	if (data->n_done != data->n_files)
 	{
-		g_file_delete_async (file,
-				     G_PRIORITY_DEFAULT,
-				     data->cancellable,
-				     (GAsyncReadyCallback)delete_file_finished,
-				     data);
+		g_signal_emit (data->model, model_signals[DELETE_PROGRESS], 0,
+			       data->n_files, data->n_files);
 	}
+
+	if (data->error != NULL)
+		emit_delete_error (data);
+
+	async_data_free (data);
 }
 
 GeditFileBrowserStoreResult
@@ -3507,17 +6851,18 @@ gedit_file_browser_store_delete_all (GeditFileBrowserStore *model,
 
 		prev = path;
 		node = (FileBrowserNode *)(iter.user_data);
-		files = g_list_prepend (files, g_object_ref (node->file));
+		files = g_list_prepend (files, file_browser_node_get_file (node));
 	}
 
-	data = g_slice_new (AsyncData);
+	data = g_slice_new0 (AsyncData);
 
 	data->model = model;
 	data->cancellable = g_cancellable_new ();
-	data->files = files;
+	data->files = g_list_reverse (files);
 	data->trash = trash;
-	data->iter = files;
-	data->removed = FALSE;
+	data->iter = data->files;
+	data->n_files = g_list_length (data->files);
+	data->deleted = g_ptr_array_new_with_free_func (g_object_unref);
 
 	model->priv->async_handles = g_slist_prepend (model->priv->async_handles, data);
 
@@ -3527,6 +6872,74 @@ gedit_file_browser_store_delete_all (GeditFileBrowserStore *model,
 	return GEDIT_FILE_BROWSER_STORE_RESULT_OK;
 }
 
+/* Enumerates the directories at locations below the virtual root at the
+   same time, so that they are loaded in one go when they are expanded
+   again. Directories are loaded as soon as they are in the model */
+void
+gedit_file_browser_store_prefetch_directories (GeditFileBrowserStore *model,
+					       GList                 *locations)
+{
+	GPtrArray *pending;
+
+	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
+
+	model_cancel_prefetch (model);
+
+	if (model->priv->virtual_root == NULL || locations == NULL)
+		return;
+
+	model->priv->prefetch_cancellable = g_cancellable_new ();
+	model->priv->prefetches = g_hash_table_new_full (g_file_hash,
+							 (GEqualFunc)g_file_equal,
+							 NULL,
+							 (GDestroyNotify)prefetch_unref);
+
+	pending = g_ptr_array_new ();
+
+	for (GList *item = locations; item; item = item->next)
+	{
+		GFile *location = G_FILE (item->data);
+		FileBrowserNode *node;
+		Prefetch *prefetch;
+
+		if (!g_file_has_prefix (location, model->priv->virtual_root->file) ||
+		    g_hash_table_contains (model->priv->prefetches, location))
+		{
+			continue;
+		}
+
+		node = model_find_node (model, location);
+
+		if (node != NULL && NODE_LOADED (node))
+			continue;
+
+		prefetch = prefetch_new (model, location);
+		g_hash_table_insert (model->priv->prefetches, prefetch->location, prefetch);
+		g_ptr_array_add (pending, prefetch_ref (prefetch));
+	}
+
+	/* Upper directories are needed first */
+	g_ptr_array_sort (pending, (GCompareFunc)compare_prefetch_depth);
+
+	for (guint i = 0; i < pending->len; ++i)
+		g_queue_push_tail (&model->priv->prefetch_queue, g_ptr_array_index (pending, i));
+
+	g_ptr_array_unref (pending);
+
+	model_prefetch_next (model);
+}
+
+/* Stops all running delete and trash jobs; files that are already gone
+   are still removed from the model */
+void
+gedit_file_browser_store_cancel_delete (GeditFileBrowserStore *model)
+{
+	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
+
+	for (GSList *item = model->priv->async_handles; item; item = item->next)
+		g_cancellable_cancel (((AsyncData *)(item->data))->cancellable);
+}
+
 GeditFileBrowserStoreResult
 gedit_file_browser_store_delete (GeditFileBrowserStore *model,
 				 GtkTreeIter           *iter,
@@ -23,6 +23,8 @@
 
 #include <gtk/gtk.h>
 
+#include "gedit-file-browser-status-provider.h"
+
 G_BEGIN_DECLS
 #define GEDIT_TYPE_FILE_BROWSER_STORE			(gedit_file_browser_store_get_type ())
 #define GEDIT_FILE_BROWSER_STORE(obj)			(G_TYPE_CHECK_INSTANCE_CAST ((obj), GEDIT_TYPE_FILE_BROWSER_STORE, GeditFileBrowserStore))
@@ -88,6 +90,14 @@ typedef gboolean (*GeditFileBrowserStoreFilterFunc) (GeditFileBrowserStore *mode
 						     GtkTreeIter           *iter,
 						     gpointer               user_data);
 
+/* Sets bit i of filtered, which is zeroed beforehand, for each row in
+   iters that should be filtered out */
+typedef void (*GeditFileBrowserStoreBatchFilterFunc) (GeditFileBrowserStore *model,
+						      GtkTreeIter           *iters,
+						      guint                  n_iters,
+						      guint8                *filtered,
+						      gpointer               user_data);
+
 struct _GeditFileBrowserStore
 {
 	GObject parent;
@@ -117,6 +127,13 @@ struct _GeditFileBrowserStoreClass {
 	                             GFile                 *location);
 	void (* before_row_deleted) (GeditFileBrowserStore *model,
 	                             GtkTreePath           *path);
+	void (* rows_inserted)      (GeditFileBrowserStore *model,
+	                             GtkTreeIter           *parent,
+	                             GtkTreeIter           *iters,
+	                             guint                  n_iters);
+	void (* delete_progress)    (GeditFileBrowserStore *model,
+	                             guint                  n_done,
+	                             guint                  n_total);
 };
 
 GType                            gedit_file_browser_store_get_type                       (void) G_GNUC_CONST;
@@ -150,6 +167,8 @@ void                             _gedit_file_browser_store_iter_expanded
                                                                                           GtkTreeIter                      *iter);
 void                             _gedit_file_browser_store_iter_collapsed                (GeditFileBrowserStore            *model,
                                                                                           GtkTreeIter                      *iter);
+void                             _gedit_file_browser_store_iter_shown                    (GeditFileBrowserStore            *model,
+                                                                                          GtkTreeIter                      *iter);
 GeditFileBrowserStoreFilterMode  gedit_file_browser_store_get_filter_mode                (GeditFileBrowserStore            *model);
 void                             gedit_file_browser_store_set_filter_mode                (GeditFileBrowserStore            *model,
                                                                                           GeditFileBrowserStoreFilterMode   mode);
@@ -159,7 +178,21 @@ void                             gedit_file_browser_store_set_filter_func
 const gchar * const             *gedit_file_browser_store_get_binary_patterns            (GeditFileBrowserStore            *model);
 void                             gedit_file_browser_store_set_binary_patterns            (GeditFileBrowserStore            *model,
                                                                                           const gchar                     **binary_patterns);
+const gchar                     *gedit_file_browser_store_get_filter_pattern             (GeditFileBrowserStore            *model);
+void                             gedit_file_browser_store_set_filter_pattern             (GeditFileBrowserStore            *model,
+                                                                                          const gchar                      *pattern);
+void                             gedit_file_browser_store_set_batch_filter_func          (GeditFileBrowserStore            *model,
+                                                                                          GeditFileBrowserStoreBatchFilterFunc func,
+                                                                                          gpointer                          user_data);
 void                             gedit_file_browser_store_refilter                       (GeditFileBrowserStore            *model);
+guint                            gedit_file_browser_store_get_cache_size                 (GeditFileBrowserStore            *model);
+void                             gedit_file_browser_store_set_cache_size                 (GeditFileBrowserStore            *model,
+                                                                                          guint                             cache_size);
+gboolean                         gedit_file_browser_store_get_show_status                (GeditFileBrowserStore            *model);
+void                             gedit_file_browser_store_set_show_status                (GeditFileBrowserStore            *model,
+                                                                                          gboolean                          show_status);
+void                             gedit_file_browser_store_set_status_provider            (GeditFileBrowserStore            *model,
+                                                                                          GeditFileBrowserStatusProvider   *provider);
 GeditFileBrowserStoreFilterMode  gedit_file_browser_store_filter_mode_get_default        (void);
 void                             gedit_file_browser_store_refresh                        (GeditFileBrowserStore            *model);
 gboolean                         gedit_file_browser_store_rename                         (GeditFileBrowserStore            *model,
@@ -172,6 +205,9 @@ GeditFileBrowserStoreResult      gedit_file_browser_store_delete
 GeditFileBrowserStoreResult      gedit_file_browser_store_delete_all                     (GeditFileBrowserStore            *model,
                                                                                           GList                            *rows,
                                                                                           gboolean                          trash);
+void                             gedit_file_browser_store_cancel_delete                  (GeditFileBrowserStore            *model);
+void                             gedit_file_browser_store_prefetch_directories           (GeditFileBrowserStore            *model,
+                                                                                          GList                            *locations);
 gboolean                         gedit_file_browser_store_new_file                       (GeditFileBrowserStore            *model,
                                                                                           GtkTreeIter                      *parent,
                                                                                           GtkTreeIter                      *iter);
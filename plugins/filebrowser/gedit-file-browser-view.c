@@ -55,6 +55,11 @@ struct _GeditFileBrowserViewPrivate
 	gboolean                         restore_expand_state;
 	gboolean                         is_refresh;
 	GHashTable                      *expand_state;
+
+	/* Tells the store which rows are on screen once they change, from
+	   scrolling, resizing or the rows themselves changing */
+	guint                            shown_rows_id;
+	GtkAdjustment                   *vadjustment;
 };
 
 /* Properties */
@@ -101,11 +106,21 @@ static void on_end_refresh 		(GeditFileBrowserStore  *model,
 static void on_unload			(GeditFileBrowserStore  *model,
 					 GFile                  *location,
 					 GeditFileBrowserView   *view);
+static void on_virtual_root_changed	(GeditFileBrowserStore  *model,
+					 GParamSpec             *pspec,
+					 GeditFileBrowserView   *view);
 
 static void on_row_inserted		(GeditFileBrowserStore  *model,
 					 GtkTreePath            *path,
 					 GtkTreeIter            *iter,
 					 GeditFileBrowserView   *view);
+static void on_rows_inserted		(GeditFileBrowserStore  *model,
+					 GtkTreeIter            *parent,
+					 GtkTreeIter            *iters,
+					 guint                   n_iters,
+					 GeditFileBrowserView   *view);
+
+static void schedule_shown_rows		(GeditFileBrowserView   *view);
 
 static void
 gedit_file_browser_view_finalize (GObject *object)
@@ -115,6 +130,17 @@ gedit_file_browser_view_finalize (GObject *object)
 	if (obj->priv->hand_cursor)
 		g_object_unref (obj->priv->hand_cursor);
 
+	if (obj->priv->shown_rows_id != 0)
+		g_source_remove (obj->priv->shown_rows_id);
+
+	if (obj->priv->vadjustment)
+	{
+		g_signal_handlers_disconnect_by_func (obj->priv->vadjustment,
+						      schedule_shown_rows,
+						      obj);
+		g_object_unref (obj->priv->vadjustment);
+	}
+
 	if (obj->priv->hover_path)
 		gtk_tree_path_free (obj->priv->hover_path);
 
@@ -179,6 +205,7 @@ row_expanded (GtkTreeView *tree_view,
 
 	_gedit_file_browser_store_iter_expanded (GEDIT_FILE_BROWSER_STORE (view->priv->model),
 						 iter);
+	schedule_shown_rows (view);
 }
 
 static void
@@ -211,6 +238,141 @@ row_collapsed (GtkTreeView *tree_view,
 
 	_gedit_file_browser_store_iter_collapsed (GEDIT_FILE_BROWSER_STORE (view->priv->model),
 						  iter);
+	schedule_shown_rows (view);
+}
+
+/* Moves iter to the row shown below it, going into expanded rows */
+static gboolean
+next_shown_row (GtkTreeView  *tree_view,
+		GtkTreeModel *model,
+		GtkTreeIter  *iter)
+{
+	GtkTreeIter child;
+	GtkTreeIter parent;
+	GtkTreePath *path;
+	gboolean expanded;
+
+	path = gtk_tree_model_get_path (model, iter);
+	expanded = gtk_tree_view_row_expanded (tree_view, path);
+	gtk_tree_path_free (path);
+
+	if (expanded && gtk_tree_model_iter_children (model, &child, iter))
+	{
+		*iter = child;
+		return TRUE;
+	}
+
+	while (TRUE)
+	{
+		GtkTreeIter next = *iter;
+
+		if (gtk_tree_model_iter_next (model, &next))
+		{
+			*iter = next;
+			return TRUE;
+		}
+
+		if (!gtk_tree_model_iter_parent (model, &parent, iter))
+			return FALSE;
+
+		*iter = parent;
+	}
+}
+
+static gboolean
+update_shown_rows (GeditFileBrowserView *view)
+{
+	GtkTreeView *tree_view = GTK_TREE_VIEW (view);
+	GtkTreePath *start;
+	GtkTreePath *end;
+	GtkTreeIter iter;
+
+	view->priv->shown_rows_id = 0;
+
+	if (!GEDIT_IS_FILE_BROWSER_STORE (view->priv->model) ||
+	    !gtk_tree_view_get_visible_range (tree_view, &start, &end))
+	{
+		return G_SOURCE_REMOVE;
+	}
+
+	if (gtk_tree_model_get_iter (view->priv->model, &iter, start))
+	{
+		GtkTreePath *path = gtk_tree_path_copy (start);
+
+		/* The store may add rows while this goes, so it stops at
+		   the last row shown rather than at a count */
+		while (TRUE)
+		{
+			_gedit_file_browser_store_iter_shown (GEDIT_FILE_BROWSER_STORE (view->priv->model),
+							      &iter);
+
+			if (gtk_tree_path_compare (path, end) >= 0 ||
+			    !next_shown_row (tree_view, view->priv->model, &iter))
+			{
+				break;
+			}
+
+			gtk_tree_path_free (path);
+			path = gtk_tree_model_get_path (view->priv->model, &iter);
+		}
+
+		gtk_tree_path_free (path);
+	}
+
+	gtk_tree_path_free (start);
+	gtk_tree_path_free (end);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Looks up the rows shown once the tree view is done with the change */
+static void
+schedule_shown_rows (GeditFileBrowserView *view)
+{
+	if (view->priv->shown_rows_id == 0 &&
+	    GEDIT_IS_FILE_BROWSER_STORE (view->priv->model))
+	{
+		view->priv->shown_rows_id = g_idle_add ((GSourceFunc)update_shown_rows, view);
+	}
+}
+
+static void
+on_vadjustment_changed (GeditFileBrowserView *view,
+			GParamSpec           *pspec,
+			gpointer              user_data)
+{
+	GtkAdjustment *vadjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (view));
+
+	if (view->priv->vadjustment == vadjustment)
+		return;
+
+	if (view->priv->vadjustment)
+	{
+		g_signal_handlers_disconnect_by_func (view->priv->vadjustment,
+						      schedule_shown_rows,
+						      view);
+		g_object_unref (view->priv->vadjustment);
+	}
+
+	view->priv->vadjustment = vadjustment;
+
+	if (vadjustment)
+	{
+		g_object_ref (vadjustment);
+		g_signal_connect_swapped (vadjustment, "value-changed",
+					  G_CALLBACK (schedule_shown_rows), view);
+	}
+
+	schedule_shown_rows (view);
+}
+
+static void
+size_allocate (GtkWidget     *widget,
+	       GtkAllocation *allocation)
+{
+	GTK_WIDGET_CLASS (gedit_file_browser_view_parent_class)->size_allocate (widget, allocation);
+
+	schedule_shown_rows (GEDIT_FILE_BROWSER_VIEW (widget));
 }
 
 static gboolean
@@ -748,7 +910,9 @@ uninstall_restore_signals (GeditFileBrowserView *tree_view,
 	g_signal_handlers_disconnect_by_func (model, on_begin_refresh, tree_view);
 	g_signal_handlers_disconnect_by_func (model, on_end_refresh, tree_view);
 	g_signal_handlers_disconnect_by_func (model, on_unload, tree_view);
+	g_signal_handlers_disconnect_by_func (model, on_virtual_root_changed, tree_view);
 	g_signal_handlers_disconnect_by_func (model, on_row_inserted, tree_view);
+	g_signal_handlers_disconnect_by_func (model, on_rows_inserted, tree_view);
 }
 
 static void
@@ -758,7 +922,9 @@ install_restore_signals (GeditFileBrowserView *tree_view,
 	g_signal_connect (model, "begin-refresh", G_CALLBACK (on_begin_refresh), tree_view);
 	g_signal_connect (model, "end-refresh", G_CALLBACK (on_end_refresh), tree_view);
 	g_signal_connect (model, "unload", G_CALLBACK (on_unload), tree_view);
+	g_signal_connect (model, "notify::virtual-root", G_CALLBACK (on_virtual_root_changed), tree_view);
 	g_signal_connect_after (model, "row-inserted", G_CALLBACK (on_row_inserted), tree_view);
+	g_signal_connect_after (model, "rows-inserted", G_CALLBACK (on_rows_inserted), tree_view);
 }
 
 static void
@@ -858,6 +1024,7 @@ gedit_file_browser_view_class_init (GeditFileBrowserViewClass *klass)
 	widget_class->button_release_event = button_release_event;
 	widget_class->drag_begin = drag_begin;
 	widget_class->key_press_event = key_press_event;
+	widget_class->size_allocate = size_allocate;
 
 	/* Tree view handlers */
 	tree_view_class->row_activated = row_activated;
@@ -982,11 +1149,23 @@ icon_renderer_cb (GtkTreeViewColumn    *tree_column,
 static void
 gedit_file_browser_view_init (GeditFileBrowserView *obj)
 {
+	gint icon_width;
+	gint icon_height;
+	gint xpad;
+	gint ypad;
+
 	obj->priv = gedit_file_browser_view_get_instance_private (obj);
 
 	obj->priv->column = gtk_tree_view_column_new ();
 
 	obj->priv->pixbuf_renderer = gtk_cell_renderer_pixbuf_new ();
+
+	/* Rows keep their layout while their icon is not rendered yet */
+	gtk_icon_size_lookup (GTK_ICON_SIZE_MENU, &icon_width, &icon_height);
+	gtk_cell_renderer_get_padding (obj->priv->pixbuf_renderer, &xpad, &ypad);
+	gtk_cell_renderer_set_fixed_size (obj->priv->pixbuf_renderer,
+					  icon_width + 2 * xpad,
+					  icon_height + 2 * ypad);
 	gtk_tree_view_column_pack_start (obj->priv->column,
 					 obj->priv->pixbuf_renderer,
 					 FALSE);
@@ -1017,6 +1196,10 @@ gedit_file_browser_view_init (GeditFileBrowserView *obj)
 						drag_source_targets,
 						G_N_ELEMENTS (drag_source_targets),
 						GDK_ACTION_COPY);
+
+	g_signal_connect (obj, "notify::vadjustment",
+			  G_CALLBACK (on_vadjustment_changed), NULL);
+	on_vadjustment_changed (obj, NULL, NULL);
 }
 
 static gboolean
@@ -1086,15 +1269,39 @@ gedit_file_browser_view_set_model (GeditFileBrowserView *tree_view,
 		tree_view->priv->hover_path = NULL;
 	}
 
-	if (GEDIT_IS_FILE_BROWSER_STORE (tree_view->priv->model) &&
-	    tree_view->priv->restore_expand_state)
+	if (GEDIT_IS_FILE_BROWSER_STORE (tree_view->priv->model))
+	{
+		if (tree_view->priv->restore_expand_state)
+			uninstall_restore_signals (tree_view, tree_view->priv->model);
+
+		g_signal_handlers_disconnect_by_func (tree_view->priv->model,
+						      schedule_shown_rows,
+						      tree_view);
+	}
+
+	/* Rows coming, going or moving can change which rows are shown
+	   without scrolling */
+	if (GEDIT_IS_FILE_BROWSER_STORE (model))
 	{
-		uninstall_restore_signals (tree_view, tree_view->priv->model);
+		g_signal_connect_object (model, "row-inserted",
+					 G_CALLBACK (schedule_shown_rows), tree_view,
+					 G_CONNECT_SWAPPED | G_CONNECT_AFTER);
+		g_signal_connect_object (model, "rows-inserted",
+					 G_CALLBACK (schedule_shown_rows), tree_view,
+					 G_CONNECT_SWAPPED | G_CONNECT_AFTER);
+		g_signal_connect_object (model, "row-deleted",
+					 G_CALLBACK (schedule_shown_rows), tree_view,
+					 G_CONNECT_SWAPPED | G_CONNECT_AFTER);
+		g_signal_connect_object (model, "rows-reordered",
+					 G_CALLBACK (schedule_shown_rows), tree_view,
+					 G_CONNECT_SWAPPED | G_CONNECT_AFTER);
 	}
 
 	tree_view->priv->model = model;
 	gtk_tree_view_set_model (GTK_TREE_VIEW (tree_view), model);
 	gtk_tree_view_set_search_column (GTK_TREE_VIEW (tree_view), search_column);
+
+	schedule_shown_rows (tree_view);
 }
 
 void
@@ -1266,6 +1473,38 @@ on_unload (GeditFileBrowserStore *model,
 	remove_expand_state (view, location);
 }
 
+static void
+on_virtual_root_changed (GeditFileBrowserStore *model,
+			 GParamSpec            *pspec,
+			 GeditFileBrowserView  *view)
+{
+	GFile *virtual_root;
+	GList *locations = NULL;
+	GHashTableIter iter;
+	GFile *location;
+
+	virtual_root = gedit_file_browser_store_get_virtual_root (model);
+
+	/* Have all of the expanded directories below the new virtual root
+	   read at once, instead of one level after the other. With none,
+	   this drops what was read ahead for the previous one */
+	if (virtual_root != NULL)
+	{
+		g_hash_table_iter_init (&iter, view->priv->expand_state);
+
+		while (g_hash_table_iter_next (&iter, (gpointer *)&location, NULL))
+		{
+			if (g_file_has_prefix (location, virtual_root))
+				locations = g_list_prepend (locations, location);
+		}
+
+		g_object_unref (virtual_root);
+	}
+
+	gedit_file_browser_store_prefetch_directories (model, locations);
+	g_list_free (locations);
+}
+
 static void
 restore_expand_state (GeditFileBrowserView  *view,
 		      GeditFileBrowserStore *model,
@@ -1280,12 +1519,31 @@ restore_expand_state (GeditFileBrowserView  *view,
 
 	if (location)
 	{
-		GtkTreePath *path = gtk_tree_model_get_path (GTK_TREE_MODEL (model), iter);
-
 		if (g_hash_table_lookup (view->priv->expand_state, location))
-			gtk_tree_view_expand_row (GTK_TREE_VIEW (view), path, FALSE);
+		{
+			GtkTreePath *path = gtk_tree_model_get_path (GTK_TREE_MODEL (model), iter);
+
+			/* The store loads prefetched directories before their
+			   parent is expanded, so restore the rows which are
+			   already there along with it */
+			if (gtk_tree_view_expand_row (GTK_TREE_VIEW (view), path, FALSE))
+			{
+				GtkTreeIter child;
+
+				if (gtk_tree_model_iter_children (GTK_TREE_MODEL (model), &child, iter))
+				{
+					do
+					{
+						if (gtk_tree_model_iter_has_child (GTK_TREE_MODEL (model), &child))
+							restore_expand_state (view, model, &child);
+					}
+					while (gtk_tree_model_iter_next (GTK_TREE_MODEL (model), &child));
+				}
+			}
+
+			gtk_tree_path_free (path);
+		}
 
-		gtk_tree_path_free (path);
 		g_object_unref (location);
 	}
 }
@@ -1298,9 +1556,16 @@ on_row_inserted (GeditFileBrowserStore *model,
 {
 	GtkTreeIter parent;
 	GtkTreePath *copy;
+	guint flags = 0;
 
-	if (gtk_tree_model_iter_has_child (GTK_TREE_MODEL (model), iter))
-		restore_expand_state (view, model, iter);
+	/* Real rows are handled in bulk in on_rows_inserted, only the dummy
+	   makes a directory expandable without any rows being announced */
+	gtk_tree_model_get (GTK_TREE_MODEL (model), iter,
+			    GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS, &flags,
+			    -1);
+
+	if (!FILE_IS_DUMMY (flags))
+		return;
 
 	copy = gtk_tree_path_copy (path);
 
@@ -1314,6 +1579,29 @@ on_row_inserted (GeditFileBrowserStore *model,
 	gtk_tree_path_free (copy);
 }
 
+static void
+on_rows_inserted (GeditFileBrowserStore *model,
+		  GtkTreeIter           *parent,
+		  GtkTreeIter           *iters,
+		  guint                  n_iters,
+		  GeditFileBrowserView  *view)
+{
+	GtkTreePath *path;
+
+	for (guint i = 0; i < n_iters; ++i)
+	{
+		if (gtk_tree_model_iter_has_child (GTK_TREE_MODEL (model), &iters[i]))
+			restore_expand_state (view, model, &iters[i]);
+	}
+
+	path = gtk_tree_model_get_path (GTK_TREE_MODEL (model), parent);
+
+	if (path != NULL && gtk_tree_path_get_depth (path) != 0)
+		restore_expand_state (view, model, parent);
+
+	gtk_tree_path_free (path);
+}
+
 void
 _gedit_file_browser_view_register_type (GTypeModule *type_module)
 {
@@ -87,10 +87,13 @@ typedef struct _SignalNode
 
 typedef struct
 {
-	gulong                           id;
-	GeditFileBrowserWidgetFilterFunc func;
-	gpointer                         user_data;
-	GDestroyNotify                   destroy_notify;
+	gulong                                id;
+
+	/* Only one of func and batch_func is set */
+	GeditFileBrowserWidgetFilterFunc      func;
+	GeditFileBrowserWidgetBatchFilterFunc batch_func;
+	gpointer                              user_data;
+	GDestroyNotify                        destroy_notify;
 } FilterFunc;
 
 typedef struct
@@ -135,14 +138,16 @@ struct _GeditFileBrowserWidgetPrivate
 	GtkWidget               *filter_entry_revealer;
 	GtkWidget               *filter_entry;
 
+	GtkWidget               *delete_progress_revealer;
+	GtkWidget               *delete_progress_bar;
+	GtkWidget               *delete_cancel_button;
+
 	GSimpleActionGroup      *action_group;
 
 	GSList                  *signal_pool;
 
 	GSList                  *filter_funcs;
 	gulong                   filter_id;
-	gulong                   glob_filter_id;
-	GPatternSpec            *filter_pattern;
 	gchar                   *filter_pattern_str;
 
 	GList                   *locations;
@@ -299,6 +304,7 @@ filter_func_new (GeditFileBrowserWidget           *obj,
 
 	result->id = ++obj->priv->filter_id;
 	result->func = func;
+	result->batch_func = NULL;
 	result->user_data = user_data;
 	result->destroy_notify = notify;
 	return result;
@@ -543,6 +549,9 @@ gedit_file_browser_widget_class_init (GeditFileBrowserWidgetClass *klass)
 	gtk_widget_class_bind_template_child_private (widget_class, GeditFileBrowserWidget, treeview);
 	gtk_widget_class_bind_template_child_private (widget_class, GeditFileBrowserWidget, filter_entry_revealer);
 	gtk_widget_class_bind_template_child_private (widget_class, GeditFileBrowserWidget, filter_entry);
+	gtk_widget_class_bind_template_child_private (widget_class, GeditFileBrowserWidget, delete_progress_revealer);
+	gtk_widget_class_bind_template_child_private (widget_class, GeditFileBrowserWidget, delete_progress_bar);
+	gtk_widget_class_bind_template_child_private (widget_class, GeditFileBrowserWidget, delete_cancel_button);
 	gtk_widget_class_bind_template_child_private (widget_class, GeditFileBrowserWidget, location_previous_menu);
 	gtk_widget_class_bind_template_child_private (widget_class, GeditFileBrowserWidget, location_next_menu);
 }
@@ -777,13 +786,32 @@ filter_real (GeditFileBrowserStore  *model,
 	{
 		FilterFunc *func = (FilterFunc *)(item->data);
 
-		if (!func->func (obj, model, iter, func->user_data))
+		if (func->func != NULL && !func->func (obj, model, iter, func->user_data))
 			return FALSE;
 	}
 
 	return TRUE;
 }
 
+static void
+filter_batch_real (GeditFileBrowserStore  *model,
+		   GtkTreeIter            *iters,
+		   guint                   n_iters,
+		   guint8                 *filtered,
+		   GeditFileBrowserWidget *obj)
+{
+	GSList *item;
+
+	/* Each filter adds the rows it rejects to the same bitmap */
+	for (item = obj->priv->filter_funcs; item; item = item->next)
+	{
+		FilterFunc *func = (FilterFunc *)(item->data);
+
+		if (func->batch_func != NULL)
+			func->batch_func (obj, model, iters, n_iters, filtered, func->user_data);
+	}
+}
+
 static void
 add_bookmark_hash (GeditFileBrowserWidget *obj,
 		   GtkTreeIter            *iter)
@@ -821,15 +849,17 @@ init_bookmarks_hash (GeditFileBrowserWidget *obj)
 	GtkTreeModel *model = GTK_TREE_MODEL (obj->priv->bookmarks_store);
 	GtkTreeIter iter;
 
-	if (!gtk_tree_model_get_iter_first (model, &iter))
-		return;
-
-	do
+	if (gtk_tree_model_get_iter_first (model, &iter))
 	{
-		add_bookmark_hash (obj, &iter);
+		do
+		{
+			add_bookmark_hash (obj, &iter);
+		}
+		while (gtk_tree_model_iter_next (model, &iter));
 	}
-	while (gtk_tree_model_iter_next (model, &iter));
 
+	/* The bookmarks store is filled in asynchronously, the rows come
+	   in through row-changed */
 	g_signal_connect (obj->priv->bookmarks_store,
 		          "row-changed",
 		          G_CALLBACK (on_bookmarks_row_changed),
@@ -864,6 +894,42 @@ on_end_loading (GeditFileBrowserStore  *model,
 	gdk_window_set_cursor (gtk_widget_get_window (GTK_WIDGET (obj)), NULL);
 }
 
+/* Only shows up for jobs which are not over by the first report */
+static void
+on_delete_progress (GeditFileBrowserStore  *model,
+		    guint                   done,
+		    guint                   total,
+		    GeditFileBrowserWidget *obj)
+{
+	gchar *text;
+
+	if (done >= total)
+	{
+		gtk_revealer_set_reveal_child (GTK_REVEALER (obj->priv->delete_progress_revealer),
+					       FALSE);
+		return;
+	}
+
+	text = g_strdup_printf (ngettext ("Deleted %u of %u file",
+					  "Deleted %u of %u files",
+					  total),
+				done, total);
+
+	gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (obj->priv->delete_progress_bar),
+				       (gdouble)done / total);
+	gtk_progress_bar_set_text (GTK_PROGRESS_BAR (obj->priv->delete_progress_bar), text);
+	gtk_revealer_set_reveal_child (GTK_REVEALER (obj->priv->delete_progress_revealer), TRUE);
+
+	g_free (text);
+}
+
+static void
+on_delete_cancel_clicked (GtkButton              *button,
+			  GeditFileBrowserWidget *obj)
+{
+	gedit_file_browser_store_cancel_delete (obj->priv->file_store);
+}
+
 static void
 on_locations_treeview_row_activated (GtkTreeView            *locations_treeview,
                                      GtkTreePath            *path,
@@ -1039,6 +1105,9 @@ gedit_file_browser_widget_init (GeditFileBrowserWidget *obj)
 	gedit_file_browser_store_set_filter_func (obj->priv->file_store,
 						  (GeditFileBrowserStoreFilterFunc) filter_real,
 						  obj);
+	gedit_file_browser_store_set_batch_filter_func (obj->priv->file_store,
+							(GeditFileBrowserStoreBatchFilterFunc) filter_batch_real,
+							obj);
 
 	g_signal_connect (obj->priv->treeview, "notify::model",
 			  G_CALLBACK (on_model_set), obj);
@@ -1070,6 +1139,12 @@ gedit_file_browser_widget_init (GeditFileBrowserWidget *obj)
 	g_signal_connect (obj->priv->file_store, "error",
 			  G_CALLBACK (on_file_store_error), obj);
 
+	g_signal_connect (obj->priv->file_store, "delete-progress",
+			  G_CALLBACK (on_delete_progress), obj);
+
+	g_signal_connect (obj->priv->delete_cancel_button, "clicked",
+			  G_CALLBACK (on_delete_cancel_clicked), obj);
+
 	init_bookmarks_hash (obj);
 
 	/* filter */
@@ -1237,33 +1312,6 @@ popup_menu (GeditFileBrowserWidget *obj,
 	return TRUE;
 }
 
-static gboolean
-filter_glob (GeditFileBrowserWidget *obj,
-	     GeditFileBrowserStore  *store,
-	     GtkTreeIter            *iter,
-	     gpointer                user_data)
-{
-	gchar *name;
-	gboolean result;
-	guint flags;
-
-	if (obj->priv->filter_pattern == NULL)
-		return TRUE;
-
-	gtk_tree_model_get (GTK_TREE_MODEL (store), iter,
-			    GEDIT_FILE_BROWSER_STORE_COLUMN_NAME, &name,
-			    GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS, &flags,
-			    -1);
-
-	if (FILE_IS_DIR (flags) || FILE_IS_DUMMY (flags))
-		result = TRUE;
-	else
-		result = g_pattern_match_string (obj->priv->filter_pattern, name);
-
-	g_free (name);
-	return result;
-}
-
 static void
 rename_selected_file (GeditFileBrowserWidget *obj)
 {
@@ -1574,8 +1622,6 @@ set_filter_pattern_real (GeditFileBrowserWidget *obj,
                         gchar const             *pattern,
                         gboolean                 update_entry)
 {
-	GtkTreeModel *model = gtk_tree_view_get_model (GTK_TREE_VIEW (obj->priv->treeview));
-
 	if (pattern != NULL && *pattern == '\0')
 		pattern = NULL;
 
@@ -1593,36 +1639,12 @@ set_filter_pattern_real (GeditFileBrowserWidget *obj,
 	else
 		obj->priv->filter_pattern_str = g_strdup (pattern);
 
-	if (obj->priv->filter_pattern)
-	{
-		g_pattern_spec_free (obj->priv->filter_pattern);
-		obj->priv->filter_pattern = NULL;
-	}
-
-	if (pattern == NULL)
-	{
-		if (obj->priv->glob_filter_id != 0)
-		{
-			gedit_file_browser_widget_remove_filter (obj, obj->priv->glob_filter_id);
-			obj->priv->glob_filter_id = 0;
-		}
-	}
-	else
-	{
-		obj->priv->filter_pattern = g_pattern_spec_new (pattern);
-
-		if (obj->priv->glob_filter_id == 0)
-			obj->priv->glob_filter_id = gedit_file_browser_widget_add_filter (obj,
-											  filter_glob,
-											  NULL,
-											  NULL);
-	}
-
 	if (update_entry)
 		gtk_entry_set_text (GTK_ENTRY (obj->priv->filter_entry), obj->priv->filter_pattern_str);
 
-	if (GEDIT_IS_FILE_BROWSER_STORE (model))
-		gedit_file_browser_store_refilter (GEDIT_FILE_BROWSER_STORE (model));
+	/* The store matches the pattern together with the binary patterns
+	   and only refilters what the new pattern can change */
+	gedit_file_browser_store_set_filter_pattern (obj->priv->file_store, pattern);
 
 	g_object_notify (G_OBJECT (obj), "filter-pattern");
 }
@@ -1762,6 +1784,26 @@ gedit_file_browser_widget_add_filter (GeditFileBrowserWidget           *obj,
 	return f->id;
 }
 
+/* Like gedit_file_browser_widget_add_filter, but func gets many rows at
+   once. The returned id is removed with gedit_file_browser_widget_remove_filter */
+gulong
+gedit_file_browser_widget_add_batch_filter (GeditFileBrowserWidget                *obj,
+					    GeditFileBrowserWidgetBatchFilterFunc  func,
+					    gpointer                               user_data,
+					    GDestroyNotify                         notify)
+{
+	FilterFunc *f = filter_func_new (obj, NULL, user_data, notify);
+	GtkTreeModel *model = gtk_tree_view_get_model (GTK_TREE_VIEW (obj->priv->treeview));
+
+	f->batch_func = func;
+	obj->priv->filter_funcs = g_slist_append (obj->priv->filter_funcs, f);
+
+	if (GEDIT_IS_FILE_BROWSER_STORE (model))
+		gedit_file_browser_store_refilter (GEDIT_FILE_BROWSER_STORE (model));
+
+	return f->id;
+}
+
 void
 gedit_file_browser_widget_remove_filter (GeditFileBrowserWidget *obj,
 					 gulong                  id)
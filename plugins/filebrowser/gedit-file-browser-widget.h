@@ -46,6 +46,14 @@ gboolean (*GeditFileBrowserWidgetFilterFunc) (GeditFileBrowserWidget *obj,
 					      GtkTreeIter            *iter,
 					      gpointer                user_data);
 
+typedef
+void (*GeditFileBrowserWidgetBatchFilterFunc) (GeditFileBrowserWidget *obj,
+					       GeditFileBrowserStore  *model,
+					       GtkTreeIter            *iters,
+					       guint                   n_iters,
+					       guint8                 *filtered,
+					       gpointer                user_data);
+
 struct _GeditFileBrowserWidget
 {
 	GtkBox parent;
@@ -108,6 +116,10 @@ gulong gedit_file_browser_widget_add_filter			(GeditFileBrowserWidget *obj,
 								 GeditFileBrowserWidgetFilterFunc func,
 								 gpointer                user_data,
 								 GDestroyNotify          notify);
+gulong gedit_file_browser_widget_add_batch_filter		(GeditFileBrowserWidget *obj,
+								 GeditFileBrowserWidgetBatchFilterFunc func,
+								 gpointer                user_data,
+								 GDestroyNotify          notify);
 void		 gedit_file_browser_widget_remove_filter	(GeditFileBrowserWidget *obj,
 								 gulong                  id);
 void		 gedit_file_browser_widget_set_filter_pattern	(GeditFileBrowserWidget *obj,
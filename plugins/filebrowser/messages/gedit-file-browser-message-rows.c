@@ -0,0 +1,202 @@
+/*
+ * gedit-file-browser-message-rows.c
+ * This file is part of gedit
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+
+#include "gedit-file-browser-message-rows.h"
+
+/* Describes many rows at once. Entry i of ids and uris is row i, and
+ * bit i of the directories and filtered bitmaps, counting from the
+ * least significant bit of the first byte, is set for row i.
+ */
+
+enum
+{
+	PROP_0,
+
+	PROP_IDS,
+	PROP_URIS,
+	PROP_DIRECTORIES,
+	PROP_FILTERED,
+};
+
+struct _GeditFileBrowserMessageRowsPrivate
+{
+	gchar **ids;
+	gchar **uris;
+	GBytes *directories;
+	GBytes *filtered;
+};
+
+G_DEFINE_TYPE_EXTENDED (GeditFileBrowserMessageRows,
+                        gedit_file_browser_message_rows,
+                        GEDIT_TYPE_MESSAGE,
+                        0,
+                        G_ADD_PRIVATE (GeditFileBrowserMessageRows))
+
+static void
+gedit_file_browser_message_rows_finalize (GObject *obj)
+{
+	GeditFileBrowserMessageRows *msg = GEDIT_FILE_BROWSER_MESSAGE_ROWS (obj);
+
+	g_strfreev (msg->priv->ids);
+	g_strfreev (msg->priv->uris);
+
+	if (msg->priv->directories)
+	{
+		g_bytes_unref (msg->priv->directories);
+	}
+
+	if (msg->priv->filtered)
+	{
+		g_bytes_unref (msg->priv->filtered);
+	}
+
+	G_OBJECT_CLASS (gedit_file_browser_message_rows_parent_class)->finalize (obj);
+}
+
+static void
+gedit_file_browser_message_rows_get_property (GObject    *obj,
+                                              guint       prop_id,
+                                              GValue     *value,
+                                              GParamSpec *pspec)
+{
+	GeditFileBrowserMessageRows *msg;
+
+	msg = GEDIT_FILE_BROWSER_MESSAGE_ROWS (obj);
+
+	switch (prop_id)
+	{
+		case PROP_IDS:
+			g_value_set_boxed (value, msg->priv->ids);
+			break;
+		case PROP_URIS:
+			g_value_set_boxed (value, msg->priv->uris);
+			break;
+		case PROP_DIRECTORIES:
+			g_value_set_boxed (value, msg->priv->directories);
+			break;
+		case PROP_FILTERED:
+			g_value_set_boxed (value, msg->priv->filtered);
+			break;
+	}
+}
+
+static void
+gedit_file_browser_message_rows_set_property (GObject      *obj,
+                                              guint         prop_id,
+                                              GValue const *value,
+                                              GParamSpec   *pspec)
+{
+	GeditFileBrowserMessageRows *msg;
+
+	msg = GEDIT_FILE_BROWSER_MESSAGE_ROWS (obj);
+
+	switch (prop_id)
+	{
+		case PROP_IDS:
+		{
+			g_strfreev (msg->priv->ids);
+			msg->priv->ids = g_value_dup_boxed (value);
+			break;
+		}
+		case PROP_URIS:
+		{
+			g_strfreev (msg->priv->uris);
+			msg->priv->uris = g_value_dup_boxed (value);
+			break;
+		}
+		case PROP_DIRECTORIES:
+		{
+			if (msg->priv->directories)
+			{
+				g_bytes_unref (msg->priv->directories);
+			}
+			msg->priv->directories = g_value_dup_boxed (value);
+			break;
+		}
+		case PROP_FILTERED:
+		{
+			if (msg->priv->filtered)
+			{
+				g_bytes_unref (msg->priv->filtered);
+			}
+			msg->priv->filtered = g_value_dup_boxed (value);
+			break;
+		}
+	}
+}
+
+static void
+gedit_file_browser_message_rows_class_init (GeditFileBrowserMessageRowsClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+	object_class->finalize = gedit_file_browser_message_rows_finalize;
+
+	object_class->get_property = gedit_file_browser_message_rows_get_property;
+	object_class->set_property = gedit_file_browser_message_rows_set_property;
+
+	g_object_class_install_property (object_class,
+	                                 PROP_IDS,
+	                                 g_param_spec_boxed ("ids",
+	                                                     "Ids",
+	                                                     "Ids",
+	                                                     G_TYPE_STRV,
+	                                                     G_PARAM_READWRITE |
+	                                                     G_PARAM_CONSTRUCT |
+	                                                     G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_URIS,
+	                                 g_param_spec_boxed ("uris",
+	                                                     "Uris",
+	                                                     "Uris",
+	                                                     G_TYPE_STRV,
+	                                                     G_PARAM_READWRITE |
+	                                                     G_PARAM_CONSTRUCT |
+	                                                     G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_DIRECTORIES,
+	                                 g_param_spec_boxed ("directories",
+	                                                     "Directories",
+	                                                     "Directories",
+	                                                     G_TYPE_BYTES,
+	                                                     G_PARAM_READWRITE |
+	                                                     G_PARAM_CONSTRUCT |
+	                                                     G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_FILTERED,
+	                                 g_param_spec_boxed ("filtered",
+	                                                     "Filtered",
+	                                                     "Filtered",
+	                                                     G_TYPE_BYTES,
+	                                                     G_PARAM_READWRITE |
+	                                                     G_PARAM_CONSTRUCT |
+	                                                     G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gedit_file_browser_message_rows_init (GeditFileBrowserMessageRows *message)
+{
+	message->priv = gedit_file_browser_message_rows_get_instance_private (message);
+}
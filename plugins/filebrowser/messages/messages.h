@@ -8,6 +8,7 @@
 #include "gedit-file-browser-message-get-view.h"
 #include "gedit-file-browser-message-id.h"
 #include "gedit-file-browser-message-id-location.h"
+#include "gedit-file-browser-message-rows.h"
 #include "gedit-file-browser-message-set-emblem.h"
 #include "gedit-file-browser-message-set-markup.h"
 #include "gedit-file-browser-message-set-root.h"